@@ -0,0 +1,19 @@
+// MIT License
+
+// Defines the timing helper shared by the benchmarks. It times the same
+// way as the host calibration (Calibration::SecondsPerCall).
+
+#ifndef MNIST_DIGIT_RECOGNITION_BENCHMARKS_BENCHMARK_UTIL_H_
+#define MNIST_DIGIT_RECOGNITION_BENCHMARKS_BENCHMARK_UTIL_H_
+
+#include <utility>
+
+#include "calibration.h"
+
+// Runs fn repeatedly for at least min_seconds and returns seconds per call.
+template <typename Fn>
+double TimePerCall(Fn&& fn, double min_seconds = 0.5) {
+  return Calibration::SecondsPerCall(min_seconds, std::forward<Fn>(fn));
+}
+
+#endif  // MNIST_DIGIT_RECOGNITION_BENCHMARKS_BENCHMARK_UTIL_H_
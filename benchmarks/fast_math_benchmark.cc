@@ -0,0 +1,89 @@
+// MIT License
+
+// Compares the FastMath array kernels (Simd::MathKernels) against a loop
+// calling the C library, for float and double, and times the softmax
+// cross-entropy on a batch of logits.
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "cpu_features.h"
+#include "loss.h"
+#include "matrix.h"
+#include "simd_kernels.h"
+
+namespace {
+
+constexpr size_t kElements = 1 << 16;
+
+void Report(const std::string& name, double libm, double fast) {
+  std::cout << "  " << std::left << std::setw(16) << name << std::right
+            << std::fixed << std::setprecision(2) << std::setw(8)
+            << kElements / libm * 1e-9 << " G/s" << std::setw(10)
+            << kElements / fast * 1e-9 << " G/s" << std::setw(8)
+            << libm / fast << "x\n";
+}
+
+template <typename T>
+void RunFunctions(const std::string& type) {
+  std::vector<T> in(kElements);
+  std::vector<T> out(kElements);
+  const Simd::MathKernels<T>& math = Simd::Math<T>();
+  for (size_t i = 0; i < kElements; ++i) {
+    in[i] = static_cast<T>(i % 2000) / T(100) - T(10);  // [-10, 10)
+  }
+  Report("exp " + type, TimePerCall([&] {
+           for (size_t i = 0; i < kElements; ++i) {
+             out[i] = std::exp(in[i]);
+           }
+         }),
+         TimePerCall([&] { math.exp(in.data(), out.data(), kElements); }));
+  Report("tanh " + type, TimePerCall([&] {
+           for (size_t i = 0; i < kElements; ++i) {
+             out[i] = std::tanh(in[i]);
+           }
+         }),
+         TimePerCall([&] { math.tanh(in.data(), out.data(), kElements); }));
+  for (size_t i = 0; i < kElements; ++i) {
+    in[i] = static_cast<T>(i % 2000 + 1) / T(100);  // (0, 20]
+  }
+  Report("log " + type, TimePerCall([&] {
+           for (size_t i = 0; i < kElements; ++i) {
+             out[i] = std::log(in[i]);
+           }
+         }),
+         TimePerCall([&] { math.log(in.data(), out.data(), kElements); }));
+}
+
+void RunCrossEntropy(size_t rows) {
+  Matrix<float> logits = Matrix<float>::Random(rows, 10, -5.0f, 5.0f, 42);
+  Matrix<float> classes(rows, 1);
+  for (size_t r = 0; r < rows; ++r) {
+    classes(r, 0) = static_cast<float>(r % 10);
+  }
+  Matrix<float> labels = Matrix<float>::OneHotEncode(classes, 10);
+  Matrix<float> gradient;
+  double seconds = TimePerCall([&] {
+    (void)Loss::SoftmaxCrossEntropyWithGradient(logits, labels, gradient);
+  });
+  std::cout << "  softmax cross-entropy " << rows << "x10: " << std::fixed
+            << std::setprecision(2) << seconds * 1e6 << " us\n";
+}
+
+}  // namespace
+
+int main() {
+  std::cout << "FastMath (" << SimdLevelName(ActiveSimdLevel()) << ")\n"
+            << "  " << std::left << std::setw(16) << "function" << std::right
+            << std::setw(12) << "libm" << std::setw(14) << "fast"
+            << std::setw(9) << "speedup\n";
+  RunFunctions<float>("float");
+  RunFunctions<double>("double");
+  RunCrossEntropy(24);
+  RunCrossEntropy(4096);
+  return 0;
+}
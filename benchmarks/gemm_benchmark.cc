@@ -0,0 +1,176 @@
+// MIT License
+
+// Reports GFLOP/s of the GEMM engine for the layer shapes used by
+// RunTrainingMode (784x256, 256x256 and 256x10), both at the training batch
+// size and at a large evaluation batch.
+// The single-threaded engine is measured alongside ParallelMultiply on the
+// global pool, and the previous naive triple loop serves as a reference.
+// The backward products of each layer are timed with transposed operands
+// read in place and with explicit GetTranspose copies, and the Linear + ReLU
+// forward with the bias and activation fused into the product against
+// separate passes.
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "cpu_features.h"
+#include "gemm.h"
+#include "matrix.h"
+#include "thread_pool.h"
+
+namespace {
+
+struct Shape {
+  size_t m;
+  size_t k;
+  size_t n;
+};
+
+// The pre-GEMM single-threaded algorithm, kept here for comparison only.
+void NaiveMultiply(const float* a, const float* b, float* c, size_t m,
+                   size_t n, size_t k) {
+  for (size_t r = 0; r < m; ++r) {
+    for (size_t col = 0; col < n; ++col) {
+      float sum = 0.0f;
+      for (size_t p = 0; p < k; ++p) {
+        sum += a[r * k + p] * b[p * n + col];
+      }
+      c[r * n + col] = sum;
+    }
+  }
+}
+
+void RunShape(const Shape& shape, bool include_naive) {
+  Matrix<float> a = Matrix<float>::Random(shape.m, shape.k, -1.0f, 1.0f, 1);
+  Matrix<float> b = Matrix<float>::Random(shape.k, shape.n, -1.0f, 1.0f, 2);
+  std::vector<float> c(shape.m * shape.n);
+
+  const double flops = 2.0 * static_cast<double>(shape.m) *
+                       static_cast<double>(shape.n) *
+                       static_cast<double>(shape.k);
+
+  double gemm_seconds = TimePerCall([&] {
+    Gemm::Multiply<float>(shape.m, shape.n, shape.k, a.ToVector().data(),
+                          shape.k, b.ToVector().data(), shape.n, c.data(),
+                          shape.n);
+  });
+
+  ThreadPool& pool = ThreadPool::Global();
+  double parallel_seconds = TimePerCall([&] {
+    Gemm::ParallelMultiply<float>(shape.m, shape.n, shape.k,
+                                  a.ToVector().data(), shape.k,
+                                  b.ToVector().data(), shape.n, c.data(),
+                                  shape.n, pool, pool.MaxParallelism());
+  });
+
+  std::cout << std::setw(6) << shape.m << " x " << std::setw(4) << shape.k
+            << " x " << std::setw(4) << shape.n << "   gemm: " << std::fixed
+            << std::setprecision(2) << std::setw(8)
+            << flops / gemm_seconds * 1e-9 << " GFLOP/s   parallel: "
+            << std::setw(8) << flops / parallel_seconds * 1e-9 << " GFLOP/s";
+
+  if (include_naive) {
+    double naive_seconds = TimePerCall([&] {
+      NaiveMultiply(a.ToVector().data(), b.ToVector().data(), c.data(),
+                    shape.m, shape.n, shape.k);
+    });
+    std::cout << "   naive: " << std::setw(8) << flops / naive_seconds * 1e-9
+              << " GFLOP/s   speedup: " << naive_seconds / gemm_seconds << "x";
+  }
+  std::cout << "\n";
+}
+
+// Times the backward products of a layer with `in` inputs and `out`
+// outputs, reading the transposed operands in place, against transposing
+// them first with GetTranspose.
+void RunBackwardShape(size_t batch, size_t in, size_t out) {
+  Matrix<float> input = Matrix<float>::Random(batch, in, -1.0f, 1.0f, 3);
+  Matrix<float> grad_output =
+      Matrix<float>::Random(batch, out, -1.0f, 1.0f, 4);
+  Matrix<float> weights = Matrix<float>::Random(in, out, -1.0f, 1.0f, 5);
+
+  double in_place_seconds = TimePerCall([&] {
+    Matrix<float> grad_weights = Matrix<float>::Multiply(
+        input, Transpose::kYes, grad_output, Transpose::kNo);
+    Matrix<float> grad_input = Matrix<float>::Multiply(
+        grad_output, Transpose::kNo, weights, Transpose::kYes);
+  });
+  double copy_seconds = TimePerCall([&] {
+    Matrix<float> grad_weights = input.GetTranspose() * grad_output;
+    Matrix<float> grad_input = grad_output * weights.GetTranspose();
+  });
+
+  std::cout << std::setw(6) << batch << " x " << std::setw(4) << in << " x "
+            << std::setw(4) << out << "   in place: " << std::fixed
+            << std::setprecision(1) << std::setw(8) << in_place_seconds * 1e6
+            << " us   GetTranspose: " << std::setw(8) << copy_seconds * 1e6
+            << " us\n";
+}
+
+// Times input * weights + bias followed by ReLU with the bias and ReLU
+// applied by the GEMM epilogue, against the product followed by a bias pass
+// and a ReLU pass.
+void RunEpilogueShape(size_t batch, size_t in, size_t out) {
+  Matrix<float> input = Matrix<float>::Random(batch, in, -1.0f, 1.0f, 6);
+  Matrix<float> weights = Matrix<float>::Random(in, out, -1.0f, 1.0f, 7);
+  Matrix<float> bias = Matrix<float>::Random(1, out, -1.0f, 1.0f, 8);
+  Matrix<float> output;
+
+  Gemm::Epilogue<float> epilogue;
+  epilogue.bias = bias.ToVector().data();
+  epilogue.relu = true;
+  double fused_seconds = TimePerCall([&] {
+    Matrix<float>::MultiplyInto(input, Transpose::kNo, weights, Transpose::kNo,
+                                epilogue, output);
+  });
+  double separate_seconds = TimePerCall([&] {
+    Matrix<float>::MultiplyInto(input, Transpose::kNo, weights, Transpose::kNo,
+                                output);
+    output += bias.BroadcastRows(batch);
+    for (size_t r = 0; r < output.Rows(); ++r) {
+      for (size_t c = 0; c < output.Cols(); ++c) {
+        output(r, c) = std::max(0.0f, output(r, c));
+      }
+    }
+  });
+
+  std::cout << std::setw(6) << batch << " x " << std::setw(4) << in << " x "
+            << std::setw(4) << out << "   fused: " << std::fixed
+            << std::setprecision(1) << std::setw(8) << fused_seconds * 1e6
+            << " us   separate: " << std::setw(8) << separate_seconds * 1e6
+            << " us\n";
+}
+
+}  // namespace
+
+int main() {
+  const Gemm::BlockSizes& blocks = Gemm::DefaultBlockSizes<float>();
+  std::cout << "SIMD level: " << SimdLevelName(ActiveSimdLevel()) << "\n";
+  std::cout << "Block sizes (float): mc=" << blocks.mc << " kc=" << blocks.kc
+            << " nc=" << blocks.nc << "\n";
+  std::cout << "Threads: " << ThreadPool::Global().NumThreads() << "\n\n";
+
+  // Training batch (ExperimentConfig::batch_size) and evaluation batch
+  for (size_t batch : {size_t{24}, size_t{10000}}) {
+    std::cout << "Batch " << batch << " (m x k x n):\n";
+    RunShape({batch, 784, 256}, batch <= 1000);
+    RunShape({batch, 256, 256}, batch <= 1000);
+    RunShape({batch, 256, 10}, batch <= 1000);
+    std::cout << "\n";
+  }
+
+  std::cout << "Backward pass, transposed operands (batch x in x out):\n";
+  RunBackwardShape(24, 784, 256);
+  RunBackwardShape(24, 256, 256);
+  RunBackwardShape(24, 256, 10);
+
+  std::cout << "\nLinear + ReLU forward (batch x in x out):\n";
+  for (size_t batch : {size_t{24}, size_t{10000}}) {
+    RunEpilogueShape(batch, 784, 256);
+    RunEpilogueShape(batch, 256, 256);
+  }
+  return 0;
+}
@@ -0,0 +1,223 @@
+// MIT License
+
+// Compares the trainers on the network of RunTrainingMode (784-256-256-10)
+// with a synthetic MNIST stand-in: sparse binary "digits", one random
+// prototype per class with a share of the pixels flipped in every sample.
+// NeuralNetwork::TrainStep, which only parallelizes inside each product, is
+// measured against DataParallelTrainer and HogwildTrainer with one to
+// NumThreads replicas or workers of the global pool:
+//  - throughput in samples per second over whole epochs, at the configured
+//    training batch size and a larger one,
+//  - time to reach a test accuracy, at the training batch size.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "batch_sampler.h"
+#include "data_parallel_trainer.h"
+#include "hogwild_trainer.h"
+#include "linear_layer.h"
+#include "matrix.h"
+#include "neural_network.h"
+#include "relu_layer.h"
+#include "thread_pool.h"
+
+namespace {
+
+constexpr size_t kInputs = 784;
+constexpr size_t kClasses = 10;
+// Share of the pixels set in a prototype. A sample clears kNoise of them
+// and sets about as many others.
+constexpr double kInk = 0.2;
+constexpr double kNoise = 0.6;
+
+constexpr size_t kThroughputRows = 6144;
+constexpr size_t kTrainRows = 4000;
+constexpr size_t kTestRows = 2000;
+constexpr float kTargetAccuracy = 0.97f;
+constexpr uint32_t kMaxEpochs = 20;
+constexpr size_t kTrainingBatch = 24;
+
+std::unique_ptr<NeuralNetwork<float>> MnistNetwork() {
+  auto network = std::make_unique<NeuralNetwork<float>>();
+  network->AddLayer(
+      std::make_unique<LinearLayer<float>>(kInputs, 256, 0.01f, 42));
+  network->AddLayer(std::make_unique<ReLULayer<float>>());
+  network->AddLayer(std::make_unique<LinearLayer<float>>(256, 256, 0.01f, 43));
+  network->AddLayer(std::make_unique<ReLULayer<float>>());
+  network->AddLayer(
+      std::make_unique<LinearLayer<float>>(256, kClasses, 0.01f, 44));
+  return network;
+}
+
+// Samples of the synthetic digits, the prototypes are the same for every
+// seed
+void SyntheticDigits(size_t rows, uint32_t seed, Matrix<float>& data,
+                     Matrix<float>& labels) {
+  std::mt19937 prototype_gen(1);
+  std::bernoulli_distribution ink(kInk);
+  Matrix<float> prototypes(kClasses, kInputs);
+  for (float& pixel : prototypes.ToVector()) {
+    pixel = ink(prototype_gen) ? 1.0f : 0.0f;
+  }
+
+  std::mt19937 gen(seed);
+  std::bernoulli_distribution clear(kNoise);
+  std::bernoulli_distribution appear(kNoise * kInk / (1.0 - kInk));
+  std::uniform_int_distribution<size_t> digit(0, kClasses - 1);
+  data.Resize(rows, kInputs);
+  Matrix<float> classes(rows, 1);
+  for (size_t r = 0; r < rows; ++r) {
+    const size_t c = digit(gen);
+    classes(r, 0) = static_cast<float>(c);
+    for (size_t i = 0; i < kInputs; ++i) {
+      const bool set =
+          prototypes(c, i) != 0.0f ? !clear(gen) : appear(gen);
+      data(r, i) = set ? 1.0f : 0.0f;
+    }
+  }
+  labels = Matrix<float>::OneHotEncode(classes, kClasses);
+}
+
+// A trainer under test: trains one epoch in the sampler's order
+using EpochFn = std::function<void(const BatchSampler&)>;
+
+// Trains every batch of sampler with step, one batch at a time
+template <typename StepFn>
+EpochFn StepEpoch(const Matrix<float>& data, const Matrix<float>& labels,
+                  StepFn&& step) {
+  auto data_batch = std::make_shared<Matrix<float>>();
+  auto labels_batch = std::make_shared<Matrix<float>>();
+  return [&data, &labels, data_batch, labels_batch,
+          step](const BatchSampler& sampler) mutable {
+    for (size_t batch = 0; batch < sampler.NumBatches(); ++batch) {
+      sampler.Gather(batch, data, *data_batch);
+      sampler.Gather(batch, labels, *labels_batch);
+      (void)step(*data_batch, *labels_batch);
+    }
+  };
+}
+
+// The trainers to compare on one network each: TrainStep, then
+// DataParallelTrainer and HogwildTrainer with 1, 2, 4, ... and finally
+// NumThreads replicas or workers. Calls run(name, network, epoch), where
+// epoch trains network in place.
+using RunFn = std::function<void(const std::string&, NeuralNetwork<float>&,
+                                 const EpochFn&)>;
+void ForEachTrainer(const Matrix<float>& data, const Matrix<float>& labels,
+                    const RunFn& run) {
+  {
+    std::unique_ptr<NeuralNetwork<float>> network = MnistNetwork();
+    run("TrainStep", *network, StepEpoch(data, labels, [&](auto& x, auto& y) {
+          return network->TrainStep(x, y);
+        }));
+  }
+  const uint32_t threads = ThreadPool::Global().NumThreads();
+  for (uint32_t count = 1;; count = std::min(count * 2, threads)) {
+    {
+      std::unique_ptr<NeuralNetwork<float>> network = MnistNetwork();
+      DataParallelTrainer<float> trainer(*network, count);
+      run("DataParallel x" + std::to_string(count), *network,
+          StepEpoch(data, labels, [&](auto& x, auto& y) {
+            return trainer.TrainStep(x, y);
+          }));
+    }
+    {
+      std::unique_ptr<NeuralNetwork<float>> network = MnistNetwork();
+      HogwildTrainer<float> trainer(*network, count);
+      run("Hogwild x" + std::to_string(count), *network,
+          [&](const BatchSampler& sampler) {
+            (void)trainer.TrainEpoch(sampler, data, labels);
+          });
+    }
+    if (count == threads)
+      break;
+  }
+}
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+void RunThroughput(size_t batch) {
+  Matrix<float> data;
+  Matrix<float> labels;
+  SyntheticDigits(kThroughputRows, 2, data, labels);
+  BatchSampler sampler(kThroughputRows, batch);
+
+  std::cout << "Throughput, batch " << batch << ":\n";
+  double baseline = 0.0;
+  ForEachTrainer(data, labels, [&](const std::string& name,
+                                   NeuralNetwork<float>&,
+                                   const EpochFn& epoch) {
+    epoch(sampler);  // Warm-up (buffers, packing scratch)
+    constexpr double kMinSeconds = 0.5;
+    uint64_t epochs = 0;
+    auto start = std::chrono::steady_clock::now();
+    do {
+      epoch(sampler);
+      ++epochs;
+    } while (Seconds(start) < kMinSeconds);
+    const double samples_per_second =
+        static_cast<double>(epochs * kThroughputRows) / Seconds(start);
+    if (baseline == 0.0)
+      baseline = samples_per_second;
+    std::cout << "  " << std::left << std::setw(18) << name << std::right
+              << std::fixed << std::setprecision(0) << std::setw(10)
+              << samples_per_second << " samples/s" << std::setprecision(2)
+              << std::setw(8) << samples_per_second / baseline << "x\n";
+  });
+}
+
+void RunTimeToAccuracy() {
+  Matrix<float> train_data;
+  Matrix<float> train_labels;
+  Matrix<float> test_data;
+  Matrix<float> test_labels;
+  SyntheticDigits(kTrainRows, 3, train_data, train_labels);
+  SyntheticDigits(kTestRows, 4, test_data, test_labels);
+
+  std::cout << "Time to " << kTargetAccuracy * 100.0f
+            << "% test accuracy, batch " << kTrainingBatch << ":\n";
+  ForEachTrainer(train_data, train_labels, [&](const std::string& name,
+                                               NeuralNetwork<float>& network,
+                                               const EpochFn& epoch) {
+    // Only training time counts, not the evaluation after every epoch
+    BatchSampler sampler(kTrainRows, kTrainingBatch);
+    double seconds = 0.0;
+    float accuracy = 0.0f;
+    uint32_t epochs = 0;
+    while (accuracy < kTargetAccuracy && epochs < kMaxEpochs) {
+      sampler.Shuffle(epochs + 42);
+      auto start = std::chrono::steady_clock::now();
+      epoch(sampler);
+      seconds += Seconds(start);
+      ++epochs;
+      accuracy = network.EvaluateAccuracy(test_data, test_labels);
+    }
+    std::cout << "  " << std::left << std::setw(18) << name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(8)
+              << seconds << " s  " << std::setw(3) << epochs
+              << " epochs  " << std::setprecision(2) << accuracy * 100.0f
+              << "%\n";
+  });
+}
+
+}  // namespace
+
+int main() {
+  std::cout << "Pool threads: " << ThreadPool::Global().NumThreads() << "\n";
+  RunThroughput(kTrainingBatch);
+  RunThroughput(256);
+  RunTimeToAccuracy();
+  return 0;
+}
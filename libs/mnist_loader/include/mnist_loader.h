@@ -5,7 +5,6 @@
 
 #include <fstream>
 #include <string>
-#include <vector>
 
 #include "dataset.h"
 
@@ -25,8 +24,8 @@ class MNISTLoader {
   int32_t ReverseInt(int32_t i) const;
   int32_t ReadInt32(std::ifstream& file) const;
   void SetSystemEndianness() noexcept;
-  std::vector<uint8_t> ReadImages(const std::string& path) const;
-  std::vector<uint8_t> ReadLabels(const std::string& path) const;
+  Memory::AlignedVector<uint8_t> ReadImages(const std::string& path) const;
+  Memory::AlignedVector<uint8_t> ReadLabels(const std::string& path) const;
 
   enum class Endianness { kLittle, kBig };
   Endianness system_endianness_;
@@ -26,7 +26,8 @@ int32_t MNISTLoader::ReadInt32(std::ifstream& file) const {
   return num;
 }
 
-std::vector<uint8_t> MNISTLoader::ReadImages(const std::string& path) const {
+Memory::AlignedVector<uint8_t> MNISTLoader::ReadImages(
+    const std::string& path) const {
   std::ifstream file(path, std::ios::binary);
   CHECK(file.is_open()) << "Could not open file: " << path;
   LOG(INFO) << "Reading images from: " << path;
@@ -46,13 +47,14 @@ std::vector<uint8_t> MNISTLoader::ReadImages(const std::string& path) const {
       << "Unexpected image dimensions in file: " << path;
 
   // Read image data
-  std::vector<uint8_t> images(num_images * num_rows * num_cols);
+  Memory::AlignedVector<uint8_t> images(num_images * num_rows * num_cols);
   file.read(reinterpret_cast<char*>(images.data()), images.size());
   LOG(INFO) << "Completed reading images from: " << path;
   return images;
 }
 
-std::vector<uint8_t> MNISTLoader::ReadLabels(const std::string& path) const {
+Memory::AlignedVector<uint8_t> MNISTLoader::ReadLabels(
+    const std::string& path) const {
   std::ifstream file(path, std::ios::binary);
   CHECK(file.is_open()) << "Could not open file: " << path;
   LOG(INFO) << "Reading labels from: " << path;
@@ -63,7 +65,7 @@ std::vector<uint8_t> MNISTLoader::ReadLabels(const std::string& path) const {
 
   // Read label data
   const int32_t num_labels = ReadInt32(file);
-  std::vector<uint8_t> labels(num_labels);
+  Memory::AlignedVector<uint8_t> labels(num_labels);
   file.read(reinterpret_cast<char*>(labels.data()), labels.size());
   LOG(INFO) << "Completed reading labels from: " << path;
   return labels;
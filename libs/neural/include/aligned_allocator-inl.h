@@ -0,0 +1,70 @@
+// MIT License
+
+// This file contains the implementation of the AlignedAllocator class.
+// It is meant to be included only inside aligned_allocator.h.
+
+#include <limits>
+#include <new>
+
+#include <absl/log/check.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace Memory {
+
+namespace internal {
+
+inline std::atomic<bool> huge_pages_enabled{true};
+
+// Alignment of a buffer of the given size. It depends on the size only, so
+// deallocation finds the same alignment from the element count.
+inline size_t AlignmentFor(size_t bytes) noexcept {
+  return bytes >= kHugePageSize ? kHugePageSize : kAlignment;
+}
+
+// Rounds up to whole alignment units, so huge page advice never covers
+// memory outside the buffer
+inline size_t PaddedSize(size_t bytes, size_t alignment) noexcept {
+  return (bytes + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace internal
+
+inline void SetHugePagesEnabled(bool enabled) noexcept {
+  internal::huge_pages_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+inline bool HugePagesEnabled() noexcept {
+  return internal::huge_pages_enabled.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+T* AlignedAllocator<T>::allocate(size_t count) {
+  // Leaves room for the padding below, and keeps the size within what
+  // operator new accepts
+  CHECK(count <= (std::numeric_limits<ptrdiff_t>::max() - kHugePageSize) /
+                     sizeof(T) &&
+        "Allocation size overflows.");
+  const size_t bytes = count * sizeof(T);
+  const size_t alignment = internal::AlignmentFor(bytes);
+  const size_t padded = internal::PaddedSize(bytes, alignment);
+  void* pointer = ::operator new(padded, std::align_val_t(alignment));
+#if defined(__linux__)
+  // Advice only, the kernel falls back to small pages if THP is disabled
+  if (alignment == kHugePageSize && HugePagesEnabled())
+    (void)madvise(pointer, padded, MADV_HUGEPAGE);
+#endif
+  return static_cast<T*>(pointer);
+}
+
+template <typename T>
+void AlignedAllocator<T>::deallocate(T* pointer, size_t count) noexcept {
+  const size_t bytes = count * sizeof(T);
+  const size_t alignment = internal::AlignmentFor(bytes);
+  ::operator delete(pointer, internal::PaddedSize(bytes, alignment),
+                    std::align_val_t(alignment));
+}
+
+}  // namespace Memory
@@ -0,0 +1,57 @@
+// MIT License
+
+// Defines the storage policy of Matrix and dataset buffers.
+// AlignedAllocator aligns every buffer to a cache line, so SIMD loads of a
+// row start never straddle two lines. Buffers of a huge page or more are
+// aligned to the huge page size and, on Linux, advised to use transparent
+// huge pages: the 188 MB training set then needs ~90 TLB entries instead of
+// ~46000.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_ALIGNED_ALLOCATOR_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_ALIGNED_ALLOCATOR_H_
+
+#include <cstddef>
+
+#include <atomic>
+#include <vector>
+
+namespace Memory {
+
+// Alignment of every buffer, one cache line (a full AVX-512 register)
+inline constexpr size_t kAlignment = 64;
+// Buffers at least this large are aligned to it and may use huge pages
+inline constexpr size_t kHugePageSize = size_t{2} << 20;
+
+// Whether large buffers are advised to use transparent huge pages (Linux
+// only, on by default). Affects buffers allocated after the call.
+void SetHugePagesEnabled(bool enabled) noexcept;
+bool HugePagesEnabled() noexcept;
+
+// Standard allocator returning kAlignment (or kHugePageSize) aligned
+// storage. Stateless, all instances are interchangeable.
+template <typename T>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+
+  AlignedAllocator() noexcept = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U>&) noexcept {}
+
+  T* allocate(size_t count);
+  void deallocate(T* pointer, size_t count) noexcept;
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U>&) const noexcept {
+    return true;
+  }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+}  // namespace Memory
+
+#include "aligned_allocator-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_ALIGNED_ALLOCATOR_H_
@@ -0,0 +1,120 @@
+// MIT License
+
+// This file contains the implementation of the BatchPrefetcher class
+// template. It is meant to be included only inside batch_prefetcher.h.
+
+#include <chrono>
+#include <utility>
+
+#include <absl/log/check.h>
+
+template <std::floating_point Fp>
+BatchPrefetcher<Fp>::BatchPrefetcher(size_t depth)
+    : ring_(depth + 1), depth_(depth) {
+  CHECK(depth > 0) << "Prefetch depth must be positive.";
+  producer_ = std::jthread([this] { Produce(); });
+}
+
+template <std::floating_point Fp>
+BatchPrefetcher<Fp>::~BatchPrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  freed_.notify_one();
+}
+
+template <std::floating_point Fp>
+size_t BatchPrefetcher<Fp>::Depth() const noexcept {
+  return depth_;
+}
+
+template <std::floating_point Fp>
+void BatchPrefetcher<Fp>::Reserve(size_t max_rows, size_t data_cols,
+                                  size_t labels_cols) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(consumed_ == num_batches_)
+      << "Cannot reserve the buffers while an epoch is in flight.";
+  for (Batch& batch : ring_) {
+    batch.data.Reserve(max_rows, data_cols);
+    batch.labels.Reserve(max_rows, labels_cols);
+  }
+}
+
+template <std::floating_point Fp>
+void BatchPrefetcher<Fp>::Start(size_t num_batches, FillFn fill) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK(consumed_ == num_batches_)
+        << "Every batch of the previous epoch must be consumed first.";
+    // The producer is idle: it has filled every batch of the last epoch
+    fill_ = std::move(fill);
+    num_batches_ = num_batches;
+    produced_ = 0;
+    consumed_ = 0;
+    stats_ = PrefetchStats();
+  }
+  freed_.notify_one();
+}
+
+template <std::floating_point Fp>
+const typename BatchPrefetcher<Fp>::Batch& BatchPrefetcher<Fp>::Next() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  CHECK(consumed_ < num_batches_) << "Every batch of the epoch was returned.";
+  stats_.ready_sum += produced_ - consumed_;
+  if (produced_ == consumed_) {
+    ++stats_.stalls;
+    const auto start = std::chrono::steady_clock::now();
+    filled_.wait(lock, [this] { return produced_ > consumed_; });
+    stats_.stall_seconds += std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+  }
+  const Batch& batch = ring_[consumed_ % ring_.size()];
+  ++consumed_;
+  ++stats_.batches;
+  lock.unlock();
+  // The buffer of the previous batch is free now
+  freed_.notify_one();
+  return batch;
+}
+
+template <std::floating_point Fp>
+size_t BatchPrefetcher<Fp>::Ready() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return produced_ - consumed_;
+}
+
+template <std::floating_point Fp>
+PrefetchStats BatchPrefetcher<Fp>::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+template <std::floating_point Fp>
+void BatchPrefetcher<Fp>::Produce() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // The batch in training, the ready ones and the one to fill are at
+    // most depth + 1 consecutive batches, so they lie in distinct buffers
+    freed_.wait(lock, [this] {
+      return stop_ ||
+             (produced_ < num_batches_ && produced_ - consumed_ < depth_);
+    });
+    if (stop_)
+      return;
+    const size_t batch = produced_;
+    Batch& buffer = ring_[batch % ring_.size()];
+    // Start does not replace fill_ until this epoch is consumed
+    lock.unlock();
+    const auto start = std::chrono::steady_clock::now();
+    fill_(batch, buffer.data, buffer.labels);
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    lock.lock();
+    stats_.fill_seconds += seconds;
+    ++produced_;
+    filled_.notify_one();
+  }
+}
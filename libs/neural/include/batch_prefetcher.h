@@ -0,0 +1,127 @@
+// MIT License
+
+// Defines BatchPrefetcher, the input stage of the training loops. A
+// producer thread of its own fills the next batches of an epoch (gathers
+// the rows, and converts or scales them if the fill function does so) into
+// a ring of reused buffers while the consumer trains on the current one, so
+// building a batch overlaps the step instead of preceding it.
+//
+// The producer runs up to `depth` batches ahead. Its fills may still use the
+// thread pool (e.g. Matrix::GatherRowsInto), it waits as an external thread
+// there and never blocks a pool worker. How often and how long the consumer
+// waited for a batch, and how many batches were ready when it asked, are
+// kept per epoch (PrefetchStats): a stall means the input stage, not the
+// step, limits training.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_BATCH_PREFETCHER_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_BATCH_PREFETCHER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <concepts>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "matrix.h"
+
+// Input stage counters of one epoch.
+struct PrefetchStats {
+  // Batches returned by Next
+  uint64_t batches = 0;
+  // Calls of Next that found no batch ready and waited
+  uint64_t stalls = 0;
+  // Time Next waited
+  double stall_seconds = 0.0;
+  // Time the producer spent filling batches
+  double fill_seconds = 0.0;
+  // Sum over the calls of Next of the batches ready when it was called
+  uint64_t ready_sum = 0;
+
+  // Mean queue depth seen by the consumer, between 0 (every batch was
+  // waited for) and the prefetch depth
+  double MeanQueueDepth() const {
+    return batches == 0 ? 0.0
+                        : static_cast<double>(ready_sum) /
+                              static_cast<double>(batches);
+  }
+};
+
+template <std::floating_point Fp>
+class BatchPrefetcher {
+ public:
+  using MatType = Matrix<Fp>;
+  // Fills the data and labels of the batch into the buffers, whose storage
+  // is reused between batches. Runs on the producer thread.
+  using FillFn = std::function<void(size_t batch, MatType& data_buffer,
+                                    MatType& labels_buffer)>;
+
+  // Batches filled ahead of the one in training by default: one is built
+  // while the next one waits, so a slow batch does not stall the step
+  static constexpr size_t kDefaultDepth = 2;
+
+  struct Batch {
+    MatType data;
+    MatType labels;
+  };
+
+  // Starts the producer thread, which waits for the first epoch.
+  // Requires depth > 0.
+  explicit BatchPrefetcher(size_t depth = kDefaultDepth);
+  // Stops the producer once its current fill, if any, returns.
+  ~BatchPrefetcher();
+
+  BatchPrefetcher(const BatchPrefetcher&) = delete;
+  BatchPrefetcher& operator=(const BatchPrefetcher&) = delete;
+
+  size_t Depth() const noexcept;
+
+  // Reserves every buffer of the ring for batches of up to max_rows rows,
+  // so fills never grow one. Not allowed while an epoch is in flight.
+  void Reserve(size_t max_rows, size_t data_cols, size_t labels_cols);
+
+  // Starts an epoch: the producer fills batches 0 to num_batches - 1, in
+  // order, with fill. Every batch of the previous epoch must have been
+  // returned by Next. Resets the stats.
+  void Start(size_t num_batches, FillFn fill);
+  // Returns the next batch of the epoch, waiting for the producer if it is
+  // not ready yet. The batch stays valid until the next call of Next or
+  // Start, then its buffer is refilled.
+  const Batch& Next();
+
+  // Batches filled and not yet returned by Next
+  size_t Ready() const;
+  // Counters of the current epoch
+  PrefetchStats Stats() const;
+
+ private:
+  void Produce();
+
+  // depth + 1 buffers: the batch in training and up to depth ready ones.
+  // Batch b of an epoch is filled into buffer b % size.
+  std::vector<Batch> ring_;
+  size_t depth_;
+
+  mutable std::mutex mutex_;
+  // Signals a filled batch to the consumer
+  std::condition_variable filled_;
+  // Signals a free buffer, a new epoch or stop to the producer
+  std::condition_variable freed_;
+  FillFn fill_;
+  size_t num_batches_ = 0;
+  // Batches of the epoch filled, and returned by Next
+  size_t produced_ = 0;
+  size_t consumed_ = 0;
+  bool stop_ = false;
+  PrefetchStats stats_;
+
+  // Declared last, so it is joined before the state above is destroyed
+  std::jthread producer_;
+};
+
+#include "batch_prefetcher-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_BATCH_PREFETCHER_H_
@@ -0,0 +1,55 @@
+// MIT License
+
+// This file contains the implementation of the BatchSampler class.
+// It is meant to be included only inside batch_sampler.h.
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include <absl/log/check.h>
+
+inline BatchSampler::BatchSampler(size_t num_samples, size_t batch_size)
+    : permutation_(num_samples), batch_size_(batch_size) {
+  CHECK(batch_size > 0 && "Batch size must be positive.");
+  std::iota(permutation_.begin(), permutation_.end(), size_t{0});
+}
+
+inline void BatchSampler::Shuffle(uint32_t seed) {
+  // Shuffle from the original order, so an epoch's order depends only on
+  // its seed (the same order as ShuffleRows(seed))
+  std::iota(permutation_.begin(), permutation_.end(), size_t{0});
+  std::mt19937 gen(seed);
+  std::shuffle(permutation_.begin(), permutation_.end(), gen);
+}
+
+inline size_t BatchSampler::NumSamples() const noexcept {
+  return permutation_.size();
+}
+
+inline size_t BatchSampler::NumBatches() const noexcept {
+  return (permutation_.size() + batch_size_ - 1) / batch_size_;
+}
+
+inline std::span<const size_t> BatchSampler::BatchIndices(size_t batch) const {
+  CHECK(batch < NumBatches() && "Batch index out of bounds.");
+  const size_t begin = batch * batch_size_;
+  const size_t end = std::min(begin + batch_size_, permutation_.size());
+  return std::span<const size_t>(permutation_).subspan(begin, end - begin);
+}
+
+template <Numeric T>
+void BatchSampler::Gather(size_t batch, const Matrix<T>& source,
+                          Matrix<T>& batch_buffer) const {
+  CHECK(source.Rows() == permutation_.size() &&
+        "Source must have one row per sample.");
+  source.GatherRowsInto(BatchIndices(batch), batch_buffer);
+}
+
+template <Numeric T, Numeric U>
+void BatchSampler::Gather(size_t batch, const Matrix<T>& source,
+                          Matrix<U>& batch_buffer, U scale) const {
+  CHECK(source.Rows() == permutation_.size() &&
+        "Source must have one row per sample.");
+  source.GatherRowsInto(BatchIndices(batch), batch_buffer, scale);
+}
@@ -0,0 +1,54 @@
+// MIT License
+
+// Defines BatchSampler, which draws shuffled minibatches from a dataset.
+// Only a permutation of the sample indices is shuffled each epoch. The rows
+// of a batch are then gathered straight from the unshuffled data into a
+// reused batch buffer (Matrix::GatherRowsInto), so an epoch reads every
+// sample once instead of copying the whole dataset into a shuffled copy.
+// A given seed yields the same order as Matrix::ShuffleRows.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_BATCH_SAMPLER_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_BATCH_SAMPLER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+#include <vector>
+
+#include "matrix.h"
+
+class BatchSampler {
+ public:
+  // Starts with the samples in their original order.
+  BatchSampler(size_t num_samples, size_t batch_size);
+
+  // Draws a new permutation of the samples for the seed.
+  void Shuffle(uint32_t seed);
+
+  size_t NumSamples() const noexcept;
+  // The last batch holds the remaining samples and may be smaller
+  size_t NumBatches() const noexcept;
+
+  // Sample indices of the batch, in the current order
+  std::span<const size_t> BatchIndices(size_t batch) const;
+
+  // Gathers the rows of the batch from source (one row per sample) into
+  // batch_buffer, whose storage is reused between batches.
+  template <Numeric T>
+  void Gather(size_t batch, const Matrix<T>& source,
+              Matrix<T>& batch_buffer) const;
+  // Same, converted to U and scaled on the way (e.g. raw uint8_t pixels
+  // into a normalized float batch).
+  template <Numeric T, Numeric U>
+  void Gather(size_t batch, const Matrix<T>& source, Matrix<U>& batch_buffer,
+              U scale) const;
+
+ private:
+  std::vector<size_t> permutation_;
+  size_t batch_size_;
+};
+
+#include "batch_sampler-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_BATCH_SAMPLER_H_
@@ -0,0 +1,240 @@
+// MIT License
+
+// This file contains the implementation of the Calibration functions.
+// It is meant to be included only inside calibration.h.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include <absl/strings/str_cat.h>
+
+#include "matrix.h"
+
+namespace Calibration {
+
+template <typename Fn>
+double SecondsPerCall(double min_seconds, Fn&& fn) {
+  fn();  // Warm-up (page faults, packing buffers, caches, sleeping workers)
+  uint64_t calls = 0;
+  auto start = std::chrono::steady_clock::now();
+  double elapsed = 0.0;
+  do {
+    fn();
+    ++calls;
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            start)
+                  .count();
+  } while (elapsed < min_seconds);
+  return elapsed / static_cast<double>(calls);
+}
+
+namespace internal {
+
+// Row-major operands of an m x k by k x n product.
+struct Operands {
+  size_t m;
+  size_t n;
+  size_t k;
+  std::vector<float> a;
+  std::vector<float> b;
+  std::vector<float> c;
+
+  Operands(size_t rows, size_t cols, size_t depth)
+      : m(rows), n(cols), k(depth), a(m * k), b(k * n), c(m * n) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (float& value : a)
+      value = dist(gen);
+    for (float& value : b)
+      value = dist(gen);
+  }
+};
+
+// Times the blockings derived from halved, detected and doubled L1 and L2
+// capacities on a first-layer sized product and returns the fastest.
+inline Gemm::BlockSizes CalibrateBlocks(const CalibrationOptions& options) {
+  const Gemm::CacheSizes detected = Gemm::CacheSizes::Detect();
+  std::vector<Gemm::BlockSizes> candidates;
+  for (double l1_scale : {0.5, 1.0, 2.0}) {
+    for (double l2_scale : {0.5, 1.0, 2.0}) {
+      Gemm::CacheSizes caches = detected;
+      caches.l1 = static_cast<size_t>(static_cast<double>(detected.l1) *
+                                      l1_scale);
+      caches.l2 = static_cast<size_t>(static_cast<double>(detected.l2) *
+                                      l2_scale);
+      Gemm::BlockSizes blocks = Gemm::ComputeBlockSizes<float>(caches);
+      bool seen = std::any_of(
+          candidates.begin(), candidates.end(),
+          [&blocks](const Gemm::BlockSizes& other) {
+            return other.mc == blocks.mc && other.kc == blocks.kc &&
+                   other.nc == blocks.nc;
+          });
+      if (!seen)
+        candidates.push_back(blocks);
+    }
+  }
+
+  Operands operands(256, 256, 784);
+  Gemm::BlockSizes best = candidates.front();
+  double best_seconds = 0.0;
+  for (const Gemm::BlockSizes& blocks : candidates) {
+    double seconds = SecondsPerCall(options.seconds_per_measurement, [&] {
+      Gemm::Multiply<float>(operands.m, operands.n, operands.k,
+                            operands.a.data(), operands.k, operands.b.data(),
+                            operands.n, operands.c.data(), operands.n, blocks);
+    });
+    if (best_seconds == 0.0 || seconds < best_seconds) {
+      best = blocks;
+      best_seconds = seconds;
+    }
+  }
+  return best;
+}
+
+// Returns the smallest work per thread (doubling from 32K multiply-adds) at
+// which two threads beat one by at least 10% on a batch-sized product.
+inline uint64_t CalibrateMinWork(ThreadPool& pool,
+                                 const CalibrationOptions& options) {
+  constexpr uint64_t kFirstWork = uint64_t{1} << 15;
+  constexpr uint64_t kLastWork = uint64_t{1} << 26;
+  if (pool.MaxParallelism() < 2)
+    return ParallelProfile().min_work_per_thread;  // Nothing to split across
+
+  const size_t m = std::max<size_t>(options.batch_size, 1);
+  constexpr size_t kCols = 256;
+  for (uint64_t work = kFirstWork; work <= kLastWork; work *= 2) {
+    // Two threads, work multiply-adds each
+    const size_t depth = std::max<size_t>(2 * work / (m * kCols), 1);
+    Operands operands(m, kCols, depth);
+    double serial = SecondsPerCall(options.seconds_per_measurement, [&] {
+      Gemm::Multiply<float>(m, kCols, depth, operands.a.data(), depth,
+                            operands.b.data(), kCols, operands.c.data(),
+                            kCols);
+    });
+    double parallel = SecondsPerCall(options.seconds_per_measurement, [&] {
+      Gemm::ParallelMultiply<float>(m, kCols, depth, operands.a.data(), depth,
+                                    operands.b.data(), kCols,
+                                    operands.c.data(), kCols, pool, 2);
+    });
+    if (parallel < 0.9 * serial)
+      return work;
+  }
+  // Threading never paid off, only split products far beyond our layers
+  return kLastWork * 2;
+}
+
+// Returns the smallest thread count within 5% of the fastest one on an
+// evaluation-sized product, trying powers of two and the whole pool.
+inline uint32_t CalibrateMaxParallelism(ThreadPool& pool,
+                                        const CalibrationOptions& options) {
+  const uint32_t max_threads = pool.MaxParallelism();
+  std::vector<uint32_t> counts;
+  for (uint32_t threads = 1; threads < max_threads; threads *= 2) {
+    counts.push_back(threads);
+  }
+  counts.push_back(max_threads);
+
+  Operands operands(1024, 256, 784);
+  std::vector<double> seconds;
+  for (uint32_t threads : counts) {
+    seconds.push_back(SecondsPerCall(options.seconds_per_measurement, [&] {
+      Gemm::ParallelMultiply<float>(operands.m, operands.n, operands.k,
+                                    operands.a.data(), operands.k,
+                                    operands.b.data(), operands.n,
+                                    operands.c.data(), operands.n, pool,
+                                    threads);
+    }));
+  }
+  const double best = *std::min_element(seconds.begin(), seconds.end());
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (seconds[i] <= 1.05 * best)
+      return counts[i];
+  }
+  return max_threads;
+}
+
+}  // namespace internal
+
+inline ParallelProfile Run(ThreadPool& pool,
+                           const CalibrationOptions& options) {
+  ParallelProfile profile;
+  profile.float_blocks = internal::CalibrateBlocks(options);
+  profile.min_work_per_thread = internal::CalibrateMinWork(pool, options);
+  profile.max_parallelism = internal::CalibrateMaxParallelism(pool, options);
+  return profile;
+}
+
+inline absl::Status Save(const ParallelProfile& profile,
+                         const std::string& file_path) {
+  std::ofstream out(file_path);
+  if (!out.is_open())
+    return absl::UnavailableError(
+        absl::StrCat("Could not open file: ", file_path));
+
+  out << "# Parallel profile, regenerate with the calibrate mode\n";
+  out << "min_work_per_thread " << profile.min_work_per_thread << "\n";
+  out << "max_parallelism " << profile.max_parallelism << "\n";
+  out << "float_mc " << profile.float_blocks.mc << "\n";
+  out << "float_kc " << profile.float_blocks.kc << "\n";
+  out << "float_nc " << profile.float_blocks.nc << "\n";
+  if (!out)
+    return absl::DataLossError(
+        absl::StrCat("Failed to write profile: ", file_path));
+  return absl::OkStatus();
+}
+
+inline absl::StatusOr<ParallelProfile> Load(const std::string& file_path) {
+  std::ifstream in(file_path);
+  if (!in.is_open())
+    return absl::UnavailableError(
+        absl::StrCat("Could not open file: ", file_path));
+
+  ParallelProfile profile;
+  uint64_t max_parallelism = profile.max_parallelism;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::istringstream fields(line);
+    std::string key;
+    uint64_t value;
+    if (!(fields >> key >> value))
+      return absl::InvalidArgumentError(
+          absl::StrCat("Malformed profile line: ", line));
+
+    if (key == "min_work_per_thread") {
+      profile.min_work_per_thread = value;
+    } else if (key == "max_parallelism") {
+      max_parallelism = value;
+    } else if (key == "float_mc") {
+      profile.float_blocks.mc = value;
+    } else if (key == "float_kc") {
+      profile.float_blocks.kc = value;
+    } else if (key == "float_nc") {
+      profile.float_blocks.nc = value;
+    } else {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unknown profile key: ", key));
+    }
+  }
+
+  if (profile.min_work_per_thread == 0 || profile.float_blocks.mc == 0 ||
+      profile.float_blocks.kc == 0 || profile.float_blocks.nc == 0)
+    return absl::InvalidArgumentError("Profile values must be positive.");
+  profile.max_parallelism = static_cast<uint32_t>(
+      std::min<uint64_t>(max_parallelism, UINT32_MAX));
+  return profile;
+}
+
+inline void Apply(const ParallelProfile& profile) {
+  Matrix<float>::kMinWorkPerThread = profile.min_work_per_thread;
+  Matrix<double>::kMinWorkPerThread = profile.min_work_per_thread;
+  Gemm::SetDefaultBlockSizes<float>(profile.float_blocks);
+}
+
+}  // namespace Calibration
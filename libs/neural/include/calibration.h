@@ -0,0 +1,72 @@
+// MIT License
+
+// Defines the host calibration of the parallel matrix paths.
+// Calibration::Run measures, on the current machine, the work size at which
+// splitting a product across threads starts to pay off, the thread count
+// past which large products stop getting faster, and the GEMM cache blocking
+// that runs fastest. The results are kept in a small text profile so that
+// every run on the same host can load them at startup instead of relying on
+// fixed defaults.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_CALIBRATION_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_CALIBRATION_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+
+#include <absl/status/status.h>
+#include <absl/status/statusor.h>
+
+#include "gemm.h"
+#include "thread_pool.h"
+
+// Host-specific thresholds for the parallel and blocked matrix paths.
+struct ParallelProfile {
+  // Multiply-adds a thread must get before a product is split
+  // (Matrix<T>::kMinWorkPerThread for floating-point T)
+  uint64_t min_work_per_thread = 1'000'000;
+  // Threads a single product is split across (0 uses the whole pool)
+  uint32_t max_parallelism = 0;
+  // Cache blocking of the float GEMM engine
+  Gemm::BlockSizes float_blocks = Gemm::DefaultBlockSizes<float>();
+};
+
+struct CalibrationOptions {
+  // Each configuration is timed for at least this long
+  double seconds_per_measurement = 0.05;
+  // Rows of the products timed for the threading threshold, the training
+  // batch size is representative
+  size_t batch_size = 24;
+};
+
+namespace Calibration {
+
+// Runs fn once to warm up, then repeatedly for at least min_seconds, and
+// returns the seconds per call. Every measurement of Run and of the
+// benchmarks is taken this way.
+template <typename Fn>
+double SecondsPerCall(double min_seconds, Fn&& fn);
+
+// Measures a profile for the host, using pool for the parallel timings.
+ParallelProfile Run(ThreadPool& pool,
+                    const CalibrationOptions& options = CalibrationOptions());
+
+// Writes the profile as "key value" lines.
+absl::Status Save(const ParallelProfile& profile, const std::string& file_path);
+
+// Reads a profile written by Save.
+absl::StatusOr<ParallelProfile> Load(const std::string& file_path);
+
+// Installs the thresholds and blocking of the profile for Matrix<float>,
+// Matrix<double> and the GEMM engine. max_parallelism is applied through
+// ThreadPoolOptions by the caller.
+// Must not be called while matrix operations are in flight.
+void Apply(const ParallelProfile& profile);
+
+}  // namespace Calibration
+
+#include "calibration-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_CALIBRATION_H_
@@ -5,7 +5,14 @@
 
 #include <cstdint>
 
+#include <concepts>
+
 // Contains common data types for template classes
+
+// Element types of Matrix and MatrixView
+template <typename T>
+concept Numeric = std::integral<T> || std::floating_point<T>;
+
 enum class DataType : uint32_t {
 	kUnknown = 0,
 	kFloat = 1,
@@ -13,4 +20,11 @@ enum class DataType : uint32_t {
 	kInt32 = 3,
 };
 
+// Whether a multiplication operand is used as stored or transposed (the
+// BLAS "N" and "T" operations)
+enum class Transpose {
+  kNo,
+  kYes,
+};
+
 #endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_COMMON_TYPES_H_
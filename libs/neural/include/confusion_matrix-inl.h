@@ -0,0 +1,66 @@
+// MIT License
+
+// This file contains the implementation of the ConfusionMatrix class.
+// It is meant to be included only inside confusion_matrix.h.
+
+#include <absl/log/check.h>
+
+inline ConfusionMatrix::ConfusionMatrix(size_t num_classes)
+    : num_classes_(num_classes), counts_(num_classes * num_classes) {}
+
+inline size_t ConfusionMatrix::NumClasses() const noexcept {
+  return num_classes_;
+}
+
+inline void ConfusionMatrix::Add(size_t true_class, size_t predicted_class) {
+  CHECK(true_class < num_classes_ && predicted_class < num_classes_ &&
+        "Class index out of bounds.");
+  ++counts_[true_class * num_classes_ + predicted_class];
+  ++samples_;
+}
+
+inline void ConfusionMatrix::Merge(const ConfusionMatrix& other) {
+  CHECK(other.num_classes_ == num_classes_ &&
+        "Confusion matrices must have the same number of classes.");
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  samples_ += other.samples_;
+}
+
+inline uint64_t ConfusionMatrix::Count(size_t true_class,
+                                       size_t predicted_class) const {
+  CHECK(true_class < num_classes_ && predicted_class < num_classes_ &&
+        "Class index out of bounds.");
+  return counts_[true_class * num_classes_ + predicted_class];
+}
+
+inline uint64_t ConfusionMatrix::Samples() const noexcept {
+  return samples_;
+}
+
+inline uint64_t ConfusionMatrix::Correct() const {
+  uint64_t correct = 0;
+  for (size_t c = 0; c < num_classes_; ++c) {
+    correct += counts_[c * num_classes_ + c];
+  }
+  return correct;
+}
+
+inline float ConfusionMatrix::Accuracy() const {
+  if (samples_ == 0)
+    return 0.0f;
+  return static_cast<float>(Correct()) / static_cast<float>(samples_);
+}
+
+inline float ConfusionMatrix::ClassAccuracy(size_t true_class) const {
+  CHECK(true_class < num_classes_ && "Class index out of bounds.");
+  uint64_t samples = 0;
+  for (size_t p = 0; p < num_classes_; ++p) {
+    samples += counts_[true_class * num_classes_ + p];
+  }
+  if (samples == 0)
+    return 0.0f;
+  return static_cast<float>(Count(true_class, true_class)) /
+         static_cast<float>(samples);
+}
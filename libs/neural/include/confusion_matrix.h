@@ -0,0 +1,46 @@
+// MIT License
+
+// Defines ConfusionMatrix, which counts classification results by true and
+// predicted class. Partial matrices (e.g. of chunks evaluated on different
+// threads) are combined with Merge.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_CONFUSION_MATRIX_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_CONFUSION_MATRIX_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vector>
+
+class ConfusionMatrix {
+ public:
+  explicit ConfusionMatrix(size_t num_classes = 0);
+
+  size_t NumClasses() const noexcept;
+
+  // Records one sample of true_class predicted as predicted_class.
+  void Add(size_t true_class, size_t predicted_class);
+  // Adds the counts of other, which must have as many classes.
+  void Merge(const ConfusionMatrix& other);
+
+  // Samples of true_class predicted as predicted_class
+  uint64_t Count(size_t true_class, size_t predicted_class) const;
+  uint64_t Samples() const noexcept;
+  uint64_t Correct() const;
+
+  // Fraction of all samples predicted correctly, 0 without samples
+  float Accuracy() const;
+  // Fraction of the samples of true_class predicted correctly (its recall),
+  // 0 if the class has no samples
+  float ClassAccuracy(size_t true_class) const;
+
+ private:
+  size_t num_classes_;
+  // Row-major num_classes_ x num_classes_, rows are true classes
+  std::vector<uint64_t> counts_;
+  uint64_t samples_ = 0;
+};
+
+#include "confusion_matrix-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_CONFUSION_MATRIX_H_
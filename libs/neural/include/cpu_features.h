@@ -0,0 +1,160 @@
+// MIT License
+
+// Detects the SIMD instruction sets available on the host CPU and provides
+// the compiler macros used to build per-instruction-set kernel variants.
+//
+// Kernels are written once as plain loops and instantiated inside functions
+// carrying NEURAL_TARGET_AVX2 / NEURAL_TARGET_AVX512, so the compiler emits
+// a separate vectorized body for each instruction set. The variant is then
+// picked at runtime from ActiveSimdLevel().
+// Compilers without per-function target attributes (e.g. MSVC) only build the
+// portable variant.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_CPU_FEATURES_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_CPU_FEATURES_H_
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define NEURAL_ARCH_X86 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// Per-function instruction set selection
+#if defined(NEURAL_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define NEURAL_HAS_TARGET_ATTRIBUTES 1
+#define NEURAL_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define NEURAL_TARGET_AVX512 \
+  __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma")))
+#else
+#define NEURAL_HAS_TARGET_ATTRIBUTES 0
+#define NEURAL_TARGET_AVX2
+#define NEURAL_TARGET_AVX512
+#endif
+
+// GCC and Clang vector extensions (vector_size types and
+// __builtin_shufflevector), used where plain loops do not vectorize. Kernels
+// fall back to scalar loops without them.
+#if defined(__GNUC__) || defined(__clang__)
+#define NEURAL_HAS_VECTOR_EXTENSIONS 1
+#else
+#define NEURAL_HAS_VECTOR_EXTENSIONS 0
+#endif
+
+// Kernel bodies must be inlined into the target-specific wrappers to be
+// compiled for that instruction set.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define NEURAL_ALWAYS_INLINE __forceinline
+#elif defined(__GNUC__) || defined(__clang__)
+#define NEURAL_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define NEURAL_ALWAYS_INLINE inline
+#endif
+
+// Requests full unrolling of small fixed-trip-count loops.
+#if defined(__GNUC__) || defined(__clang__)
+#define NEURAL_UNROLL _Pragma("GCC unroll 16")
+#else
+#define NEURAL_UNROLL
+#endif
+
+// Instruction set levels, ordered so that a higher level implies the lower.
+enum class SimdLevel : uint32_t {
+  kPortable = 0,
+  kAvx2 = 1,    // AVX2 + FMA
+  kAvx512 = 2,  // AVX-512 F/BW/DQ/VL
+};
+
+namespace cpu_features_internal {
+
+#if defined(NEURAL_ARCH_X86)
+inline void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+  for (int i = 0; i < 4; ++i)
+    regs[i] = static_cast<uint32_t>(info[i]);
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Reads XCR0, which tells which register files the OS saves on context
+// switches. Only valid when CPUID reports OSXSAVE.
+inline uint64_t ReadXcr0() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  return _xgetbv(0);
+#else
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+#endif  // NEURAL_ARCH_X86
+
+}  // namespace cpu_features_internal
+
+// Queries CPUID and XCR0 for the highest usable SIMD level.
+inline SimdLevel DetectSimdLevel() {
+#if defined(NEURAL_ARCH_X86) && NEURAL_HAS_TARGET_ATTRIBUTES
+  uint32_t regs[4];
+  cpu_features_internal::CpuId(0, 0, regs);
+  const uint32_t max_leaf = regs[0];
+  if (max_leaf < 7)
+    return SimdLevel::kPortable;
+
+  cpu_features_internal::CpuId(1, 0, regs);
+  const bool fma = regs[2] & (1u << 12);
+  const bool osxsave = regs[2] & (1u << 27);
+  const bool avx = regs[2] & (1u << 28);
+  if (!osxsave || !avx || !fma)
+    return SimdLevel::kPortable;
+
+  // XMM and YMM state must be enabled by the OS
+  const uint64_t xcr0 = cpu_features_internal::ReadXcr0();
+  if ((xcr0 & 0x6) != 0x6)
+    return SimdLevel::kPortable;
+
+  cpu_features_internal::CpuId(7, 0, regs);
+  const uint32_t ebx = regs[1];
+  const bool avx2 = ebx & (1u << 5);
+  if (!avx2)
+    return SimdLevel::kPortable;
+
+  // AVX-512 additionally needs opmask and ZMM state
+  const bool avx512 = (ebx & (1u << 16)) &&  // F
+                      (ebx & (1u << 17)) &&  // DQ
+                      (ebx & (1u << 30)) &&  // BW
+                      (ebx & (1u << 31));    // VL
+  if (avx512 && (xcr0 & 0xE0) == 0xE0)
+    return SimdLevel::kAvx512;
+  return SimdLevel::kAvx2;
+#else
+  return SimdLevel::kPortable;
+#endif
+}
+
+// The SIMD level used by all dispatched kernels.
+// Detected once on first use and fixed for the lifetime of the process.
+inline SimdLevel ActiveSimdLevel() {
+  static const SimdLevel kLevel = DetectSimdLevel();
+  return kLevel;
+}
+
+inline const char* SimdLevelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::kAvx512:
+      return "AVX-512";
+    case SimdLevel::kAvx2:
+      return "AVX2";
+    default:
+      return "Portable";
+  }
+}
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_CPU_FEATURES_H_
@@ -0,0 +1,155 @@
+// MIT License
+
+// This file contains the implementation of the DataParallelTrainer class
+// template. It is meant to be included only inside data_parallel_trainer.h.
+
+#include <algorithm>
+
+#include <absl/log/check.h>
+#include <absl/log/log.h>
+#include <absl/strings/str_cat.h>
+
+#include "thread_pool.h"
+
+template <std::floating_point Fp>
+DataParallelTrainer<Fp>::DataParallelTrainer(NeuralNetwork<Fp>& network,
+                                             uint32_t num_replicas)
+    : network_(network) {
+  CHECK(!network.GetLayers().empty()) << "Network has no layers.";
+  const size_t replicas = num_replicas != 0
+                              ? num_replicas
+                              : ThreadPool::Global().MaxParallelism();
+  clones_.resize(replicas - 1);
+  for (NeuralNetwork<Fp>& clone : clones_) {
+    for (const auto& layer : network.GetLayers()) {
+      clone.AddLayer(layer->Clone());
+    }
+  }
+  replicas_.push_back(&network_);
+  for (NeuralNetwork<Fp>& clone : clones_) {
+    replicas_.push_back(&clone);
+  }
+  losses_.resize(replicas);
+  shares_.resize(replicas);
+}
+
+template <std::floating_point Fp>
+size_t DataParallelTrainer<Fp>::NumReplicas() const noexcept {
+  return replicas_.size();
+}
+
+template <std::floating_point Fp>
+Fp DataParallelTrainer<Fp>::TrainStep(MatrixView<Fp> data_batch,
+                                      MatrixView<Fp> labels_batch) {
+  const size_t rows = data_batch.Rows();
+  CHECK(rows == labels_batch.Rows())
+      << "Number of samples in data and labels must be the same.";
+  CHECK(rows > 0) << "Cannot train on an empty batch.";
+  const size_t active = std::min(replicas_.size(), rows);
+
+  // Forward and backward on every shard at once
+  ThreadPool::Global().ParallelFor(
+      0, active, 1, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+          const size_t first = r * rows / active;
+          const size_t last = (r + 1) * rows / active;
+          losses_[r] = replicas_[r]->ComputeGradients(
+              data_batch.RowRange(first, last),
+              labels_batch.RowRange(first, last));
+          shares_[r] = static_cast<Fp>(last - first) / static_cast<Fp>(rows);
+        }
+      });
+
+  AllReduceGradients(active);
+  ThreadPool::Global().ParallelFor(
+      0, replicas_.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+          replicas_[r]->UpdateWeights();
+        }
+      });
+
+  // The shard losses are averages over their rows
+  Fp loss = Fp(0);
+  for (size_t r = 0; r < active; ++r) {
+    loss += shares_[r] * losses_[r];
+  }
+  return loss;
+}
+
+template <std::floating_point Fp>
+void DataParallelTrainer<Fp>::AllReduceGradients(size_t active) {
+  const size_t num_layers = network_.GetLayers().size();
+  for (size_t layer = 0; layer < num_layers; ++layer) {
+    auto gradients = [&](size_t replica) {
+      return replicas_[replica]->GetLayers()[layer]->Gradients().data();
+    };
+    const size_t size = network_.GetLayers()[layer]->Gradients().size();
+    if (size == 0)
+      continue;
+    const size_t blocks =
+        (size + kReduceBlockElements - 1) / kReduceBlockElements;
+    ThreadPool::Global().ParallelFor(0, blocks, 1, [&](size_t begin,
+                                                       size_t end) {
+      for (size_t block = begin; block < end; ++block) {
+        const size_t first = block * kReduceBlockElements;
+        const size_t count = std::min(kReduceBlockElements, size - first);
+        // Weight every shard by its share of the batch
+        for (size_t r = 0; r < active; ++r) {
+          Fp* gradient = gradients(r) + first;
+          const Fp share = shares_[r];
+          for (size_t i = 0; i < count; ++i) {
+            gradient[i] *= share;
+          }
+        }
+        // Sum pairs at doubling distances, replica 0 ends with the total
+        for (size_t stride = 1; stride < active; stride *= 2) {
+          for (size_t r = 0; r + stride < active; r += 2 * stride) {
+            Fp* sum = gradients(r) + first;
+            const Fp* other = gradients(r + stride) + first;
+            for (size_t i = 0; i < count; ++i) {
+              sum[i] += other[i];
+            }
+          }
+        }
+        // Idle replicas take the total as well, every replica applies it
+        const Fp* total = gradients(0) + first;
+        for (size_t r = 1; r < replicas_.size(); ++r) {
+          std::copy(total, total + count, gradients(r) + first);
+        }
+      }
+    });
+  }
+}
+
+template <std::floating_point Fp>
+template <Numeric T>
+void DataParallelTrainer<Fp>::Train(const Matrix<T>& raw_train_data,
+                                    const MatType& raw_train_labels,
+                                    const Matrix<T>& raw_test_data,
+                                    const MatType& raw_test_labels,
+                                    uint32_t epochs, uint32_t batch_size,
+                                    EpochCallback on_epoch_end,
+                                    Fp input_scale) {
+  CHECK(raw_train_data.Rows() == raw_train_labels.Rows())
+      << "Number of samples in data and labels must be the same.";
+
+  // Every replica is planned for its shard of the largest batch
+  const size_t max_batch =
+      std::min<size_t>(batch_size, raw_train_data.Rows());
+  const size_t max_shard =
+      (max_batch + replicas_.size() - 1) / replicas_.size();
+  WorkspacePlan plan;
+  for (NeuralNetwork<Fp>* replica : replicas_) {
+    plan = replica->PlanWorkspace(max_shard, raw_train_data.Cols());
+  }
+  LOG(INFO) << "Training workspace: " << plan.buffers.size()
+            << " buffers, " << plan.TotalBytes() / 1024 << " KiB per replica";
+
+  Training::RunBatchEpochs(
+      network_, raw_train_data, raw_train_labels, raw_test_data,
+      raw_test_labels, epochs, batch_size,
+      absl::StrCat(replicas_.size(), " replicas"), on_epoch_end, input_scale,
+      [this](MatrixView<Fp> data_batch, MatrixView<Fp> labels_batch) {
+        return TrainStep(data_batch, labels_batch);
+      });
+}
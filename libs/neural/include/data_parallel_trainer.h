@@ -0,0 +1,80 @@
+// MIT License
+
+// Defines synchronous data-parallel training on the shared thread pool.
+// The layers of a network are replicated once per replica. Every step
+// splits the batch into one contiguous shard per replica, and the replicas
+// run forward and backward on their shards at the same time, so the cores
+// are used even when each product is too small for the GEMM to split.
+//
+// The parameter gradients are then all-reduced. Each replica's gradient is
+// weighted by its share of the batch rows, so that the result is the
+// gradient of the whole batch. The weighted gradients are summed in a fixed
+// pairwise tree order, and the sum is copied back to every replica. This
+// runs one block of parameters per task, so a block stays in cache for the
+// whole reduction. Every replica then applies the same update, so the
+// replicas stay identical without broadcasting weights. For a fixed number
+// of replicas the results do not depend on thread timing.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_DATA_PARALLEL_TRAINER_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_DATA_PARALLEL_TRAINER_H_
+
+#include <cstdint>
+
+#include <concepts>
+#include <vector>
+
+#include "matrix.h"
+#include "neural_network.h"
+
+template <std::floating_point Fp>
+class DataParallelTrainer {
+ public:
+  using MatType = Matrix<Fp>;
+  using EpochCallback = typename NeuralNetwork<Fp>::EpochCallback;
+
+  // Parameters per all-reduce task
+  static constexpr size_t kReduceBlockElements = 4096;
+
+  // Trains network in place. num_replicas counts the network itself, 0 uses
+  // one replica per thread a parallel operation may use
+  // (ThreadPool::MaxParallelism). The network must outlive the trainer and
+  // must not be trained by other means while the trainer is in use.
+  // Requires at least one layer.
+  explicit DataParallelTrainer(NeuralNetwork<Fp>& network,
+                               uint32_t num_replicas = 0);
+
+  DataParallelTrainer(const DataParallelTrainer&) = delete;
+  DataParallelTrainer& operator=(const DataParallelTrainer&) = delete;
+
+  size_t NumReplicas() const noexcept;
+
+  // Same as NeuralNetwork::TrainStep, split across the replicas. A batch
+  // with fewer rows than replicas leaves the remaining replicas idle.
+  Fp TrainStep(MatrixView<Fp> data_batch, MatrixView<Fp> labels_batch);
+  // Same as NeuralNetwork::Train, with every step split across the
+  // replicas and the batches built ahead by a BatchPrefetcher. Accuracy is
+  // evaluated on the network.
+  template <Numeric T>
+  void Train(const Matrix<T>& raw_train_data, const MatType& raw_train_labels,
+             const Matrix<T>& raw_test_data, const MatType& raw_test_labels,
+             uint32_t epochs, uint32_t batch_size,
+             EpochCallback on_epoch_end = nullptr, Fp input_scale = Fp(1));
+
+ private:
+  // Replaces the gradients of every replica with the weighted sum of those
+  // of the first `active` replicas
+  void AllReduceGradients(size_t active);
+
+  NeuralNetwork<Fp>& network_;
+  // The replicas besides the network
+  std::vector<NeuralNetwork<Fp>> clones_;
+  // Every replica, the network first
+  std::vector<NeuralNetwork<Fp>*> replicas_;
+  // Loss and share of the batch rows of every replica in the last step
+  std::vector<Fp> losses_;
+  std::vector<Fp> shares_;
+};
+
+#include "data_parallel_trainer-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_DATA_PARALLEL_TRAINER_H_
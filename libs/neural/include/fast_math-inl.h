@@ -0,0 +1,236 @@
+// MIT License
+
+// This file contains the implementation of the FastMath functions.
+// It is meant to be included only inside fast_math.h.
+
+#include <cstdint>
+
+#include <bit>
+#include <limits>
+
+namespace FastMath {
+
+namespace internal {
+
+template <typename T>
+struct Constants;
+
+template <>
+struct Constants<float> {
+  using Bits = int32_t;
+  using UnsignedBits = uint32_t;
+  static constexpr int kMantissaBits = 23;
+  static constexpr Bits kExponentBias = 127;
+  static constexpr Bits kExponentMask = 0xff;
+  static constexpr Bits kMantissaMask = 0x7fffff;
+  // 1.5 * 2^23: adding it rounds to an integer held in the low mantissa bits
+  static constexpr float kRound = 12582912.0f;
+
+  static constexpr float kLog2e = 1.44269504088896341f;
+  // ln(2) split so that k * kLn2Hi is exact for every exponent k
+  static constexpr float kLn2Hi = 0.693359375f;
+  static constexpr float kLn2Lo = -2.12194440e-4f;
+  // Exp overflows above and underflows to zero below
+  static constexpr float kExpMax = 88.72283935546875f;
+  static constexpr float kExpMin = -103.97208404541015625f;
+
+  // Below this Tanh uses its odd polynomial, above 1 - 2 / (exp(2x) + 1)
+  static constexpr float kTanhSmall = 0.625f;
+};
+
+template <>
+struct Constants<double> {
+  using Bits = int64_t;
+  using UnsignedBits = uint64_t;
+  static constexpr int kMantissaBits = 52;
+  static constexpr Bits kExponentBias = 1023;
+  static constexpr Bits kExponentMask = 0x7ff;
+  static constexpr Bits kMantissaMask = 0xfffffffffffff;
+  static constexpr double kRound = 6755399441055744.0;  // 1.5 * 2^52
+
+  static constexpr double kLog2e = 1.4426950408889634074;
+  static constexpr double kLn2Hi = 6.93147180369123816490e-1;
+  static constexpr double kLn2Lo = 1.90821492927058770002e-10;
+  static constexpr double kExpMax = 709.782712893383973096;
+  static constexpr double kExpMin = -745.1332191019412076235;
+
+  static constexpr double kTanhSmall = 0.2;
+};
+
+// 2^n for exponents of normal numbers
+template <Real T>
+NEURAL_ALWAYS_INLINE T Pow2(typename Constants<T>::Bits n) {
+  using C = Constants<T>;
+  using U = typename C::UnsignedBits;
+  return std::bit_cast<T>(static_cast<U>(n + C::kExponentBias)
+                          << C::kMantissaBits);
+}
+
+// condition ? if_true : if_false, as a bit blend. Both values stay live, so
+// the compiler cannot sink the computation of a value that the select may
+// discard under a branch, which would keep the loop from vectorizing (the
+// floating-point operations may trap and are not speculated back).
+template <Real T>
+NEURAL_ALWAYS_INLINE T Select(bool condition, T if_true, T if_false) {
+  using U = typename Constants<T>::UnsignedBits;
+  const U mask = U(0) - static_cast<U>(condition);
+  return std::bit_cast<T>((std::bit_cast<U>(if_true) & mask) |
+                          (std::bit_cast<U>(if_false) & ~mask));
+}
+
+// exp(r) for |r| <= ln(2) / 2
+NEURAL_ALWAYS_INLINE float ExpReduced(float r) {
+  // Minimax polynomial (Cephes expf)
+  float p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  return p * (r * r) + r + 1.0f;
+}
+
+NEURAL_ALWAYS_INLINE double ExpReduced(double r) {
+  // Taylor series to r^13, whose remainder is below half an ulp
+  double p = 1.0 / 6227020800.0;
+  p = p * r + 1.0 / 479001600.0;
+  p = p * r + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  return p * (r * r) + r + 1.0;
+}
+
+// log(1 + f) - f + f^2 / 2 over s * (f^2 / 2 + R(s^2)), with
+// s = f / (2 + f) and |s| <= 0.1716: R is the tail of
+// log(1 + f) = 2s + 2s^3 / 3 + 2s^5 / 5 + ...
+NEURAL_ALWAYS_INLINE float LogTail(float z) {
+  float p = 2.0f / 9.0f;
+  p = p * z + 2.0f / 7.0f;
+  p = p * z + 2.0f / 5.0f;
+  p = p * z + 2.0f / 3.0f;
+  return p * z;
+}
+
+NEURAL_ALWAYS_INLINE double LogTail(double z) {
+  double p = 2.0 / 21.0;
+  p = p * z + 2.0 / 19.0;
+  p = p * z + 2.0 / 17.0;
+  p = p * z + 2.0 / 15.0;
+  p = p * z + 2.0 / 13.0;
+  p = p * z + 2.0 / 11.0;
+  p = p * z + 2.0 / 9.0;
+  p = p * z + 2.0 / 7.0;
+  p = p * z + 2.0 / 5.0;
+  p = p * z + 2.0 / 3.0;
+  return p * z;
+}
+
+// tanh(x) for |x| below kTanhSmall
+NEURAL_ALWAYS_INLINE float TanhSmall(float x) {
+  // Minimax polynomial (Cephes tanhf)
+  const float z = x * x;
+  float p = -5.70498872745e-3f;
+  p = p * z + 2.06390887954e-2f;
+  p = p * z - 5.37397155531e-2f;
+  p = p * z + 1.33314422036e-1f;
+  p = p * z - 3.33332819422e-1f;
+  return p * z * x + x;
+}
+
+NEURAL_ALWAYS_INLINE double TanhSmall(double x) {
+  // Taylor series to x^19
+  const double z = x * x;
+  double p = -443861162.0 / 1856156927625.0;
+  p = p * z + 6404582.0 / 10854718875.0;
+  p = p * z - 929569.0 / 638512875.0;
+  p = p * z + 21844.0 / 6081075.0;
+  p = p * z - 1382.0 / 155925.0;
+  p = p * z + 62.0 / 2835.0;
+  p = p * z - 17.0 / 315.0;
+  p = p * z + 2.0 / 15.0;
+  p = p * z - 1.0 / 3.0;
+  return p * z * x + x;
+}
+
+}  // namespace internal
+
+// exp(x) = 2^k * exp(r) with k = round(x / ln(2)) and r = x - k * ln(2).
+// 2^k is applied as two factors, so that k may reach past the exponents of
+// normal numbers at both ends of the range.
+template <Real T>
+NEURAL_ALWAYS_INLINE T Exp(T x) {
+  using C = internal::Constants<T>;
+  using Bits = typename C::Bits;
+  const T clamped = x < C::kExpMin ? C::kExpMin
+                                   : (x > C::kExpMax ? C::kExpMax : x);
+  const T rounded = clamped * C::kLog2e + C::kRound;
+  const Bits k = std::bit_cast<Bits>(rounded) - std::bit_cast<Bits>(C::kRound);
+  const T real_k = rounded - C::kRound;
+  const T r = (clamped - real_k * C::kLn2Hi) - real_k * C::kLn2Lo;
+  const Bits half_k = k >> 1;
+  T result = internal::ExpReduced(r) * internal::Pow2<T>(half_k) *
+             internal::Pow2<T>(k - half_k);
+  result = internal::Select(x > C::kExpMax,
+                            std::numeric_limits<T>::infinity(), result);
+  result = internal::Select(x < C::kExpMin, T(0), result);
+  return internal::Select(x != x, x, result);  // NaN
+}
+
+// log(x) = e * ln(2) + log(m) with x = m * 2^e and sqrt(1/2) <= m < sqrt(2).
+// Denormal inputs are scaled into the normal range first.
+template <Real T>
+NEURAL_ALWAYS_INLINE T Log(T x) {
+  using C = internal::Constants<T>;
+  using Bits = typename C::Bits;
+  constexpr T kSqrt2 = T(1.41421356237309504880);
+  const bool denormal = x < std::numeric_limits<T>::min();
+  const T scaled = x * T(Bits{1} << C::kMantissaBits);
+  const T normal = denormal ? scaled : x;
+  const Bits bits = std::bit_cast<Bits>(normal);
+  Bits e = ((bits >> C::kMantissaBits) & C::kExponentMask) - C::kExponentBias;
+  e = denormal ? e - C::kMantissaBits : e;
+  T m = std::bit_cast<T>((bits & C::kMantissaMask) |
+                         (C::kExponentBias << C::kMantissaBits));
+  const bool high = m > kSqrt2;
+  const T half_m = m * T(0.5);
+  m = high ? half_m : m;
+  e = high ? e + 1 : e;
+
+  const T f = m - T(1);
+  const T s = f / (T(2) + f);
+  const T half_f2 = T(0.5) * f * f;
+  const T real_e = static_cast<T>(e);
+  T result = real_e * C::kLn2Hi -
+             ((half_f2 - (s * (half_f2 + internal::LogTail(s * s)) +
+                          real_e * C::kLn2Lo)) -
+              f);
+  result = internal::Select(x == T(0), -std::numeric_limits<T>::infinity(),
+                            result);
+  result = internal::Select(x < T(0), std::numeric_limits<T>::quiet_NaN(),
+                            result);
+  result = internal::Select(x == std::numeric_limits<T>::infinity(), x,
+                            result);
+  return internal::Select(x != x, x, result);  // NaN
+}
+
+// A polynomial near zero, where 1 - 2 / (exp(2|x|) + 1) would cancel,
+// and (1 - exp(-2|x|)) / (1 + exp(-2|x|)) elsewhere.
+template <Real T>
+NEURAL_ALWAYS_INLINE T Tanh(T x) {
+  using C = internal::Constants<T>;
+  const T magnitude = x < T(0) ? -x : x;
+  const T e = Exp(T(-2) * magnitude);
+  const T large = (T(1) - e) / (T(1) + e);
+  const T small = internal::TanhSmall(x);
+  const T result = internal::Select(x < T(0), -large, large);
+  return internal::Select(magnitude < C::kTanhSmall, small, result);
+}
+
+}  // namespace FastMath
@@ -0,0 +1,51 @@
+// MIT License
+
+// Defines branch-free exp, log and tanh for float and double.
+// std::exp and friends are library calls the compiler cannot vectorize, so
+// a loop that calls them runs one element at a time. These are written
+// with polynomials, bit manipulation and selects only, so they inline
+// into the kernel loops of simd_kernels.h and vectorize for every SIMD
+// variant. Array versions of them are in Simd::MathKernels.
+//
+// Maximum errors, in units in the last place of the exact result, over the
+// finite input range. They are checked against libm by fast_math_test.cc on
+// every SIMD level (FMA contraction moves the error slightly):
+//
+//            float   double
+//   Exp       1.5      1
+//   Log        1       1
+//   Tanh       2       3
+//
+// Special values follow the C library: Exp(-inf) = 0 and Exp(+inf) = +inf.
+// Log(0) = -inf, Log(x < 0) = NaN and Log(+inf) = +inf. Tanh(+-inf) = +-1.
+// NaN propagates. Exp results below the smallest normal are denormal with
+// the usual gradual-underflow rounding.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_FAST_MATH_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_FAST_MATH_H_
+
+#include <concepts>
+
+#include "cpu_features.h"
+
+namespace FastMath {
+
+// The types the functions are implemented for.
+template <typename T>
+concept Real = std::same_as<T, float> || std::same_as<T, double>;
+
+template <Real T>
+T Exp(T x);
+
+// Natural logarithm
+template <Real T>
+T Log(T x);
+
+template <Real T>
+T Tanh(T x);
+
+}  // namespace FastMath
+
+#include "fast_math-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_FAST_MATH_H_
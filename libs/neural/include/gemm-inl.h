@@ -0,0 +1,611 @@
+// MIT License
+
+// This file contains the implementation of the GEMM engine.
+// It is meant to be included only inside gemm.h.
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <absl/log/check.h>
+
+#include "simd_kernels.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace Gemm {
+
+inline CacheSizes CacheSizes::Detect() {
+  CacheSizes sizes;
+#if defined(__linux__) && defined(_SC_LEVEL1_DCACHE_SIZE)
+  // sysconf reports 0 or -1 for levels it does not know about
+  long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (l1 > 0)
+    sizes.l1 = static_cast<size_t>(l1);
+  if (l2 > 0)
+    sizes.l2 = static_cast<size_t>(l2);
+  if (l3 > 0)
+    sizes.l3 = static_cast<size_t>(l3);
+#endif
+  return sizes;
+}
+
+template <std::floating_point Fp>
+BlockSizes ComputeBlockSizes(const CacheSizes& caches) {
+  constexpr size_t kMr = KernelShape<Fp>::kMr;
+  constexpr size_t kNr = KernelShape<Fp>::kNr;
+
+  // A kc x kNr micro-panel of B plus a kMr x kc sliver of A should use about
+  // half of L1, leaving room for the output tile and streaming A.
+  size_t kc = (caches.l1 / 2) / ((kMr + kNr) * sizeof(Fp));
+  kc = std::clamp<size_t>(kc - kc % 8, 64, 1024);
+
+  // The packed mc x kc block of A should use about half of L2.
+  size_t mc = (caches.l2 / 2) / (kc * sizeof(Fp));
+  mc = std::clamp<size_t>(mc - mc % kMr, kMr, 1020);
+
+  // The packed kc x nc panel of B should use about half of L3.
+  size_t nc = (caches.l3 / 2) / (kc * sizeof(Fp));
+  nc = std::clamp<size_t>(nc - nc % kNr, kNr, 4096);
+
+  return BlockSizes{mc, kc, nc};
+}
+
+inline Partition PlanPartition(size_t m, size_t n, size_t k, size_t max_tasks,
+                               size_t row_unit, size_t col_unit,
+                               size_t min_k_slice) {
+  max_tasks = std::max<size_t>(max_tasks, 1);
+  const size_t row_tiles = std::max<size_t>((m + row_unit - 1) / row_unit, 1);
+  const size_t col_tiles = std::max<size_t>((n + col_unit - 1) / col_unit, 1);
+
+  // Steps are whole units, so a split can end up with fewer blocks than
+  // asked for (49 tiles in 8 blocks of 7 is only 7 blocks)
+  auto blocks_for = [](size_t units, size_t parts) {
+    const size_t step = (units + parts - 1) / parts;
+    return (units + step - 1) / step;
+  };
+
+  // Each tile packs its rows of A and its columns of B over the whole k
+  // range, so for a fixed tile count the cheapest split has the smallest
+  // m / row_blocks + n / col_blocks
+  size_t best_rows = 1;
+  size_t best_cols = 1;
+  size_t best_tiles = 0;
+  double best_cost = 0.0;
+  for (size_t parts = 1; parts <= std::min(row_tiles, max_tasks); ++parts) {
+    const size_t rows = blocks_for(row_tiles, parts);
+    const size_t cols =
+        blocks_for(col_tiles, std::min(col_tiles, max_tasks / rows));
+    const size_t tiles = rows * cols;
+    const double cost = static_cast<double>(m) / static_cast<double>(rows) +
+                        static_cast<double>(n) / static_cast<double>(cols);
+    if (tiles > best_tiles || (tiles == best_tiles && cost < best_cost)) {
+      best_rows = rows;
+      best_cols = cols;
+      best_tiles = tiles;
+      best_cost = cost;
+    }
+  }
+
+  Partition plan;
+  plan.row_step = (row_tiles + best_rows - 1) / best_rows * row_unit;
+  plan.col_step = (col_tiles + best_cols - 1) / best_cols * col_unit;
+  plan.row_blocks =
+      std::max<size_t>((m + plan.row_step - 1) / plan.row_step, 1);
+  plan.col_blocks =
+      std::max<size_t>((n + plan.col_step - 1) / plan.col_step, 1);
+
+  // Split k only when at least half of the tasks would otherwise idle.
+  // Every extra slice costs one m x n addition in the reduction, which is
+  // small next to the min_k_slice multiply-adds per output it saves.
+  const size_t tiles = plan.row_blocks * plan.col_blocks;
+  size_t splits = 1;
+  if (min_k_slice > 0 && tiles * 2 <= max_tasks)
+    splits = std::clamp<size_t>(std::min(max_tasks / tiles, k / min_k_slice),
+                                1, max_tasks);
+  plan.k_step = std::max<size_t>((k + splits - 1) / splits, 1);
+  plan.k_splits = std::max<size_t>((k + plan.k_step - 1) / plan.k_step, 1);
+  return plan;
+}
+
+template <typename T>
+Epilogue<T> Epilogue<T>::Columns(size_t col) const noexcept {
+  Epilogue columns = *this;
+  if (columns.bias != nullptr)
+    columns.bias += col;
+  return columns;
+}
+
+template <typename T>
+T Epilogue<T>::Finish(T value, size_t col) const {
+  value *= scale;
+  if (bias != nullptr)
+    value += bias[col];
+  return relu ? std::max(T(0), value) : value;
+}
+
+template <typename T>
+void Epilogue<T>::Apply(T* row, size_t count) const {
+  // The branches are loop invariant, the compiler unswitches them
+  for (size_t j = 0; j < count; ++j) {
+    row[j] = Finish(row[j], j);
+  }
+}
+
+namespace internal {
+
+template <std::floating_point Fp>
+BlockSizes& MutableDefaultBlockSizes() {
+  static BlockSizes blocks = ComputeBlockSizes<Fp>(CacheSizes::Detect());
+  return blocks;
+}
+
+}  // namespace internal
+
+template <std::floating_point Fp>
+const BlockSizes& DefaultBlockSizes() {
+  return internal::MutableDefaultBlockSizes<Fp>();
+}
+
+template <std::floating_point Fp>
+void SetDefaultBlockSizes(const BlockSizes& blocks) {
+  CHECK(blocks.mc > 0 && blocks.kc > 0 && blocks.nc > 0 &&
+        "Block sizes must be positive.");
+  internal::MutableDefaultBlockSizes<Fp>() = blocks;
+}
+
+namespace internal {
+
+// Element (i, j) of an operand is at data[i * row + j * col].
+// A stored operand has strides {ld, 1}, a transposed one {1, ld}.
+struct Strides {
+  size_t row;
+  size_t col;
+};
+
+inline Strides OperandStrides(Transpose transpose, size_t ld) {
+  return transpose == Transpose::kNo ? Strides{ld, 1} : Strides{1, ld};
+}
+
+// Element offset of an operand, read as zero where the operand's mask (if
+// kMasked) is not positive
+template <bool kMasked, std::floating_point Fp>
+NEURAL_ALWAYS_INLINE Fp LoadOperand(const Fp* x, const Fp* mask,
+                                    size_t offset) {
+  if constexpr (kMasked) {
+    return mask[offset] > Fp(0) ? x[offset] : Fp(0);
+  } else {
+    return x[offset];
+  }
+}
+
+// Packs an mc x kc block of A into row panels of height kMr.
+// Within a panel, the kMr values of each column are stored contiguously,
+// which is the order the micro-kernel consumes them in.
+// Rows past mc are zero-padded so that the micro-kernel never branches.
+template <bool kMasked, std::floating_point Fp>
+void PackABlock(size_t mc, size_t kc, const Fp* a, const Fp* mask,
+           Strides strides, Fp* packed) {
+  constexpr size_t kMr = KernelShape<Fp>::kMr;
+  for (size_t ir = 0; ir < mc; ir += kMr) {
+    const size_t rows = std::min(kMr, mc - ir);
+    for (size_t p = 0; p < kc; ++p) {
+      // Contiguous for a transposed A, strided by the row length otherwise
+      const size_t column = ir * strides.row + p * strides.col;
+      size_t i = 0;
+      for (; i < rows; ++i) {
+        packed[i] = LoadOperand<kMasked>(a, mask, column + i * strides.row);
+      }
+      for (; i < kMr; ++i) {
+        packed[i] = Fp(0);
+      }
+      packed += kMr;
+    }
+  }
+}
+
+// Packs a kc x nc panel of B into column panels of width kNr.
+// Within a panel, the kNr values of each row are stored contiguously.
+// Columns past nc are zero-padded.
+template <bool kMasked, std::floating_point Fp>
+void PackBPanel(size_t kc, size_t nc, const Fp* b, const Fp* mask,
+           Strides strides, Fp* packed) {
+  constexpr size_t kNr = KernelShape<Fp>::kNr;
+  for (size_t jr = 0; jr < nc; jr += kNr) {
+    const size_t cols = std::min(kNr, nc - jr);
+    if (strides.col == 1) {
+      // Rows of B are contiguous, copy them kNr at a time
+      for (size_t p = 0; p < kc; ++p) {
+        const size_t row = jr + p * strides.row;
+        size_t j = 0;
+        for (; j < cols; ++j) {
+          packed[j] = LoadOperand<kMasked>(b, mask, row + j);
+        }
+        for (; j < kNr; ++j) {
+          packed[j] = Fp(0);
+        }
+        packed += kNr;
+      }
+    } else {
+      // Columns of B (rows of the stored B^T) are contiguous, read each one
+      // sequentially and scatter it into the panel
+      for (size_t j = 0; j < cols; ++j) {
+        const size_t column = (jr + j) * strides.col;
+        for (size_t p = 0; p < kc; ++p) {
+          packed[p * kNr + j] =
+              LoadOperand<kMasked>(b, mask, column + p * strides.row);
+        }
+      }
+      for (size_t p = 0; p < kc; ++p) {
+        for (size_t j = cols; j < kNr; ++j) {
+          packed[p * kNr + j] = Fp(0);
+        }
+      }
+      packed += kc * kNr;
+    }
+  }
+}
+
+// Packs op(A) and op(B), reading masked operands through their masks.
+// mask points at the element of the mask that matches x.
+template <std::floating_point Fp>
+void PackA(size_t mc, size_t kc, const Fp* a, const Fp* mask,
+           Strides strides, Fp* packed) {
+  if (mask != nullptr) {
+    PackABlock<true>(mc, kc, a, mask, strides, packed);
+  } else {
+    PackABlock<false>(mc, kc, a, mask, strides, packed);
+  }
+}
+
+template <std::floating_point Fp>
+void PackB(size_t kc, size_t nc, const Fp* b, const Fp* mask,
+           Strides strides, Fp* packed) {
+  if (mask != nullptr) {
+    PackBPanel<true>(kc, nc, b, mask, strides, packed);
+  } else {
+    PackBPanel<false>(kc, nc, b, mask, strides, packed);
+  }
+}
+
+// Computes a kMr x kNr tile of A_panel * B_panel into acc.
+// The fixed trip counts let the compiler keep acc in vector registers and
+// fully unroll the inner loops. Without the unroll hints GCC at -O3
+// distributes the loops and spills the tile to memory.
+template <std::floating_point Fp>
+NEURAL_ALWAYS_INLINE void MicroKernel(size_t kc, const Fp* __restrict a,
+                                      const Fp* __restrict b,
+                                      Fp* __restrict acc) {
+  constexpr size_t kMr = KernelShape<Fp>::kMr;
+  constexpr size_t kNr = KernelShape<Fp>::kNr;
+
+  Fp tile[kMr][kNr] = {};
+  for (size_t p = 0; p < kc; ++p) {
+    NEURAL_UNROLL
+    for (size_t i = 0; i < kMr; ++i) {
+      const Fp a_ip = a[i];
+      NEURAL_UNROLL
+      for (size_t j = 0; j < kNr; ++j) {
+        tile[i][j] += a_ip * b[j];
+      }
+    }
+    a += kMr;
+    b += kNr;
+  }
+  for (size_t i = 0; i < kMr; ++i) {
+    for (size_t j = 0; j < kNr; ++j) {
+      acc[i * kNr + j] = tile[i][j];
+    }
+  }
+}
+
+// Writes the valid rows x cols corner of a micro-tile into C.
+// The first kc block overwrites C, later blocks accumulate into it.
+// The last kc block passes the epilogue of the tile's columns, which is
+// applied to the finished sums before they are stored.
+template <std::floating_point Fp>
+NEURAL_ALWAYS_INLINE void StoreTile(const Fp* acc, size_t rows, size_t cols,
+                                    bool accumulate,
+                                    const Epilogue<Fp>* epilogue, Fp* c,
+                                    size_t ldc) {
+  constexpr size_t kNr = KernelShape<Fp>::kNr;
+  for (size_t i = 0; i < rows; ++i) {
+    Fp* dst = c + i * ldc;
+    const Fp* src = acc + i * kNr;
+    if (epilogue != nullptr) {
+      for (size_t j = 0; j < cols; ++j) {
+        const Fp sum = accumulate ? dst[j] + src[j] : src[j];
+        dst[j] = epilogue->Finish(sum, j);
+      }
+    } else if (accumulate) {
+      for (size_t j = 0; j < cols; ++j) {
+        dst[j] += src[j];
+      }
+    } else {
+      for (size_t j = 0; j < cols; ++j) {
+        dst[j] = src[j];
+      }
+    }
+  }
+}
+
+// Multiplies a packed mc x kc block of A by a packed kc x nc panel of B.
+// epilogue is null except for the last kc block, its bias starts at the
+// first column of the panel.
+template <std::floating_point Fp>
+NEURAL_ALWAYS_INLINE void MacroKernel(size_t mc, size_t nc, size_t kc,
+                                      const Fp* packed_a, const Fp* packed_b,
+                                      bool accumulate,
+                                      const Epilogue<Fp>* epilogue, Fp* c,
+                                      size_t ldc) {
+  constexpr size_t kMr = KernelShape<Fp>::kMr;
+  constexpr size_t kNr = KernelShape<Fp>::kNr;
+
+  alignas(64) Fp acc[kMr * kNr];
+  for (size_t jr = 0; jr < nc; jr += kNr) {
+    const size_t cols = std::min(kNr, nc - jr);
+    const Fp* b_panel = packed_b + jr * kc;
+    Epilogue<Fp> panel_epilogue;
+    if (epilogue != nullptr)
+      panel_epilogue = epilogue->Columns(jr);
+    for (size_t ir = 0; ir < mc; ir += kMr) {
+      const size_t rows = std::min(kMr, mc - ir);
+      MicroKernel(kc, packed_a + ir * kc, b_panel, acc);
+      StoreTile(acc, rows, cols, accumulate,
+                epilogue != nullptr ? &panel_epilogue : nullptr,
+                c + ir * ldc + jr, ldc);
+    }
+  }
+}
+
+template <std::floating_point Fp>
+using MacroKernelFn = void (*)(size_t mc, size_t nc, size_t kc,
+                               const Fp* packed_a, const Fp* packed_b,
+                               bool accumulate, const Epilogue<Fp>* epilogue,
+                               Fp* c, size_t ldc);
+
+// Macro-kernel variants for each SIMD level (see cpu_features.h)
+template <std::floating_point Fp>
+void MacroKernelPortable(size_t mc, size_t nc, size_t kc, const Fp* packed_a,
+                         const Fp* packed_b, bool accumulate,
+                         const Epilogue<Fp>* epilogue, Fp* c, size_t ldc) {
+  MacroKernel(mc, nc, kc, packed_a, packed_b, accumulate, epilogue, c, ldc);
+}
+
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+template <std::floating_point Fp>
+NEURAL_TARGET_AVX2 void MacroKernelAvx2(size_t mc, size_t nc, size_t kc,
+                                        const Fp* packed_a, const Fp* packed_b,
+                                        bool accumulate,
+                                        const Epilogue<Fp>* epilogue, Fp* c,
+                                        size_t ldc) {
+  MacroKernel(mc, nc, kc, packed_a, packed_b, accumulate, epilogue, c, ldc);
+}
+
+template <std::floating_point Fp>
+NEURAL_TARGET_AVX512 void MacroKernelAvx512(size_t mc, size_t nc, size_t kc,
+                                            const Fp* packed_a,
+                                            const Fp* packed_b, bool accumulate,
+                                            const Epilogue<Fp>* epilogue,
+                                            Fp* c, size_t ldc) {
+  MacroKernel(mc, nc, kc, packed_a, packed_b, accumulate, epilogue, c, ldc);
+}
+#endif
+
+// Returns the macro-kernel for ActiveSimdLevel(), selected once on first use.
+template <std::floating_point Fp>
+MacroKernelFn<Fp> ActiveMacroKernel() {
+  static const MacroKernelFn<Fp> kKernel = [] {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+    switch (ActiveSimdLevel()) {
+      case SimdLevel::kAvx512:
+        return &MacroKernelAvx512<Fp>;
+      case SimdLevel::kAvx2:
+        return &MacroKernelAvx2<Fp>;
+      default:
+        break;
+    }
+#endif
+    return &MacroKernelPortable<Fp>;
+  }();
+  return kKernel;
+}
+
+// Returns a per-thread scratch buffer with room for at least size elements.
+// The buffers live as long as the thread, so steady-state calls do not
+// allocate.
+template <std::floating_point Fp>
+Fp* PackBuffer(std::vector<Fp>& buffer, size_t size) {
+  if (buffer.size() < size)
+    buffer.resize(size);
+  return buffer.data();
+}
+
+}  // namespace internal
+
+template <std::floating_point Fp>
+void Multiply(size_t m, size_t n, size_t k, const Fp* a, size_t lda,
+              const Fp* b, size_t ldb, Fp* c, size_t ldc) {
+  Multiply(Transpose::kNo, Transpose::kNo, m, n, k, a, lda, b, ldb, c, ldc,
+           DefaultBlockSizes<Fp>());
+}
+
+template <std::floating_point Fp>
+void Multiply(size_t m, size_t n, size_t k, const Fp* a, size_t lda,
+              const Fp* b, size_t ldb, Fp* c, size_t ldc,
+              const BlockSizes& blocks) {
+  Multiply(Transpose::kNo, Transpose::kNo, m, n, k, a, lda, b, ldb, c, ldc,
+           blocks);
+}
+
+template <std::floating_point Fp>
+void Multiply(Transpose transpose_a, Transpose transpose_b, size_t m,
+              size_t n, size_t k, const Fp* a, size_t lda, const Fp* b,
+              size_t ldb, Fp* c, size_t ldc, const Epilogue<Fp>& epilogue,
+              const OperandMasks<Fp>& masks) {
+  Multiply(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc,
+           DefaultBlockSizes<Fp>(), epilogue, masks);
+}
+
+template <std::floating_point Fp>
+void Multiply(Transpose transpose_a, Transpose transpose_b, size_t m,
+              size_t n, size_t k, const Fp* a, size_t lda, const Fp* b,
+              size_t ldb, Fp* c, size_t ldc, const BlockSizes& blocks,
+              const Epilogue<Fp>& epilogue, const OperandMasks<Fp>& masks) {
+  constexpr size_t kMr = KernelShape<Fp>::kMr;
+  constexpr size_t kNr = KernelShape<Fp>::kNr;
+
+  if (m == 0 || n == 0)
+    return;
+  if (k == 0) {
+    for (size_t i = 0; i < m; ++i) {
+      std::fill(c + i * ldc, c + i * ldc + n, Fp(0));
+      epilogue.Apply(c + i * ldc, n);
+    }
+    return;
+  }
+
+  const internal::Strides a_strides =
+      internal::OperandStrides(transpose_a, lda);
+  const internal::Strides b_strides =
+      internal::OperandStrides(transpose_b, ldb);
+
+  // Packed panels are rounded up to whole micro-tiles
+  const size_t mc_max = (std::min(blocks.mc, m) + kMr - 1) / kMr * kMr;
+  const size_t nc_max = (std::min(blocks.nc, n) + kNr - 1) / kNr * kNr;
+  const size_t kc_max = std::min(blocks.kc, k);
+
+  const internal::MacroKernelFn<Fp> macro_kernel =
+      internal::ActiveMacroKernel<Fp>();
+
+  thread_local std::vector<Fp> a_buffer;
+  thread_local std::vector<Fp> b_buffer;
+  Fp* packed_a = internal::PackBuffer(a_buffer, mc_max * kc_max);
+  Fp* packed_b = internal::PackBuffer(b_buffer, kc_max * nc_max);
+
+  for (size_t jc = 0; jc < n; jc += blocks.nc) {
+    const size_t nc = std::min(blocks.nc, n - jc);
+    const Epilogue<Fp> panel_epilogue = epilogue.Columns(jc);
+    for (size_t pc = 0; pc < k; pc += blocks.kc) {
+      const size_t kc = std::min(blocks.kc, k - pc);
+      // Only the last kc block sees finished sums
+      const Epilogue<Fp>* block_epilogue =
+          pc + kc == k && !epilogue.Empty() ? &panel_epilogue : nullptr;
+      const size_t b_offset = pc * b_strides.row + jc * b_strides.col;
+      internal::PackB(kc, nc, b + b_offset,
+                      masks.b != nullptr ? masks.b + b_offset : nullptr,
+                      b_strides, packed_b);
+      for (size_t ic = 0; ic < m; ic += blocks.mc) {
+        const size_t mc = std::min(blocks.mc, m - ic);
+        const size_t a_offset = ic * a_strides.row + pc * a_strides.col;
+        internal::PackA(mc, kc, a + a_offset,
+                        masks.a != nullptr ? masks.a + a_offset : nullptr,
+                        a_strides, packed_a);
+        macro_kernel(mc, nc, kc, packed_a, packed_b, pc != 0, block_epilogue,
+                     c + ic * ldc + jc, ldc);
+      }
+    }
+  }
+}
+
+template <std::floating_point Fp>
+void ParallelMultiply(size_t m, size_t n, size_t k, const Fp* a, size_t lda,
+                      const Fp* b, size_t ldb, Fp* c, size_t ldc,
+                      ThreadPool& pool, size_t max_tasks) {
+  ParallelMultiply(Transpose::kNo, Transpose::kNo, m, n, k, a, lda, b, ldb, c,
+                   ldc, pool, max_tasks);
+}
+
+template <std::floating_point Fp>
+void ParallelMultiply(Transpose transpose_a, Transpose transpose_b, size_t m,
+                      size_t n, size_t k, const Fp* a, size_t lda,
+                      const Fp* b, size_t ldb, Fp* c, size_t ldc,
+                      ThreadPool& pool, size_t max_tasks,
+                      const Epilogue<Fp>& epilogue,
+                      const OperandMasks<Fp>& masks) {
+  // K slices shorter than this spend more time packing and reducing than
+  // multiplying
+  constexpr size_t kMinKSlice = 128;
+
+  const Partition plan =
+      PlanPartition(m, n, k, max_tasks, KernelShape<Fp>::kMr,
+                    KernelShape<Fp>::kNr, kMinKSlice);
+  if (plan.Tasks() <= 1) {
+    Multiply(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc,
+             epilogue, masks);
+    return;
+  }
+
+  const internal::Strides a_strides =
+      internal::OperandStrides(transpose_a, lda);
+  const internal::Strides b_strides =
+      internal::OperandStrides(transpose_b, ldb);
+
+  // Slice 0 writes straight into C, every further slice into its own m x n
+  // buffer. The buffer is taken out of the thread-local spare while in use,
+  // so a nested call on this thread (while it helps the pool) gets its own.
+  thread_local std::vector<Fp> spare;
+  std::vector<Fp> partials = std::move(spare);
+  const size_t partial_size = m * n;
+  if (plan.k_splits > 1 &&
+      partials.size() < (plan.k_splits - 1) * partial_size)
+    partials.resize((plan.k_splits - 1) * partial_size);
+
+  const size_t tiles = plan.row_blocks * plan.col_blocks;
+  pool.ParallelFor(0, plan.Tasks(), 1, [&](size_t begin, size_t end) {
+    for (size_t task = begin; task < end; ++task) {
+      const size_t slice = task / tiles;
+      const size_t row = (task % tiles) / plan.col_blocks * plan.row_step;
+      const size_t col = (task % tiles) % plan.col_blocks * plan.col_step;
+      const size_t depth = slice * plan.k_step;
+      Fp* out = c + row * ldc + col;
+      size_t ld_out = ldc;
+      // Without a K split each tile is final and applies the epilogue,
+      // otherwise the reduction does
+      Epilogue<Fp> tile_epilogue;
+      if (plan.k_splits == 1)
+        tile_epilogue = epilogue.Columns(col);
+      if (slice > 0) {
+        out = partials.data() + (slice - 1) * partial_size + row * n + col;
+        ld_out = n;
+      }
+      // Offsetting by the strides keeps each operand in its stored layout
+      const size_t a_offset = row * a_strides.row + depth * a_strides.col;
+      const size_t b_offset = depth * b_strides.row + col * b_strides.col;
+      OperandMasks<Fp> tile_masks;
+      if (masks.a != nullptr)
+        tile_masks.a = masks.a + a_offset;
+      if (masks.b != nullptr)
+        tile_masks.b = masks.b + b_offset;
+      Multiply(transpose_a, transpose_b, std::min(plan.row_step, m - row),
+               std::min(plan.col_step, n - col),
+               std::min(plan.k_step, k - depth), a + a_offset, lda,
+               b + b_offset, ldb, out, ld_out, tile_epilogue, tile_masks);
+    }
+  });
+
+  if (plan.k_splits > 1) {
+    const Simd::ElementwiseKernels<Fp>& kernels = Simd::Kernels<Fp>();
+    const size_t grain = (m + plan.Tasks() - 1) / plan.Tasks();
+    pool.ParallelFor(0, m, grain, [&](size_t begin, size_t end) {
+      for (size_t slice = 1; slice < plan.k_splits; ++slice) {
+        const Fp* partial = partials.data() + (slice - 1) * partial_size;
+        for (size_t i = begin; i < end; ++i) {
+          kernels.add_assign(c + i * ldc, partial + i * n, n);
+        }
+      }
+      if (!epilogue.Empty()) {
+        for (size_t i = begin; i < end; ++i) {
+          epilogue.Apply(c + i * ldc, n);
+        }
+      }
+    });
+  }
+  spare = std::move(partials);
+}
+
+}  // namespace Gemm
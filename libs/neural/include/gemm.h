@@ -0,0 +1,187 @@
+// MIT License
+
+// Defines a cache-blocked, register-tiled general matrix multiplication
+// (GEMM) engine for floating-point types.
+// Operands are packed into contiguous panels whose sizes are derived from the
+// L1/L2/L3 cache capacities, and the innermost work is done by a micro-kernel
+// that keeps a kMr x kNr tile of the output in registers. The micro-kernel is
+// compiled for each SIMD level and dispatched at runtime.
+// Transposed operands are read in place by the packing routines, so A^T * B
+// and A * B^T cost the same as A * B and never materialize a transpose.
+// ParallelMultiply splits a product into 2D output tiles, and into K slices
+// when the output alone has too few tiles, and runs them on a thread pool.
+// An Epilogue (scale, per-column bias, ReLU) can be fused into the product:
+// it is applied to each finished micro-tile before the tile is stored, so a
+// layer's bias and activation cost no extra pass over the output.
+// OperandMasks fuse the ReLU derivative into the packing of an operand, so a
+// masked gradient is never written out.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_GEMM_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_GEMM_H_
+
+#include <cstddef>
+
+#include <concepts>
+
+#include "common_types.h"
+#include "cpu_features.h"
+#include "thread_pool.h"
+
+namespace Gemm {
+
+// Data cache capacities in bytes.
+struct CacheSizes {
+  size_t l1 = 32 * 1024;
+  size_t l2 = 256 * 1024;
+  size_t l3 = 8 * 1024 * 1024;
+
+  // Queries the host caches, falling back to the defaults above for any
+  // level that cannot be detected.
+  static CacheSizes Detect();
+};
+
+// Blocking parameters of the loop nest.
+// mc x kc is the packed block of A (kept in L2),
+// kc x nc is the packed panel of B (kept in L3),
+// kc x kNr is a single micro-panel of B (streamed through L1).
+struct BlockSizes {
+  size_t mc;
+  size_t kc;
+  size_t nc;
+};
+
+// Register tile computed by the micro-kernel.
+// kNr spans one 64-byte cache line of the output.
+template <std::floating_point Fp>
+struct KernelShape {
+  static constexpr size_t kMr = 6;
+  static constexpr size_t kNr = 64 / sizeof(Fp);
+};
+
+// Split of an m x n x k product into independent tasks.
+// The output is cut into row_blocks x col_blocks tiles of at most
+// row_step x col_step elements, and the k dimension into k_splits slices of
+// at most k_step whose partial products are summed afterwards.
+struct Partition {
+  size_t row_blocks = 1;
+  size_t col_blocks = 1;
+  size_t k_splits = 1;
+  size_t row_step = 0;
+  size_t col_step = 0;
+  size_t k_step = 0;
+
+  size_t Tasks() const noexcept { return row_blocks * col_blocks * k_splits; }
+};
+
+// Element-wise operations applied to a finished product:
+// C = act(scale * op(A) * op(B) + bias), where bias holds one value per
+// column of C (or is null) and act is ReLU, max(0, x), if relu is set.
+// The default epilogue leaves the product unchanged.
+template <typename T>
+struct Epilogue {
+  T scale = T(1);
+  const T* bias = nullptr;
+  bool relu = false;
+
+  bool Empty() const noexcept {
+    return scale == T(1) && bias == nullptr && !relu;
+  }
+  // The epilogue of the columns starting at col
+  Epilogue Columns(size_t col) const noexcept;
+  // Returns the epilogue of value, an element of column col
+  NEURAL_ALWAYS_INLINE T Finish(T value, size_t col) const;
+  // Applies the epilogue to count consecutive elements of a row whose first
+  // element is in the column the bias starts at
+  NEURAL_ALWAYS_INLINE void Apply(T* row, size_t count) const;
+};
+
+// ReLU derivative masks of the operands, applied while they are packed.
+// A non-null mask is stored like its operand (same transpose and leading
+// dimension), and the operand is read as zero wherever the mask is not
+// positive. The default masks leave the operands unchanged.
+template <typename T>
+struct OperandMasks {
+  const T* a = nullptr;
+  const T* b = nullptr;
+};
+
+// Plans at most max_tasks tasks for an m x n x k product.
+// Tile edges are multiples of row_unit and col_unit. Among the splits with
+// the most output tiles, the one with the least packing work (shortest tile
+// perimeter) is chosen. If that still leaves at least half of the tasks
+// unused, k is split into slices of at least min_k_slice, so small batches
+// and narrow outputs can occupy every thread. A min_k_slice of 0 disables
+// the K split.
+Partition PlanPartition(size_t m, size_t n, size_t k, size_t max_tasks,
+                        size_t row_unit, size_t col_unit, size_t min_k_slice);
+
+// Derives the blocking parameters for Fp from the given cache capacities.
+template <std::floating_point Fp>
+BlockSizes ComputeBlockSizes(const CacheSizes& caches);
+
+// Blocking parameters for the host, computed once on first use unless
+// replaced with SetDefaultBlockSizes.
+template <std::floating_point Fp>
+const BlockSizes& DefaultBlockSizes();
+
+// Replaces the blocking parameters used by Multiply (e.g. with calibrated
+// values, see calibration.h).
+// Must not be called while multiplications are in flight.
+template <std::floating_point Fp>
+void SetDefaultBlockSizes(const BlockSizes& blocks);
+
+// Computes C = A * B where A is m x k, B is k x n and C is m x n.
+// All operands are row-major with leading dimensions lda, ldb and ldc.
+template <std::floating_point Fp>
+void Multiply(size_t m, size_t n, size_t k, const Fp* a, size_t lda,
+              const Fp* b, size_t ldb, Fp* c, size_t ldc);
+
+// Same as above with explicit blocking parameters.
+template <std::floating_point Fp>
+void Multiply(size_t m, size_t n, size_t k, const Fp* a, size_t lda,
+              const Fp* b, size_t ldb, Fp* c, size_t ldc,
+              const BlockSizes& blocks);
+
+// Computes C = op(A) * op(B) where op(A) is m x k and op(B) is k x n,
+// with the operands masked by masks, followed by epilogue.
+// A transposed operand is stored the other way around: with
+// transpose_a == kYes, A is stored k x m with leading dimension lda, and
+// with transpose_b == kYes, B is stored n x k with leading dimension ldb.
+template <std::floating_point Fp>
+void Multiply(Transpose transpose_a, Transpose transpose_b, size_t m,
+              size_t n, size_t k, const Fp* a, size_t lda, const Fp* b,
+              size_t ldb, Fp* c, size_t ldc,
+              const Epilogue<Fp>& epilogue = Epilogue<Fp>(),
+              const OperandMasks<Fp>& masks = OperandMasks<Fp>());
+
+// Same as above with explicit blocking parameters.
+template <std::floating_point Fp>
+void Multiply(Transpose transpose_a, Transpose transpose_b, size_t m,
+              size_t n, size_t k, const Fp* a, size_t lda, const Fp* b,
+              size_t ldb, Fp* c, size_t ldc, const BlockSizes& blocks,
+              const Epilogue<Fp>& epilogue = Epilogue<Fp>(),
+              const OperandMasks<Fp>& masks = OperandMasks<Fp>());
+
+// Computes C = A * B like Multiply, split across up to max_tasks tasks of
+// pool as planned by PlanPartition with micro-tile aligned edges.
+template <std::floating_point Fp>
+void ParallelMultiply(size_t m, size_t n, size_t k, const Fp* a, size_t lda,
+                      const Fp* b, size_t ldb, Fp* c, size_t ldc,
+                      ThreadPool& pool, size_t max_tasks);
+
+// Computes C = op(A) * op(B) with masks and epilogue like the transposing
+// Multiply, split across up to max_tasks tasks of pool. With a K split the
+// epilogue runs in the pass that sums the slices.
+template <std::floating_point Fp>
+void ParallelMultiply(Transpose transpose_a, Transpose transpose_b, size_t m,
+                      size_t n, size_t k, const Fp* a, size_t lda,
+                      const Fp* b, size_t ldb, Fp* c, size_t ldc,
+                      ThreadPool& pool, size_t max_tasks,
+                      const Epilogue<Fp>& epilogue = Epilogue<Fp>(),
+                      const OperandMasks<Fp>& masks = OperandMasks<Fp>());
+
+}  // namespace Gemm
+
+#include "gemm-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_GEMM_H_
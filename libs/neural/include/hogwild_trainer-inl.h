@@ -0,0 +1,108 @@
+// MIT License
+
+// This file contains the implementation of the HogwildTrainer class
+// template. It is meant to be included only inside hogwild_trainer.h.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include <absl/log/check.h>
+#include <absl/log/log.h>
+#include <absl/strings/str_cat.h>
+
+#include "thread_pool.h"
+
+template <std::floating_point Fp>
+HogwildTrainer<Fp>::HogwildTrainer(NeuralNetwork<Fp>& network,
+                                   uint32_t num_workers)
+    : network_(network) {
+  CHECK(!network.GetLayers().empty()) << "Network has no layers.";
+  workers_.resize(num_workers != 0 ? num_workers
+                                   : ThreadPool::Global().MaxParallelism());
+  // The network itself trains through a clone as well, so that every
+  // update skips the rows of zero gradient
+  for (Worker& worker : workers_) {
+    for (const auto& layer : network.GetLayers()) {
+      worker.replica.AddLayer(layer->CloneSharingParameters());
+    }
+  }
+}
+
+template <std::floating_point Fp>
+size_t HogwildTrainer<Fp>::NumWorkers() const noexcept {
+  return workers_.size();
+}
+
+template <std::floating_point Fp>
+template <Numeric T>
+Fp HogwildTrainer<Fp>::TrainEpoch(const BatchSampler& sampler,
+                                  const Matrix<T>& data,
+                                  const MatType& labels, Fp input_scale) {
+  CHECK(data.Rows() == labels.Rows())
+      << "Number of samples in data and labels must be the same.";
+  const size_t num_batches = sampler.NumBatches();
+  std::atomic<size_t> next_batch{0};
+  ThreadPool::Global().ParallelFor(
+      0, workers_.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t w = begin; w < end; ++w) {
+          Worker& worker = workers_[w];
+          worker.loss = Fp(0);
+          while (true) {
+            const size_t batch =
+                next_batch.fetch_add(1, std::memory_order_relaxed);
+            if (batch >= num_batches)
+              break;
+            sampler.Gather(batch, data, worker.data_batch, input_scale);
+            sampler.Gather(batch, labels, worker.labels_batch);
+            worker.loss += worker.replica.TrainStep(worker.data_batch,
+                                                    worker.labels_batch);
+          }
+        }
+      });
+
+  Fp loss = Fp(0);
+  for (const Worker& worker : workers_) {
+    loss += worker.loss;
+  }
+  return loss / static_cast<Fp>(num_batches);
+}
+
+template <std::floating_point Fp>
+template <Numeric T>
+void HogwildTrainer<Fp>::Train(const Matrix<T>& raw_train_data,
+                               const MatType& raw_train_labels,
+                               const Matrix<T>& raw_test_data,
+                               const MatType& raw_test_labels,
+                               uint32_t epochs, uint32_t batch_size,
+                               EpochCallback on_epoch_end, Fp input_scale) {
+  CHECK(raw_train_data.Rows() == raw_train_labels.Rows())
+      << "Number of samples in data and labels must be the same.";
+
+  const size_t max_batch =
+      std::min<size_t>(batch_size, raw_train_data.Rows());
+  WorkspacePlan plan;
+  for (Worker& worker : workers_) {
+    plan = worker.replica.PlanWorkspace(max_batch, raw_train_data.Cols());
+    worker.data_batch.Reserve(max_batch, raw_train_data.Cols());
+    worker.labels_batch.Reserve(max_batch, raw_train_labels.Cols());
+  }
+  LOG(INFO) << "Training workspace: " << plan.buffers.size()
+            << " buffers, " << plan.TotalBytes() / 1024 << " KiB per worker";
+
+  Training::RunEpochs(
+      network_, raw_train_data, raw_train_labels, raw_test_data,
+      raw_test_labels, epochs, batch_size,
+      absl::StrCat(workers_.size(), " Hogwild workers"), on_epoch_end,
+      input_scale, [&](uint32_t, const BatchSampler& sampler) {
+        auto start = std::chrono::steady_clock::now();
+        Fp loss =
+            TrainEpoch(sampler, raw_train_data, raw_train_labels, input_scale);
+        const double seconds = std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
+        return Training::EpochSummary<Fp>{
+            loss,
+            absl::StrCat("\nSamples/s: ", raw_train_data.Rows() / seconds)};
+      });
+}
@@ -0,0 +1,77 @@
+// MIT License
+
+// Defines asynchronous, lock-free (Hogwild-style) training on the shared
+// thread pool. Every worker runs forward and backward on its own batches
+// with its own training buffers and applies its update straight to the
+// weights of the network, which all workers read and write at the same time
+// without locks (see LinearLayer::CloneSharingParameters). Updates that
+// race may be lost or read half-applied, which SGD tolerates. Rows of zero
+// gradient are not written, and the sparse MNIST inputs leave many of
+// them, so workers rarely write to the same cache lines.
+//
+// Workers take the batches of an epoch from a shared counter, so faster
+// workers take more. Unlike DataParallelTrainer, no worker waits for
+// another, but results depend on thread timing with more than one worker.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_HOGWILD_TRAINER_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_HOGWILD_TRAINER_H_
+
+#include <cstdint>
+
+#include <concepts>
+#include <vector>
+
+#include "batch_sampler.h"
+#include "matrix.h"
+#include "neural_network.h"
+
+template <std::floating_point Fp>
+class HogwildTrainer {
+ public:
+  using MatType = Matrix<Fp>;
+  using EpochCallback = typename NeuralNetwork<Fp>::EpochCallback;
+
+  // Trains network in place with num_workers workers, 0 uses one per
+  // thread a parallel operation may use (ThreadPool::MaxParallelism). The
+  // network must outlive the trainer and must not be trained by other means
+  // while the trainer is in use. Requires at least one layer.
+  explicit HogwildTrainer(NeuralNetwork<Fp>& network,
+                          uint32_t num_workers = 0);
+
+  HogwildTrainer(const HogwildTrainer&) = delete;
+  HogwildTrainer& operator=(const HogwildTrainer&) = delete;
+
+  size_t NumWorkers() const noexcept;
+
+  // Trains once on every batch of sampler (in its current order), with the
+  // batches spread across the workers, and returns the mean batch loss.
+  // Every worker gathers its own batches, times input_scale (see
+  // NeuralNetwork::Train).
+  template <Numeric T>
+  Fp TrainEpoch(const BatchSampler& sampler, const Matrix<T>& data,
+                const MatType& labels, Fp input_scale = Fp(1));
+  // Same as NeuralNetwork::Train, with asynchronous epochs. Also logs the
+  // training throughput of every epoch.
+  template <Numeric T>
+  void Train(const Matrix<T>& raw_train_data, const MatType& raw_train_labels,
+             const Matrix<T>& raw_test_data, const MatType& raw_test_labels,
+             uint32_t epochs, uint32_t batch_size,
+             EpochCallback on_epoch_end = nullptr, Fp input_scale = Fp(1));
+
+ private:
+  struct Worker {
+    // Layers sharing the parameters of the network
+    NeuralNetwork<Fp> replica;
+    MatType data_batch;
+    MatType labels_batch;
+    // Sum of the batch losses of the current epoch
+    Fp loss = Fp(0);
+  };
+
+  NeuralNetwork<Fp>& network_;
+  std::vector<Worker> workers_;
+};
+
+#include "hogwild_trainer-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_HOGWILD_TRAINER_H_
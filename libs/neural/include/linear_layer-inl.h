@@ -3,16 +3,19 @@
 // Implementation of LinearLayer methods.
 // Intended only to be included by linear_layer.h.
 
+#include <algorithm>
 #include <cmath>
+#include <memory>
 #include <random>
+#include <span>
+#include <vector>
 
 template <std::floating_point Fp>
 LinearLayer<Fp>::LinearLayer()
     : weights_(),
       biases_(),
       learning_rate_(Fp(0)),
-      grad_weights_(),
-      grad_biases_(),
+      grad_params_(),
       input_cache_() {}
 
 template <std::floating_point Fp>
@@ -21,10 +24,8 @@ LinearLayer<Fp>::LinearLayer(uint32_t input_size, uint32_t output_size,
     : weights_(input_size, output_size),
       biases_(1, output_size),  // Biases initialized to zero
       learning_rate_(learning_rate),
-      grad_weights_(input_size,
-                    output_size),    // Initialized to zero
-      grad_biases_(1, output_size),  // Initialized to zero
-      input_cache_(0, 0)             // Empty cache
+      grad_params_(input_size + 1, output_size),  // Initialized to zero
+      input_cache_(0, 0)                          // Empty cache
 {
   // Xaiver initialization
   Fp limit = std::sqrt(Fp(6) / Fp(input_size + output_size));
@@ -39,30 +40,158 @@ LayerType LinearLayer<Fp>::Type() const {
 }
 
 template <std::floating_point Fp>
-Matrix<Fp> LinearLayer<Fp>::Forward(const Matrix<Fp>& input) {
+const Matrix<Fp>& LinearLayer<Fp>::Forward(MatrixView<Fp> input) {
+  return ForwardWithEpilogue(input, false);
+}
+
+template <std::floating_point Fp>
+const Matrix<Fp>& LinearLayer<Fp>::ForwardReLU(MatrixView<Fp> input) {
+  return ForwardWithEpilogue(input, true);
+}
+
+template <std::floating_point Fp>
+void LinearLayer<Fp>::Infer(MatrixView<Fp> input, Matrix<Fp>& output) const {
+  InferWithEpilogue(input, false, output);
+}
+
+template <std::floating_point Fp>
+void LinearLayer<Fp>::InferReLU(MatrixView<Fp> input,
+                                Matrix<Fp>& output) const {
+  InferWithEpilogue(input, true, output);
+}
+
+template <std::floating_point Fp>
+void LinearLayer<Fp>::InferWithEpilogue(MatrixView<Fp> input, bool relu,
+                                        Matrix<Fp>& output) const {
   // Linear transformation: output = input * weights + biases
-  Matrix<Fp> output = input * weights_;
-  output += biases_.BroadcastRows(output.Rows());
-  input_cache_ = input;  // Cache input for backpropagation
-  return output;
+  // The bias (and the activation) are added to each output tile by the GEMM
+  // engine while it is stored, see Gemm::Epilogue
+  Gemm::Epilogue<Fp> epilogue;
+  epilogue.bias = Biases().ToVector().data();
+  epilogue.relu = relu;
+  Matrix<Fp>::MultiplyInto(input, Transpose::kNo, Weights(), Transpose::kNo,
+                           epilogue, output);
+}
+
+template <std::floating_point Fp>
+const Matrix<Fp>& LinearLayer<Fp>::ForwardWithEpilogue(MatrixView<Fp> input,
+                                                        bool relu) {
+  InferWithEpilogue(input, relu, output_);
+  relu_output_ = relu;
+
+  // Cache input for backpropagation, with a column of ones for the biases
+  const size_t cols = input.Cols();
+  input_cache_.Resize(input.Rows(), cols + 1);
+  for (size_t r = 0; r < input.Rows(); ++r) {
+    const Fp* row = input.Data() + r * input.RowStride();
+    std::copy(row, row + cols, &input_cache_(r, 0));
+    input_cache_(r, cols) = Fp(1);
+  }
+  return output_;
+}
+
+template <std::floating_point Fp>
+const Matrix<Fp>& LinearLayer<Fp>::Backward(const Matrix<Fp>& grad_output) {
+  return BackwardMasked(grad_output, MatrixView<Fp>());
+}
+
+template <std::floating_point Fp>
+const Matrix<Fp>& LinearLayer<Fp>::BackwardReLU(
+    const Matrix<Fp>& grad_activations) {
+  CHECK(relu_output_ && "BackwardReLU requires a preceding ForwardReLU.");
+  // The activations are positive exactly where the ReLU passes gradients
+  return BackwardMasked(grad_activations, output_);
 }
 
 template <std::floating_point Fp>
-Matrix<Fp> LinearLayer<Fp>::Backward(const Matrix<Fp>& grad_output) {
-  // Compute gradients
-  grad_weights_ = input_cache_.GetTranspose() * grad_output;
-  grad_biases_ = grad_output.CollapseRows();
+const Matrix<Fp>& LinearLayer<Fp>::BackwardMasked(
+    const Matrix<Fp>& grad_output, MatrixView<Fp> mask) {
+  // Compute gradients: [input, 1]^T * grad_output (read in place, see
+  // gemm.h). The row of ones sums grad_output over the batch into the bias
+  // gradient, in the same sweep as the weight gradient.
+  Matrix<Fp>::MaskedMultiplyInto(input_cache_, Transpose::kYes, grad_output,
+                                 Transpose::kNo, MatrixView<Fp>(), mask,
+                                 grad_params_);
 
-  // Gradient to propagate to previous layer
-  Matrix<Fp> grad_input = grad_output * weights_.GetTranspose();
-  return grad_input;
+  // Gradient to propagate to previous layer: grad_output * weights^T
+  Matrix<Fp>::MaskedMultiplyInto(grad_output, Transpose::kNo, Weights(),
+                                 Transpose::kYes, mask, MatrixView<Fp>(),
+                                 grad_input_);
+  return grad_input_;
+}
+
+template <std::floating_point Fp>
+size_t LinearLayer<Fp>::ReserveWorkspace(
+    size_t max_rows, size_t input_cols,
+    std::vector<WorkspaceBuffer>& buffers) {
+  CHECK(input_cols == Weights().Rows())
+      << "Input columns must match the layer inputs.";
+  const size_t outputs = Weights().Cols();
+  input_cache_.Reserve(max_rows, input_cols + 1);
+  output_.Reserve(max_rows, outputs);
+  grad_input_.Reserve(max_rows, input_cols);
+  auto add = [&](const char* name, const Matrix<Fp>& buffer) {
+    buffers.push_back(
+        {.name = name, .bytes = buffer.ToVector().capacity() * sizeof(Fp)});
+  };
+  add("input_cache", input_cache_);
+  add("output", output_);
+  add("grad_params", grad_params_);
+  add("grad_input", grad_input_);
+  return outputs;
+}
+
+template <std::floating_point Fp>
+std::span<Fp> LinearLayer<Fp>::Gradients() {
+  return grad_params_.ToVector();
+}
+
+template <std::floating_point Fp>
+std::unique_ptr<NeuralLayer<Fp>> LinearLayer<Fp>::Clone() const {
+  auto clone = std::make_unique<LinearLayer<Fp>>();
+  clone->weights_ = Weights();
+  clone->biases_ = Biases();
+  clone->learning_rate_ = learning_rate_;
+  clone->grad_params_.Resize(Weights().Rows() + 1, Weights().Cols(), 0);
+  return clone;
+}
+
+template <std::floating_point Fp>
+std::unique_ptr<NeuralLayer<Fp>> LinearLayer<Fp>::CloneSharingParameters() {
+  auto clone = std::make_unique<LinearLayer<Fp>>();
+  clone->owner_ = owner_ != nullptr ? owner_ : this;
+  clone->learning_rate_ = learning_rate_;
+  clone->grad_params_.Resize(Weights().Rows() + 1, Weights().Cols(), 0);
+  return clone;
 }
 
 template <std::floating_point Fp>
 void LinearLayer<Fp>::UpdateWeights() {
   // Update weights and biases using gradient descent
-  weights_ -= grad_weights_ * learning_rate_;
-  biases_ -= grad_biases_ * learning_rate_;
+  if (owner_ == nullptr) {
+    const size_t inputs = weights_.Rows();
+    weights_ -= grad_params_.RowRange(0, inputs) * learning_rate_;
+    biases_ -= grad_params_.RowRange(inputs, inputs + 1) * learning_rate_;
+    return;
+  }
+
+  // Shared parameters: other clones update them at the same time, and an
+  // update that races with another may be lost, which Hogwild-style SGD
+  // tolerates. Elements are aligned, so they are never torn.
+  Matrix<Fp>& weights = owner_->weights_;
+  Matrix<Fp>& biases = owner_->biases_;
+  const size_t inputs = weights.Rows();
+  const size_t outputs = weights.Cols();
+  for (size_t r = 0; r <= inputs; ++r) {
+    const Fp* gradient = &grad_params_(r, 0);
+    if (std::all_of(gradient, gradient + outputs,
+                    [](Fp g) { return g == Fp(0); }))
+      continue;
+    Fp* parameters = r < inputs ? &weights(r, 0) : &biases(0, 0);
+    for (size_t c = 0; c < outputs; ++c) {
+      parameters[c] -= gradient[c] * learning_rate_;
+    }
+  }
 }
 
 // Serialization
@@ -77,12 +206,12 @@ absl::Status LinearLayer<Fp>::Serialize(std::ostream& out) const {
             sizeof(learning_rate_));
 
   // Save weights
-  absl::Status status = weights_.Serialize(out);
+  absl::Status status = Weights().Serialize(out);
   if (!status.ok())
     return status;
 
   // Save biases (returns absl::Status)
-  return biases_.Serialize(out);
+  return Biases().Serialize(out);
 }
 template <std::floating_point Fp>
 absl::Status LinearLayer<Fp>::Deserialize(std::istream& in) {
@@ -116,15 +245,31 @@ absl::Status LinearLayer<Fp>::Deserialize(std::istream& in) {
     return status;
 
   // --- CRITICAL
-  // Since we used the default constructor, grad_weights_ is 0x0.
+  // Since we used the default constructor, grad_params_ is 0x0.
   // We must resize it to match the newly loaded weights_, otherwise
   // the first training step after loading will crash.
-  grad_weights_.Resize(weights_.Rows(), weights_.Cols(), 0);
-  grad_biases_.Resize(biases_.Rows(), biases_.Cols(), 0);
+  grad_params_.Resize(weights_.Rows() + 1, weights_.Cols(), 0);
   
   return absl::OkStatus();
 }
 
+template <std::floating_point Fp>
+Matrix<Fp>& LinearLayer<Fp>::Weights() {
+  return owner_ != nullptr ? owner_->weights_ : weights_;
+}
+template <std::floating_point Fp>
+const Matrix<Fp>& LinearLayer<Fp>::Weights() const {
+  return owner_ != nullptr ? owner_->weights_ : weights_;
+}
+template <std::floating_point Fp>
+Matrix<Fp>& LinearLayer<Fp>::Biases() {
+  return owner_ != nullptr ? owner_->biases_ : biases_;
+}
+template <std::floating_point Fp>
+const Matrix<Fp>& LinearLayer<Fp>::Biases() const {
+  return owner_ != nullptr ? owner_->biases_ : biases_;
+}
+
 template <std::floating_point Fp>
 Fp LinearLayer<Fp>::GetLearningRate() const {
   return learning_rate_;
@@ -6,6 +6,8 @@
 #include <cstdint>
 
 #include <concepts>
+#include <memory>
+#include <span>
 
 #include "matrix.h"
 #include "neural_layer.h"
@@ -27,8 +29,33 @@ class LinearLayer : public NeuralLayer<Fp> {
   LinearLayer& operator=(LinearLayer&&) noexcept = default;
 
   LayerType Type() const override;
-  Matrix<Fp> Forward(const Matrix<Fp>& input) override;
-  Matrix<Fp> Backward(const Matrix<Fp>& grad_output) override;
+  const Matrix<Fp>& Forward(MatrixView<Fp> input) override;
+  // Computes max(0, input * weights + biases) in the same pass as the
+  // product, for a ReLU layer that follows this one (see
+  // ReLULayer::ForwardFused). Backward is the same after either forward.
+  const Matrix<Fp>& ForwardReLU(MatrixView<Fp> input);
+  const Matrix<Fp>& Backward(const Matrix<Fp>& grad_output) override;
+  void Infer(MatrixView<Fp> input, Matrix<Fp>& output) const override;
+  // Infer for this layer and the ReLU that follows it, fused like
+  // ForwardReLU.
+  void InferReLU(MatrixView<Fp> input, Matrix<Fp>& output) const;
+  // Backward through this layer and the ReLU fused onto it by ForwardReLU,
+  // given the gradient of the activations. The ReLU derivative is applied
+  // while the GEMM engine packs the gradient, the masked gradient is never
+  // written out.
+  const Matrix<Fp>& BackwardReLU(const Matrix<Fp>& grad_activations);
+  // Also covers ForwardReLU and BackwardReLU, which use the same buffers.
+  size_t ReserveWorkspace(size_t max_rows, size_t input_cols,
+                          std::vector<WorkspaceBuffer>& buffers) override;
+  // The weight gradients followed by the bias gradients
+  std::span<Fp> Gradients() override;
+  std::unique_ptr<NeuralLayer<Fp>> Clone() const override;
+  // Training on the clone updates the weights of this layer in place,
+  // without locks, while other clones read and update them too. Rows whose
+  // gradient is zero (inputs that were zero over the whole batch, like the
+  // border pixels of MNIST) are not written, so workers do not invalidate
+  // each other's cache lines for nothing.
+  std::unique_ptr<NeuralLayer<Fp>> CloneSharingParameters() override;
   void UpdateWeights() override;
 
   // Serialization
@@ -41,10 +68,34 @@ class LinearLayer : public NeuralLayer<Fp> {
  private:
   Matrix<Fp> weights_;
   Matrix<Fp> biases_;
-  Matrix<Fp> grad_weights_;
-  Matrix<Fp> grad_biases_;
+  // Gradients of the weights (first input_size rows) and of the biases
+  // (last row)
+  Matrix<Fp> grad_params_;
+  // Input of the last forward with a column of ones appended, so that a
+  // single product with the output gradient yields grad_params_
   Matrix<Fp> input_cache_;
+  Matrix<Fp> output_;
+  Matrix<Fp> grad_input_;
   Fp learning_rate_;
+  // Whether output_ holds ReLU activations (ForwardReLU)
+  bool relu_output_ = false;
+  // Layer whose parameters this one uses instead of its own (see
+  // CloneSharingParameters), null if it owns them
+  LinearLayer* owner_ = nullptr;
+
+  // The parameters in use, those of owner_ if there is one
+  Matrix<Fp>& Weights();
+  const Matrix<Fp>& Weights() const;
+  Matrix<Fp>& Biases();
+  const Matrix<Fp>& Biases() const;
+
+  const Matrix<Fp>& ForwardWithEpilogue(MatrixView<Fp> input, bool relu);
+  void InferWithEpilogue(MatrixView<Fp> input, bool relu,
+                         Matrix<Fp>& output) const;
+  // Backward with grad_output read through mask (see
+  // Matrix::MaskedMultiplyInto)
+  const Matrix<Fp>& BackwardMasked(const Matrix<Fp>& grad_output,
+                                   MatrixView<Fp> mask);
 };
 
 #include "linear_layer-inl.h"
@@ -3,48 +3,61 @@
 #ifndef MNIST_DIGIT_RECOGNITON_LIBS_NEURAL_LOSS_H_
 #define MNIST_DIGIT_RECOGNITON_LIBS_NEURAL_LOSS_H_
 
-#include <cmath>
+#include <type_traits>
 
+#include <absl/log/check.h>
+
+#include "fast_math.h"
 #include "matrix.h"
+#include "simd_kernels.h"
 
 namespace Loss {
 
+// Labels are taken as views (a minibatch may be a row range of the dataset).
+// They do not take part in deducing Fp, so a Matrix converts implicitly.
+
+// Turns each row of logits into probabilities using the softmax function,
+// writing them into probabilities (resized to the shape of logits, its
+// storage is reused). probabilities may be logits.
+template <std::floating_point Fp>
+void SoftmaxInto(const Matrix<Fp>& logits, Matrix<Fp>& probabilities) {
+  probabilities.Resize(logits.Rows(), logits.Cols());
+  if (logits.Cols() == 0)
+    return;
+  // Row by row, each row is shifted by its max for numerical stability
+  Simd::Softmax<Fp>().softmax(logits.ToVector().data(),
+                              probabilities.ToVector().data(), logits.Rows(),
+                              logits.Cols());
+}
+
 // Turns one row of logits into probabilities using the softmax function.
 template <std::floating_point Fp>
 Matrix<Fp> Softmax(const Matrix<Fp>& logits) {
-  // Create a matrix to store probabilities
-  Matrix<Fp> probabilities{logits.Rows(), logits.Cols()};
-  // Row by row softmax computation
-  for (size_t r = 0; r < logits.Rows(); ++r) {
-    // Find max logit for numerical stability
-    Fp max_logit = logits.MaxInRow(r);
-    // Compute sum of exponentials for the current row (denominator)
-    Fp sum_of_exponentials = Fp(0);
-    for (size_t c = 0; c < logits.Cols(); ++c) {
-      sum_of_exponentials += std::exp(logits(r, c) - max_logit);
-    }
-    // Compute probabilities for the current row
-    for (size_t c = 0; c < logits.Cols(); ++c) {
-      probabilities(r, c) = std::exp(logits(r, c) - max_logit) / sum_of_exponentials;
-    }
-  }
+  Matrix<Fp> probabilities;
+  SoftmaxInto(logits, probabilities);
   return probabilities;
 }
 
 // Computes the softmax cross-entropy loss between logits and true labels.
+// Only the probability of the true class is needed, so no probability
+// matrix is materialized.
 template <std::floating_point Fp>
 Fp SoftmaxCrossEntropy(const Matrix<Fp>& logits,
-                       const Matrix<Fp>& true_labels) {
-  // Get the probabilities via softmax
-  Matrix<Fp> probabilities = Softmax(logits);
-
+                       std::type_identity_t<MatrixView<Fp>> true_labels) {
   // Compute the cross-entropy loss
   Fp total_loss = Fp(0);
   for (size_t r = 0; r < logits.Rows(); ++r) {
+    Fp max_logit = logits.MaxInRow(r);
+    Fp sum_of_exponentials = Fp(0);
+    for (size_t c = 0; c < logits.Cols(); ++c) {
+      sum_of_exponentials += FastMath::Exp(logits(r, c) - max_logit);
+    }
     for (size_t c = 0; c < logits.Cols(); ++c) {
-      // Find the correct class and accumulate loss
+      // Find the correct class and accumulate loss, as
+      // -log(probability) = log(sum) - (logit - max), which is never log(0)
       if (true_labels(r, c) == Fp(1)) {
-        total_loss -= std::log(probabilities(r, c) + 1e-15);  // Avoid log(0)
+        total_loss += FastMath::Log(sum_of_exponentials) -
+                      (logits(r, c) - max_logit);
         break;
       }
     }
@@ -52,23 +65,46 @@ Fp SoftmaxCrossEntropy(const Matrix<Fp>& logits,
   return total_loss / static_cast<Fp>(logits.Rows());  // Average loss
 }
 
-// Computes the gradient of the softmax cross-entropy loss w.r.t. logits.
+// Computes the softmax cross-entropy loss between logits and true labels
+// (averaged over the rows) and writes its gradient w.r.t. logits into
+// gradient (resized to the shape of logits, its storage is reused), in one
+// pass with a single exponential per element. gradient may be logits, the
+// gradient then replaces the logits in place.
 template <std::floating_point Fp>
-Matrix<Fp> SoftmaxCrossEntropyGradient(const Matrix<Fp>& logits,
-                                       const Matrix<Fp>& true_labels) {
-  // Get the probabilities via softmax
-  Matrix<Fp> probabilities = Softmax(logits);
-
-  // Gradient is probabilities - true_labels (Copy probabilities to avoid modifying input)
-  Matrix<Fp> gradient = probabilities;
+Fp SoftmaxCrossEntropyWithGradient(
+    const Matrix<Fp>& logits, std::type_identity_t<MatrixView<Fp>> true_labels,
+    Matrix<Fp>& gradient) {
+  CHECK(logits.Rows() == true_labels.Rows() &&
+        logits.Cols() == true_labels.Cols() &&
+        "Logits and labels must have the same shape.");
+  CHECK(logits.Rows() > 0 && logits.Cols() > 0 &&
+        "Cannot compute the loss of an empty batch.");
+  gradient.Resize(logits.Rows(), logits.Cols());
+  // Gradient is probabilities - true_labels, averaged over the batch
+  const Fp inverse_rows = Fp(1) / static_cast<Fp>(logits.Rows());
+  Fp total_loss = Simd::Softmax<Fp>().cross_entropy(
+      logits.ToVector().data(), true_labels.Data(), true_labels.RowStride(),
+      gradient.ToVector().data(), inverse_rows, logits.Rows(), logits.Cols());
+  return total_loss * inverse_rows;  // Average loss
+}
 
-  for (size_t r = 0; r < logits.Rows(); ++r) {
-    for (size_t c = 0; c < logits.Cols(); ++c) {
-      gradient(r, c) -= true_labels(r, c);  // Subtract true label
-    }
-  }
-  gradient /= static_cast<Fp>(logits.Rows());  // Average
+// Computes the gradient of the softmax cross-entropy loss w.r.t. logits
+// into gradient (resized to the shape of logits, its storage is reused).
+// gradient may be logits.
+template <std::floating_point Fp>
+void SoftmaxCrossEntropyGradientInto(
+    const Matrix<Fp>& logits, std::type_identity_t<MatrixView<Fp>> true_labels,
+    Matrix<Fp>& gradient) {
+  (void)SoftmaxCrossEntropyWithGradient(logits, true_labels, gradient);
+}
 
+// Computes the gradient of the softmax cross-entropy loss w.r.t. logits.
+template <std::floating_point Fp>
+Matrix<Fp> SoftmaxCrossEntropyGradient(
+    const Matrix<Fp>& logits,
+    std::type_identity_t<MatrixView<Fp>> true_labels) {
+  Matrix<Fp> gradient;
+  SoftmaxCrossEntropyGradientInto(logits, true_labels, gradient);
   return gradient;
 }
 
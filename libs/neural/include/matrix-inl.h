@@ -5,12 +5,15 @@
 
 #include <cstdint>
 
+#include <algorithm>
 #include <random>
-#include <thread>
 
 #include <absl/log/check.h>
 #include <absl/strings/str_cat.h>
 
+#include "gemm.h"
+#include "simd_kernels.h"
+#include "thread_pool.h"
 #include "type_traits.h"
 
 template <Numeric T>
@@ -19,20 +22,55 @@ Matrix<T>::Matrix() : rows_(0), cols_(0) {}
 // Constructor from data vector
 template <Numeric T>
 Matrix<T>::Matrix(const std::vector<T>& data, size_t rows, size_t cols)
-    : data_(data), rows_(rows), cols_(cols) {
+    : data_(data.begin(), data.end()), rows_(rows), cols_(cols) {
   CHECK(data.size() == rows * cols && "Data size must match matrix dimensions");
 }
 
+// Constructor taking over aligned storage
+template <Numeric T>
+template <typename S>
+  requires std::same_as<S, typename Matrix<T>::Storage>
+Matrix<T>::Matrix(S&& data, size_t rows, size_t cols)
+    : data_(std::move(data)), rows_(rows), cols_(cols) {
+  CHECK(data_.size() == rows * cols &&
+        "Data size must match matrix dimensions");
+}
+
 // Constructor with specified dimensions and default initialization
 template <Numeric T>
 Matrix<T>::Matrix(size_t rows, size_t cols)
     : data_(rows * cols, T(0)), rows_(rows), cols_(cols) {}
 
+// Constructor evaluating an expression
+template <Numeric T>
+template <Expr::Expression E>
+  requires std::same_as<typename E::ValueType, T>
+Matrix<T>::Matrix(const E& expr)
+    : data_(expr.Rows() * expr.Cols()),
+      rows_(expr.Rows()),
+      cols_(expr.Cols()) {
+  Expr::Evaluate<Expr::Store>(expr, data_.data());
+}
+
+template <Numeric T>
+template <Expr::Expression E>
+  requires std::same_as<typename E::ValueType, T>
+Matrix<T>& Matrix<T>::operator=(const E& expr) {
+  if (rows_ == expr.Rows() && cols_ == expr.Cols()) {
+    // Reuses the storage, safe even if this matrix is an operand
+    Expr::Evaluate<Expr::Store>(expr, data_.data());
+  } else {
+    // The expression may still read this matrix, so build the result aside
+    *this = Matrix(expr);
+  }
+  return *this;
+}
+
 // Static function
 template <Numeric T>
 Matrix<T> Matrix<T>::Random(size_t rows, size_t cols, T min, T max,
                             uint32_t seed) {
-  std::vector<T> data(rows * cols);
+  Storage data(rows * cols);
   std::mt19937 gen(seed);
   if constexpr (std::is_integral_v<T>) {
     std::uniform_int_distribution<T> dist(min, max);
@@ -43,7 +81,7 @@ Matrix<T> Matrix<T>::Random(size_t rows, size_t cols, T min, T max,
     for (auto& val : data)
       val = dist(gen);
   }
-  return Matrix<T>(data, rows, cols);
+  return Matrix<T>(std::move(data), rows, cols);
 }
 
 // Serialization
@@ -110,15 +148,54 @@ void Matrix<T>::Resize(size_t new_rows, size_t new_cols, T val) {
   data_.resize(rows_ * cols_, val);
 }
 
+template <Numeric T>
+void Matrix<T>::Reserve(size_t rows, size_t cols) {
+  data_.reserve(rows * cols);
+}
+
 template <Numeric T>
 Matrix<T> Matrix<T>::GetTranspose() const {
-  Matrix<T> transposed(cols_, rows_);
-  for (size_t r = 0; r < rows_; ++r) {
-    for (size_t c = 0; c < cols_; ++c) {
-      transposed(c, r) = (*this)(r, c);
+  Matrix<T> transposed;
+  TransposeInto(transposed);
+  return transposed;
+}
+
+template <Numeric T>
+void Matrix<T>::TransposeInto(Matrix<T>& result) const {
+  CHECK(&result != this && "Cannot transpose a matrix into itself.");
+  result.Resize(cols_, rows_);
+  if (data_.empty())
+    return;
+
+  // Blocks of kBlock x kBlock elements keep the source rows and the
+  // destination rows they write to in L1. Within a block the kernel
+  // transposes 8x8 tiles in registers.
+  constexpr size_t kBlock = 64;
+  const Simd::TransposeFn<T> transpose = Simd::TransposeKernel<T>();
+  auto transpose_cols = [&](size_t col_begin, size_t col_end) {
+    for (size_t col = col_begin; col < col_end; col += kBlock) {
+      const size_t block_cols = std::min(kBlock, col_end - col);
+      for (size_t row = 0; row < rows_; row += kBlock) {
+        transpose(data_.data() + row * cols_ + col, cols_,
+                  std::min(kBlock, rows_ - row), block_cols,
+                  result.data_.data() + col * rows_ + row, rows_);
+      }
     }
+  };
+
+  // Threads take disjoint column ranges, i.e. disjoint result rows
+  const size_t threads = MemoryBoundThreads(data_.size() * sizeof(T));
+  if (threads <= 1) {
+    transpose_cols(0, cols_);
+    return;
   }
-  return transposed;
+  const size_t blocks = (cols_ + kBlock - 1) / kBlock;
+  const size_t grain = (blocks + threads - 1) / threads;
+  ThreadPool::Global().ParallelFor(
+      0, blocks, grain, [&](size_t block_begin, size_t block_end) {
+        transpose_cols(block_begin * kBlock,
+                       std::min(block_end * kBlock, cols_));
+      });
 }
 
 // Collapse Functions
@@ -127,33 +204,57 @@ Matrix<T> Matrix<T>::GetTranspose() const {
 // CollapseRows: returns a row matrix (1 x cols)
 template <Numeric T>
 Matrix<T> Matrix<T>::CollapseRows() const {
+  Matrix<T> result;
+  CollapseRowsInto(result);
+  return result;
+}
+
+template <Numeric T>
+void Matrix<T>::CollapseRowsInto(Matrix<T>& result) const {
   CHECK(rows_ > 0 && "Cannot collapse rows of an empty matrix.");
-  Matrix<T> result(1, cols_);
-  for (size_t c = 0; c < cols_; ++c) {
-    T sum = T(0);
-    for (size_t r = 0; r < rows_; ++r) {
-      sum += (*this)(r, c);
-    }
-    result(0, c) = sum;
+  CHECK(&result != this && "Cannot collapse a matrix into itself.");
+  result.Resize(1, cols_);
+  const Simd::ReductionKernels<T>& kernels = Simd::Reductions<T>();
+  // Threads take disjoint column ranges of whole cache lines, each summing
+  // its range over every row, so no partial sums need combining
+  const size_t threads = MemoryBoundThreads(data_.size() * sizeof(T));
+  constexpr size_t kLine = std::max<size_t>(64 / sizeof(T), 1);
+  const size_t lines = (cols_ + kLine - 1) / kLine;
+  if (threads <= 1 || lines <= 1) {
+    kernels.column_sums(data_.data(), cols_, rows_, cols_,
+                        result.data_.data());
+    return;
   }
-  return result;
+  const size_t grain = (lines + threads - 1) / threads;
+  ThreadPool::Global().ParallelFor(
+      0, lines, grain, [&](size_t line_begin, size_t line_end) {
+        const size_t col = line_begin * kLine;
+        const size_t col_end = std::min(line_end * kLine, cols_);
+        kernels.column_sums(data_.data() + col, cols_, rows_, col_end - col,
+                            result.data_.data() + col);
+      });
 }
 
 // CollapseCols: returns a column matrix (rows x 1)
 template <Numeric T>
 Matrix<T> Matrix<T>::CollapseCols() const {
-  CHECK(cols_ > 0 && "Cannot collapse columns of an empty matrix.");
-  Matrix<T> result(rows_, 1);
-  for (size_t r = 0; r < rows_; ++r) {
-    T sum = T(0);
-    for (size_t c = 0; c < cols_; ++c) {
-      sum += (*this)(r, c);
-    }
-    result(r, 0) = sum;
-  }
+  Matrix<T> result;
+  CollapseColsInto(result);
   return result;
 }
 
+template <Numeric T>
+void Matrix<T>::CollapseColsInto(Matrix<T>& result) const {
+  CHECK(cols_ > 0 && "Cannot collapse columns of an empty matrix.");
+  CHECK(&result != this && "Cannot collapse a matrix into itself.");
+  result.Resize(rows_, 1);
+  const Simd::ReductionKernels<T>& kernels = Simd::Reductions<T>();
+  ForRowRanges(data_.size() * sizeof(T), [&](size_t begin, size_t end) {
+    kernels.row_sums(data_.data() + begin * cols_, end - begin, cols_,
+                     result.data_.data() + begin);
+  });
+}
+
 template <Numeric T>
 T& Matrix<T>::operator()(size_t row, size_t col) noexcept {
   return data_[row * cols_ + col];
@@ -179,102 +280,184 @@ const T& Matrix<T>::At(size_t row, size_t col) const {
 // Uses concurrent multiplication algorithm
 template <Numeric T>
 Matrix<T> Matrix<T>::operator*(const Matrix<T>& other) const {
-  CHECK(cols_ == other.rows_ &&
-        "Matrix dimensions must match for multiplication");
+  return Multiply(*this, Transpose::kNo, other, Transpose::kNo);
+}
 
-  if (rows_ == 0 || cols_ == 0 || other.cols_ == 0) {
-    return Matrix<T>(rows_, other.cols_);
-  }
+template <Numeric T>
+Matrix<T> Matrix<T>::Multiply(MatrixView<T> lhs, Transpose transpose_lhs,
+                              MatrixView<T> rhs, Transpose transpose_rhs) {
+  Matrix<T> result;
+  MultiplyInto(lhs, transpose_lhs, rhs, transpose_rhs, result);
+  return result;
+}
+
+template <Numeric T>
+void Matrix<T>::MultiplyInto(MatrixView<T> lhs, Transpose transpose_lhs,
+                             MatrixView<T> rhs, Transpose transpose_rhs,
+                             Matrix<T>& result) {
+  MultiplyInto(lhs, transpose_lhs, rhs, transpose_rhs, Gemm::Epilogue<T>(),
+               result);
+}
+
+template <Numeric T>
+void Matrix<T>::MultiplyInto(MatrixView<T> lhs, Transpose transpose_lhs,
+                             MatrixView<T> rhs, Transpose transpose_rhs,
+                             const Gemm::Epilogue<T>& epilogue,
+                             Matrix<T>& result) {
+  FusedMultiplyInto(lhs, transpose_lhs, rhs, transpose_rhs,
+                    Gemm::OperandMasks<T>(), epilogue, result);
+}
 
-  // Get number of available hardware threads
-  uint32_t max_threads = std::thread::hardware_concurrency();
-  // Fallback to 2 threads if hardware_concurrency cannot detect
-  if (max_threads == 0) {
-    max_threads = 2;
+template <Numeric T>
+void Matrix<T>::MaskedMultiplyInto(MatrixView<T> lhs, Transpose transpose_lhs,
+                                   MatrixView<T> rhs, Transpose transpose_rhs,
+                                   MatrixView<T> lhs_mask,
+                                   MatrixView<T> rhs_mask, Matrix<T>& result)
+  requires std::floating_point<T> {
+  auto mask_of = [](MatrixView<T> operand, MatrixView<T> mask) -> const T* {
+    if (mask.Data() == nullptr)
+      return nullptr;
+    CHECK(mask.Rows() == operand.Rows() && mask.Cols() == operand.Cols() &&
+          mask.RowStride() == operand.RowStride() &&
+          "Masks must have the shape and row stride of their operand.");
+    return mask.Data();
+  };
+  Gemm::OperandMasks<T> masks;
+  masks.a = mask_of(lhs, lhs_mask);
+  masks.b = mask_of(rhs, rhs_mask);
+  FusedMultiplyInto(lhs, transpose_lhs, rhs, transpose_rhs, masks,
+                    Gemm::Epilogue<T>(), result);
+}
+
+// Private Method
+template <Numeric T>
+void Matrix<T>::FusedMultiplyInto(MatrixView<T> lhs, Transpose transpose_lhs,
+                                  MatrixView<T> rhs, Transpose transpose_rhs,
+                                  const Gemm::OperandMasks<T>& masks,
+                                  const Gemm::Epilogue<T>& epilogue,
+                                  Matrix<T>& result) {
+  // Shapes of op(lhs) and op(rhs)
+  const bool lhs_transposed = transpose_lhs == Transpose::kYes;
+  const bool rhs_transposed = transpose_rhs == Transpose::kYes;
+  const size_t rows = lhs_transposed ? lhs.Cols() : lhs.Rows();
+  const size_t depth = lhs_transposed ? lhs.Rows() : lhs.Cols();
+  const size_t rhs_depth = rhs_transposed ? rhs.Cols() : rhs.Rows();
+  const size_t cols = rhs_transposed ? rhs.Rows() : rhs.Cols();
+  CHECK(depth == rhs_depth &&
+        "Matrix dimensions must match for multiplication");
+  CHECK(!lhs.Overlaps(result.data_.data(), result.data_.size()) &&
+        !rhs.Overlaps(result.data_.data(), result.data_.size()) &&
+        "Product destination must not be an operand.");
+
+  result.Resize(rows, cols);
+  if constexpr (!std::is_floating_point_v<T>) {
+    // The plain algorithm accumulates into the result
+    std::fill(result.data_.begin(), result.data_.end(), T(0));
   }
+  if (rows == 0 || depth == 0 || cols == 0) {
+    std::fill(result.data_.begin(), result.data_.end(), T(0));
+    for (size_t r = 0; r < rows; ++r) {
+      epilogue.Apply(result.data_.data() + r * cols, cols);
+    }
+    return;
+  }
+
+  // Get number of threads the shared pool allows per operation
+  ThreadPool& pool = ThreadPool::Global();
+  uint32_t max_threads = pool.MaxParallelism();
   // Determine optimal number of threads based on work amount
-  const uint64_t kWorkAmount =
-      rows_ * other.cols_ * cols_;  // Approximate work amount
+  const uint64_t kWorkAmount = rows * cols * depth;  // Approximate work amount
   uint32_t work_thread_amount =
       static_cast<uint32_t>(kWorkAmount / Matrix<T>::kMinWorkPerThread);
-  // If no threading is beneficial, use single-threaded multiplication
-  if (work_thread_amount == 0) {
-    return SingleThreadedMatMul(other);
-  }
-  uint32_t thread_amount = std::min(max_threads, work_thread_amount);
-
-  Matrix<T> result(rows_, other.cols_);
-  Matrix<T> other_T = other.GetTranspose();
-
-  // Lambda function to multiply a slice of rows
-  auto MultiplySlice = [&result, &other_T, this](size_t start, size_t end) {
-    for (size_t r = start; r < end; ++r) {
-      for (size_t c = 0; c < other_T.rows_; ++c) {
-        T sum = T(0);
-        for (size_t k = 0; k < cols_; ++k) {
-          sum += (*this)(r, k) * other_T(c, k);
+  uint32_t thread_amount =
+      std::max(1u, std::min(max_threads, work_thread_amount));
+
+  if constexpr (std::is_floating_point_v<T>) {
+    // Blocked, packed multiplication that reads transposed operands in
+    // place (see gemm.h). The output is split into 2D tiles (and K slices
+    // when the batch is small) that run on the persistent pool.
+    Gemm::ParallelMultiply<T>(transpose_lhs, transpose_rhs, rows, cols, depth,
+                              lhs.Data(), lhs.RowStride(), rhs.Data(),
+                              rhs.RowStride(), result.data_.data(), cols, pool,
+                              thread_amount, epilogue, masks);
+  } else {
+    // Tiles span whole cache lines of the output, integral types skip the
+    // K split to stay exact without a reduction pass
+    const Gemm::Partition plan =
+        Gemm::PlanPartition(rows, cols, depth, thread_amount, 1,
+                            std::max<size_t>(64 / sizeof(T), 1), 0);
+    if (plan.Tasks() <= 1) {
+      MultiplyBlock(lhs, transpose_lhs, rhs, transpose_rhs, result, 0, rows,
+                    0, cols);
+    } else {
+      pool.ParallelFor(0, plan.Tasks(), 1, [&](size_t begin, size_t end) {
+        for (size_t task = begin; task < end; ++task) {
+          const size_t row = task / plan.col_blocks * plan.row_step;
+          const size_t col = task % plan.col_blocks * plan.col_step;
+          MultiplyBlock(lhs, transpose_lhs, rhs, transpose_rhs, result, row,
+                        std::min(row + plan.row_step, rows), col,
+                        std::min(col + plan.col_step, cols));
         }
-        result(r, c) = sum;
-      }
+      });
     }
-  };
-  // Calculate the slice start and step size for each thread
-  // end = start + step
-  size_t start = 0;
-  size_t step = rows_ / thread_amount;
-
-  {
-    std::vector<std::jthread> threads;
-    threads.reserve(thread_amount);
-    // Divide work among threads (leave the last thread to handle any remainder)
-    for (size_t i = 0; i < thread_amount - 1; ++i) {
-      threads.emplace_back(MultiplySlice, start, start + step);
-      start += step;
-    }
-    // Last thread handles any remaining rows
-    threads.emplace_back(MultiplySlice, start, rows_);
-  }  // End of thread scope (RAII joins threads)
-
-  return result;
-}
-
-// Private Method
-// Single-threaded matrix multiplication
-template <Numeric T>
-Matrix<T> Matrix<T>::SingleThreadedMatMul(const Matrix<T>& other) const {
-  Matrix<T> result(rows_, other.cols_);
-  for (size_t r = 0; r < rows_; ++r) {
-    for (size_t c = 0; c < other.cols_; ++c) {
-      T sum = T(0);
-      for (size_t k = 0; k < cols_; ++k) {
-        sum += (*this)(r, k) * other(k, c);
+    // The plain algorithm accumulates until the end, then the epilogue runs
+    // as a separate pass
+    if (!epilogue.Empty()) {
+      for (size_t r = 0; r < rows; ++r) {
+        epilogue.Apply(result.data_.data() + r * cols, cols);
       }
-      result(r, c) = sum;
     }
   }
-  return result;
 }
 
 template <Numeric T>
-Matrix<T> Matrix<T>::operator+(const Matrix<T>& other) const {
-  CHECK(rows_ == other.rows_ && cols_ == other.cols_ &&
+void Matrix<T>::AddInto(const Matrix<T>& lhs, const Matrix<T>& rhs,
+                        Matrix<T>& result) {
+  CHECK(lhs.rows_ == rhs.rows_ && lhs.cols_ == rhs.cols_ &&
         "Matrix dimensions must match for addition.");
-  Matrix<T> result(rows_, cols_);
-  for (size_t i = 0; i < rows_ * cols_; ++i) {
-    result.data_[i] = data_[i] + other.data_[i];
-  }
-  return result;
+  // A result of another shape is not an operand, so resizing it is safe.
+  // The expression loop (unlike the restrict-qualified kernels) allows the
+  // result to be an operand.
+  result.Resize(lhs.rows_, lhs.cols_);
+  Expr::Evaluate<Expr::Store>(lhs + rhs, result.data_.data());
 }
 
 template <Numeric T>
-Matrix<T> Matrix<T>::operator-(const Matrix<T>& other) const {
-  CHECK(rows_ == other.rows_ && cols_ == other.cols_ &&
+void Matrix<T>::SubtractInto(const Matrix<T>& lhs, const Matrix<T>& rhs,
+                             Matrix<T>& result) {
+  CHECK(lhs.rows_ == rhs.rows_ && lhs.cols_ == rhs.cols_ &&
         "Matrix dimensions must match for subtraction.");
-  Matrix<T> result(rows_, cols_);
-  for (size_t i = 0; i < rows_ * cols_; ++i) {
-    result.data_[i] = data_[i] - other.data_[i];
+  result.Resize(lhs.rows_, lhs.cols_);
+  Expr::Evaluate<Expr::Store>(lhs - rhs, result.data_.data());
+}
+
+// Private Method
+// Multiplies a block of the output on the calling thread with the plain
+// algorithm, ordered so that the inner loop walks rows of the result
+template <Numeric T>
+void Matrix<T>::MultiplyBlock(MatrixView<T> lhs, Transpose transpose_lhs,
+                              MatrixView<T> rhs, Transpose transpose_rhs,
+                              Matrix<T>& result, size_t row_begin,
+                              size_t row_end, size_t col_begin,
+                              size_t col_end) {
+  // Element (i, j) of op(m) is at data[i * row_stride + j * col_stride]
+  const bool lhs_transposed = transpose_lhs == Transpose::kYes;
+  const bool rhs_transposed = transpose_rhs == Transpose::kYes;
+  const size_t lhs_row_stride = lhs_transposed ? 1 : lhs.RowStride();
+  const size_t lhs_col_stride = lhs_transposed ? lhs.RowStride() : 1;
+  const size_t rhs_row_stride = rhs_transposed ? 1 : rhs.RowStride();
+  const size_t rhs_col_stride = rhs_transposed ? rhs.RowStride() : 1;
+  const size_t depth = lhs_transposed ? lhs.Rows() : lhs.Cols();
+
+  for (size_t r = row_begin; r < row_end; ++r) {
+    for (size_t k = 0; k < depth; ++k) {
+      const T value = lhs.Data()[r * lhs_row_stride + k * lhs_col_stride];
+      const T* rhs_row = rhs.Data() + k * rhs_row_stride;
+      for (size_t c = col_begin; c < col_end; ++c) {
+        result(r, c) += value * rhs_row[c * rhs_col_stride];
+      }
+    }
   }
-  return result;
 }
 
 template <Numeric T>
@@ -282,123 +465,218 @@ Matrix<T>& Matrix<T>::operator*=(const Matrix& other) {
   return *this = (*this) * other;
 }
 
+// Element-wise and scalar operations run on the SIMD kernels selected for
+// the host CPU (see simd_kernels.h)
 template <Numeric T>
 Matrix<T>& Matrix<T>::operator+=(const Matrix& other) {
-  return *this = (*this) + other;
+  CHECK(rows_ == other.rows_ && cols_ == other.cols_ &&
+        "Matrix dimensions must match for addition.");
+  Simd::Kernels<T>().add_assign(data_.data(), other.data_.data(),
+                                data_.size());
+  return *this;
 }
 
 template <Numeric T>
 Matrix<T>& Matrix<T>::operator-=(const Matrix& other) {
-  return *this = (*this) - other;
+  CHECK(rows_ == other.rows_ && cols_ == other.cols_ &&
+        "Matrix dimensions must match for subtraction.");
+  Simd::Kernels<T>().subtract_assign(data_.data(), other.data_.data(),
+                                     data_.size());
+  return *this;
+}
+
+template <Numeric T>
+template <Expr::Expression E>
+  requires std::same_as<typename E::ValueType, T>
+Matrix<T>& Matrix<T>::operator+=(const E& expr) {
+  CHECK(rows_ == expr.Rows() && cols_ == expr.Cols() &&
+        "Matrix dimensions must match for addition.");
+  Expr::Evaluate<Expr::AddStore>(expr, data_.data());
+  return *this;
+}
+
+template <Numeric T>
+template <Expr::Expression E>
+  requires std::same_as<typename E::ValueType, T>
+Matrix<T>& Matrix<T>::operator-=(const E& expr) {
+  CHECK(rows_ == expr.Rows() && cols_ == expr.Cols() &&
+        "Matrix dimensions must match for subtraction.");
+  Expr::Evaluate<Expr::SubtractStore>(expr, data_.data());
+  return *this;
 }
 
 template <Numeric T>
 Matrix<T>& Matrix<T>::operator*=(T scalar) {
-  for (auto& val : data_) {
-    val *= scalar;
-  }
+  Simd::Kernels<T>().multiply_scalar(data_.data(), scalar, data_.size());
   return *this;
 }
 
 template <Numeric T>
 Matrix<T>& Matrix<T>::operator/=(T scalar) {
-  for (auto& val : data_) {
-    CHECK(scalar != T(0) && "Division by zero is invalid.");
-    val /= scalar;
-  }
+  CHECK(scalar != T(0) && "Division by zero is invalid.");
+  Simd::Kernels<T>().divide_scalar(data_.data(), scalar, data_.size());
   return *this;
 }
 
 template <Numeric T>
 Matrix<T>& Matrix<T>::operator+=(T scalar) {
-  for (auto& val : data_) {
-    val += scalar;
-  }
+  Simd::Kernels<T>().add_scalar(data_.data(), scalar, data_.size());
   return *this;
 }
 
 template <Numeric T>
 Matrix<T>& Matrix<T>::operator-=(T scalar) {
-  for (auto& val : data_) {
-    val -= scalar;
-  }
+  Simd::Kernels<T>().subtract_scalar(data_.data(), scalar, data_.size());
   return *this;
 }
 
 template <Numeric T>
-const std::vector<T>& Matrix<T>::ToVector() const noexcept {
+const typename Matrix<T>::Storage& Matrix<T>::ToVector() const noexcept {
   return data_;
 }
 
 template <Numeric T>
-std::vector<T>& Matrix<T>::ToVector() noexcept {
+typename Matrix<T>::Storage& Matrix<T>::ToVector() noexcept {
   return data_;
 }
 
 template <Numeric T>
 Matrix<float> Matrix<T>::ToFloat(float scale) const {
   Matrix<float> result(rows_, cols_);
-  for (size_t r = 0; r < rows_; ++r) {
-    for (size_t c = 0; c < cols_; ++c) {
-      result(r, c) = static_cast<float>((*this)(r, c)) * scale;
-    }
-  }
+  Simd::ConvertKernel<T, float>()(data_.data(), result.ToVector().data(),
+                                  scale, data_.size());
   return result;
 }
 
 template <Numeric T>
 Matrix<double> Matrix<T>::ToDouble(double scale) const {
   Matrix<double> result(rows_, cols_);
-  for (size_t r = 0; r < rows_; ++r) {
-    for (size_t c = 0; c < cols_; ++c) {
-      result(r, c) = static_cast<double>((*this)(r, c)) * scale;
-    }
+  Simd::ConvertKernel<T, double>()(data_.data(), result.ToVector().data(),
+                                   scale, data_.size());
+  return result;
+}
+
+template <Numeric T>
+Expr::BroadcastRows<Matrix<T>> Matrix<T>::BroadcastRows(
+    size_t new_rows) const& {
+  return Expr::BroadcastRows<Matrix<T>>(*this, new_rows);
+}
+
+template <Numeric T>
+Matrix<T> Matrix<T>::BroadcastRows(size_t new_rows) && {
+  // The expression would outlive this temporary, so evaluate it now
+  return Matrix<T>(Expr::BroadcastRows<Matrix<T>>(*this, new_rows));
+}
+
+template <Numeric T>
+MatrixView<T> Matrix<T>::RowRange(size_t begin, size_t end) const {
+  return MatrixView<T>(*this).RowRange(begin, end);
+}
+
+template <Numeric T>
+size_t Matrix<T>::MemoryBoundThreads(uint64_t bytes) {
+  const uint32_t max_threads = ThreadPool::Global().MaxParallelism();
+  return static_cast<size_t>(std::max<uint64_t>(
+      1, std::min<uint64_t>(max_threads, bytes / kMinBytesPerThread)));
+}
+
+template <Numeric T>
+template <typename Fn>
+void Matrix<T>::ForRowRanges(uint64_t bytes, Fn&& fn) const {
+  const size_t threads = MemoryBoundThreads(bytes);
+  if (threads <= 1) {
+    fn(size_t{0}, rows_);
+    return;
   }
+  const size_t grain = (rows_ + threads - 1) / threads;
+  ThreadPool::Global().ParallelFor(0, rows_, grain, fn);
+}
+
+template <Numeric T>
+Matrix<T> Matrix<T>::GatherRows(std::span<const size_t> rows) const {
+  Matrix<T> result;
+  GatherRowsInto(rows, result);
   return result;
 }
 
 template <Numeric T>
-Matrix<T> Matrix<T>::BroadcastRows(size_t new_rows) const {
-  CHECK(new_rows >= rows_ &&
-        "New row count must be greater than or equal to current rows.");
-  Matrix<T> result(new_rows, cols_);
-  for (size_t r = 0; r < new_rows; ++r) {
-    for (size_t c = 0; c < cols_; ++c) {
-      result(r, c) = (*this)(r % rows_, c);
+void Matrix<T>::GatherRowsInto(std::span<const size_t> rows,
+                               Matrix& result) const {
+  CHECK(&result != this && "Result must not be the source of the gather.");
+  for (size_t row : rows) {
+    CHECK(row < rows_ && "Row index out of bounds.");
+  }
+  result.Resize(rows.size(), cols_);
+  if (rows.empty() || cols_ == 0)
+    return;
+
+  const size_t threads = MemoryBoundThreads(rows.size() * cols_ * sizeof(T));
+  const Simd::GatherRowsFn<T> gather = Simd::GatherRowsKernel<T>();
+  if (threads <= 1) {
+    gather(data_.data(), cols_, rows.data(), rows.size(), cols_,
+           result.data_.data());
+    return;
+  }
+  const size_t grain = (rows.size() + threads - 1) / threads;
+  ThreadPool::Global().ParallelFor(
+      0, rows.size(), grain, [&](size_t begin, size_t end) {
+        gather(data_.data(), cols_, rows.data() + begin, end - begin, cols_,
+               result.data_.data() + begin * cols_);
+      });
+}
+
+template <Numeric T>
+template <Numeric U>
+void Matrix<T>::GatherRowsInto(std::span<const size_t> rows,
+                               Matrix<U>& result, U scale) const {
+  if constexpr (std::same_as<T, U>) {
+    if (scale == U(1)) {
+      GatherRowsInto(rows, result);
+      return;
     }
+    CHECK(&result != this && "Result must not be the source of the gather.");
   }
-  return result;
+  for (size_t row : rows) {
+    CHECK(row < rows_ && "Row index out of bounds.");
+  }
+  result.Resize(rows.size(), cols_);
+  if (rows.empty() || cols_ == 0)
+    return;
+
+  // The wider result dominates the traffic
+  const size_t threads = MemoryBoundThreads(rows.size() * cols_ * sizeof(U));
+  const Simd::GatherConvertRowsFn<T, U> gather =
+      Simd::GatherConvertRowsKernel<T, U>();
+  U* out = result.ToVector().data();
+  if (threads <= 1) {
+    gather(data_.data(), cols_, rows.data(), rows.size(), cols_, scale, out);
+    return;
+  }
+  const size_t grain = (rows.size() + threads - 1) / threads;
+  ThreadPool::Global().ParallelFor(
+      0, rows.size(), grain, [&](size_t begin, size_t end) {
+        gather(data_.data(), cols_, rows.data() + begin, end - begin, cols_,
+               scale, out + begin * cols_);
+      });
 }
 
 template <Numeric T>
 Matrix<T> Matrix<T>::ShuffleRows(uint32_t seed) const {
-  Matrix<T> shuffled(*this);
   std::vector<size_t> indices(rows_);
   for (size_t i = 0; i < rows_; ++i) {
     indices[i] = i;
   }
   std::mt19937 gen(seed);
   std::shuffle(indices.begin(), indices.end(), gen);
-  Matrix<T> result(rows_, cols_);
-  for (size_t r = 0; r < rows_; ++r) {
-    for (size_t c = 0; c < cols_; ++c) {
-      result(r, c) = shuffled(indices[r], c);
-    }
-  }
-  return result;
+  return GatherRows(indices);
 }
 
 template <Numeric T>
 size_t Matrix<T>::ArgMaxRow(size_t row) const {
   CHECK(row < rows_ && "Row index out of bounds.");
   size_t max_index = 0;
-  T max_value = (*this)(row, 0);
-  for (size_t c = 1; c < cols_; ++c) {
-    if ((*this)(row, c) > max_value) {
-      max_value = (*this)(row, c);
-      max_index = c;
-    }
-  }
+  Simd::Reductions<T>().row_max(data_.data() + row * cols_, 1, cols_, nullptr,
+                                &max_index);
   return max_index;
 }
 
@@ -447,15 +725,49 @@ size_t Matrix<T>::ArgMinCol(size_t col) const {
 template <Numeric T>
 T Matrix<T>::MaxInRow(size_t row) const {
   CHECK(row < rows_ && "Row index out of bounds.");
-  T max_value = (*this)(row, 0);
-  for (size_t c = 1; c < cols_; ++c) {
-    if ((*this)(row, c) > max_value) {
-      max_value = (*this)(row, c);
-    }
-  }
+  T max_value;
+  Simd::Reductions<T>().row_max(data_.data() + row * cols_, 1, cols_,
+                                &max_value, nullptr);
   return max_value;
 }
 
+template <Numeric T>
+Matrix<T> Matrix<T>::MaxInRows() const {
+  Matrix<T> result;
+  MaxInRowsInto(result);
+  return result;
+}
+
+template <Numeric T>
+void Matrix<T>::MaxInRowsInto(Matrix& result) const {
+  CHECK(cols_ > 0 && "Cannot reduce rows of a matrix without columns.");
+  CHECK(&result != this && "Cannot reduce a matrix into itself.");
+  result.Resize(rows_, 1);
+  const Simd::ReductionKernels<T>& kernels = Simd::Reductions<T>();
+  ForRowRanges(data_.size() * sizeof(T), [&](size_t begin, size_t end) {
+    kernels.row_max(data_.data() + begin * cols_, end - begin, cols_,
+                    result.data_.data() + begin, nullptr);
+  });
+}
+
+template <Numeric T>
+std::vector<size_t> Matrix<T>::ArgMaxRows() const {
+  std::vector<size_t> result;
+  ArgMaxRowsInto(result);
+  return result;
+}
+
+template <Numeric T>
+void Matrix<T>::ArgMaxRowsInto(std::vector<size_t>& result) const {
+  CHECK(cols_ > 0 && "Cannot reduce rows of a matrix without columns.");
+  result.resize(rows_);
+  const Simd::ReductionKernels<T>& kernels = Simd::Reductions<T>();
+  ForRowRanges(data_.size() * sizeof(T), [&](size_t begin, size_t end) {
+    kernels.row_max(data_.data() + begin * cols_, end - begin, cols_, nullptr,
+                    result.data() + begin);
+  });
+}
+
 template <Numeric T>
 T Matrix<T>::MinInRow(size_t row) const {
   CHECK(row < rows_ && "Row index out of bounds.");
@@ -514,57 +826,3 @@ size_t Matrix<T>::Cols() const noexcept {
   return cols_;
 }
 
-// ---------
-// Non-member Scalar Operations
-// ---------
-template <Numeric T>
-inline Matrix<T> operator*(Matrix<T> lhs, T rhs) {
-  return lhs *= rhs;
-}
-
-template <Numeric T>
-inline Matrix<T> operator*(T lhs, Matrix<T> rhs) {
-  return rhs *= lhs;
-}
-
-template <Numeric T>
-inline Matrix<T> operator+(Matrix<T> lhs, T rhs) {
-  return lhs += rhs;
-}
-
-template <Numeric T>
-inline Matrix<T> operator+(T lhs, Matrix<T> rhs) {
-  return rhs += lhs;
-}
-
-template <Numeric T>
-inline Matrix<T> operator-(Matrix<T> lhs, T rhs) {
-  return lhs -= rhs;
-}
-
-template <Numeric T>
-inline Matrix<T> operator-(T lhs, Matrix<T> rhs) {
-  for (size_t r = 0; r < rhs.Rows(); ++r) {
-    for (size_t c = 0; c < rhs.Cols(); ++c) {
-      rhs(r, c) = lhs - rhs(r, c);
-    }
-  }
-  return rhs;
-}
-
-template <Numeric T>
-inline Matrix<T> operator/(Matrix<T> lhs, T rhs) {
-  CHECK(rhs != T(0) && "Division by zero is invalid.");
-  return lhs /= rhs;
-}
-
-template <Numeric T>
-inline Matrix<T> operator/(T lhs, Matrix<T> rhs) {
-  for (size_t r = 0; r < rhs.Rows(); ++r) {
-    for (size_t c = 0; c < rhs.Cols(); ++c) {
-      CHECK(rhs(r, c) != T(0) && "Division by zero is invalid.");
-      rhs(r, c) = lhs / rhs(r, c);
-    }
-  }
-  return rhs;
-}
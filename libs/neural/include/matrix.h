@@ -2,29 +2,46 @@
 
 // Defines a template Matrix class for 2D data storage.
 // This class manages memory and provides basic element access.
-// Multithreaded matrix multiplication is supported.
+// Multithreaded matrix multiplication is supported through the shared
+// thread pool (thread_pool.h). Floating-point products
+// are computed by the cache-blocked GEMM engine in gemm.h.
 
 #ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_MATRIX_H_
 #define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_MATRIX_H_
 
 #include <concepts>
+#include <span>
 #include <vector>
 
+#include "aligned_allocator.h"
+#include "common_types.h"
+#include "gemm.h"
+#include "matrix_expression.h"
+#include "matrix_view.h"
 #include "serializable.h"
 
-template <typename T>
-concept Numeric = std::integral<T> || std::floating_point<T>;
-
 template <Numeric T>
 class [[nodiscard]] Matrix : Serializable {
  public:
+  using ValueType = T;
+  // Cache-line aligned, large matrices may use huge pages
+  // (see aligned_allocator.h)
+  using Storage = Memory::AlignedVector<T>;
+
   // Minimum work per thread to justify multithreading
   // Work is approximated as rows * cols * other.cols
-  inline static uint64_t kMinWorkPerThread = 100'000'000;
+  // A million multiply-adds take tens of microseconds in the GEMM engine,
+  // well above the cost of queueing a task on the pool
+  inline static uint64_t kMinWorkPerThread = 1'000'000;
 
   // Constructors
   Matrix();
   explicit Matrix(const std::vector<T>& data, size_t rows, size_t cols);
+  // Takes over storage without copying (e.g. a loaded Dataset).
+  // A template so that braced lists still pick the std::vector overload.
+  template <typename S>
+    requires std::same_as<S, Storage>
+  explicit Matrix(S&& data, size_t rows, size_t cols);
   explicit Matrix(size_t rows, size_t cols);
 
   // Destructor
@@ -38,6 +55,16 @@ class [[nodiscard]] Matrix : Serializable {
   Matrix(Matrix&& other) noexcept = default;
   Matrix& operator=(Matrix&& other) noexcept = default;
 
+  // Evaluates an element-wise expression (see matrix_expression.h) in a
+  // single pass. Implicit, so that expressions can be used wherever a Matrix
+  // is expected.
+  template <Expr::Expression E>
+    requires std::same_as<typename E::ValueType, T>
+  Matrix(const E& expr);
+  template <Expr::Expression E>
+    requires std::same_as<typename E::ValueType, T>
+  Matrix& operator=(const E& expr);
+
   // Static Random Matrix Generator
   static Matrix Random(size_t rows, size_t cols, T min, T max, uint32_t seed);
 
@@ -45,13 +72,21 @@ class [[nodiscard]] Matrix : Serializable {
   absl::Status Serialize(std::ostream& out) const override;
   absl::Status Deserialize(std::istream& in) override;
 
+  // Resizing keeps the allocated storage, so shrinking and growing back
+  // within it does not allocate
   void Resize(size_t new_rows, size_t new_cols);
   void Resize(size_t new_rows, size_t new_cols, T val);
+  // Allocates storage for rows x cols elements up front without changing
+  // the shape, so that resizing up to that size later does not allocate
+  void Reserve(size_t rows, size_t cols);
 
+  // Blocked for the caches, with 8x8 tiles transposed in registers. Large
+  // matrices are split across the pool.
   Matrix GetTranspose() const;
 
   // Collapse Functions
   // Sums over rows or columns, returning a single-row or single-column matrix
+  // Vectorized, and split across the pool for large matrices
   Matrix CollapseRows() const;  // Returns a row matrix
   Matrix CollapseCols() const;  // Returns a column matrix
 
@@ -66,13 +101,60 @@ class [[nodiscard]] Matrix : Serializable {
   // Operator Overloading for mathematical operations is prohibited in Google style,
   // but since this is a pure mathematical construct, we will make an exception here.
   Matrix operator*(
-      const Matrix& other) const;  // Uses concurrent multiplication
-  Matrix operator+(const Matrix& other) const;
-  Matrix operator-(const Matrix& other) const;
-
-  Matrix& operator*=(const Matrix& other);  // Uses concurrent multiplication
+      const Matrix& other) const;  // Uses concurrent blocked multiplication
+  // Element-wise +, - and scalar *, /, +, - are lazy non-member operators
+  // (see matrix_expression.h)
+
+  // Computes op(lhs) * op(rhs), where op transposes its operand if asked
+  // (BLAS-style NN, NT, TN and TT products). Transposed operands are read in
+  // place, no transposed copy is made. Operands may be views (e.g. a row
+  // range of a larger matrix). Uses concurrent blocked multiplication.
+  static Matrix Multiply(MatrixView<T> lhs, Transpose transpose_lhs,
+                         MatrixView<T> rhs, Transpose transpose_rhs);
+
+  // Destination-passing variants
+  // Write the result into a caller-provided matrix, resized to the result
+  // shape. Its storage is reused, so repeated calls with the same shapes do
+  // not allocate. result must not be an operand unless noted otherwise.
+  static void MultiplyInto(MatrixView<T> lhs, Transpose transpose_lhs,
+                           MatrixView<T> rhs, Transpose transpose_rhs,
+                           Matrix& result);
+  // Same, followed by an element-wise epilogue (scale, per-column bias and
+  // ReLU, see Gemm::Epilogue) whose bias has one value per result column.
+  // Floating-point products apply it to each output tile as the tile is
+  // stored, without another pass over result.
+  static void MultiplyInto(MatrixView<T> lhs, Transpose transpose_lhs,
+                           MatrixView<T> rhs, Transpose transpose_rhs,
+                           const Gemm::Epilogue<T>& epilogue, Matrix& result);
+  // Same as MultiplyInto, with op(lhs) and op(rhs) read as zero wherever
+  // lhs_mask and rhs_mask are not positive. A mask has the shape and row
+  // stride of its operand, an empty view leaves the operand unmasked. The
+  // masks are applied while the GEMM engine packs the operands (see
+  // Gemm::OperandMasks), so a ReLU derivative costs no extra pass.
+  static void MaskedMultiplyInto(MatrixView<T> lhs, Transpose transpose_lhs,
+                                 MatrixView<T> rhs, Transpose transpose_rhs,
+                                 MatrixView<T> lhs_mask,
+                                 MatrixView<T> rhs_mask, Matrix& result)
+    requires std::floating_point<T>;
+  // result may be lhs or rhs
+  static void AddInto(const Matrix& lhs, const Matrix& rhs, Matrix& result);
+  static void SubtractInto(const Matrix& lhs, const Matrix& rhs,
+                           Matrix& result);
+  void TransposeInto(Matrix& result) const;
+  void CollapseRowsInto(Matrix& result) const;
+  void CollapseColsInto(Matrix& result) const;
+
+  Matrix& operator*=(
+      const Matrix& other);  // Uses concurrent blocked multiplication
   Matrix& operator+=(const Matrix& other);
   Matrix& operator-=(const Matrix& other);
+  // Fused: `a -= b * s` evaluates b * s while updating a, no temporary
+  template <Expr::Expression E>
+    requires std::same_as<typename E::ValueType, T>
+  Matrix& operator+=(const E& expr);
+  template <Expr::Expression E>
+    requires std::same_as<typename E::ValueType, T>
+  Matrix& operator-=(const E& expr);
 
   // Scalar Operations
   Matrix& operator*=(T scalar);
@@ -81,13 +163,34 @@ class [[nodiscard]] Matrix : Serializable {
   Matrix& operator-=(T scalar);
 
   // Utility Functions
-  const std::vector<T>& ToVector() const noexcept;
-  std::vector<T>& ToVector() noexcept;
+  const Storage& ToVector() const noexcept;
+  Storage& ToVector() noexcept;
   Matrix<float> ToFloat(float scale = 1.0f) const;
   Matrix<double> ToDouble(double scale = 1.0) const;
 
   // Broadcasts the matrix along rows to match new_rows
-  Matrix<T> BroadcastRows(size_t new_rows) const;
+  // Lazy: `out += bias.BroadcastRows(out.Rows())` adds without copying the
+  // rows. Called on a temporary, the rows are copied right away.
+  Expr::BroadcastRows<Matrix<T>> BroadcastRows(size_t new_rows) const&;
+  Matrix<T> BroadcastRows(size_t new_rows) &&;
+
+  // Non-owning view of rows [begin, end), no data is copied
+  // (see matrix_view.h)
+  MatrixView<T> RowRange(size_t begin, size_t end) const;
+
+  // Copies the listed rows, in order, into a rows.size() x Cols() matrix.
+  // The copy is vectorized, prefetches the rows ahead and is split across
+  // the pool for large gathers.
+  Matrix<T> GatherRows(std::span<const size_t> rows) const;
+  // Same, into result (resized, its storage is reused). result must not be
+  // this matrix.
+  void GatherRowsInto(std::span<const size_t> rows, Matrix& result) const;
+  // Same, converted on the way: result(i, c) = U(row rows[i] at c) * scale,
+  // in one vectorized pass (e.g. uint8_t pixels gathered straight into a
+  // normalized float batch, the dataset never widened as a whole).
+  template <Numeric U>
+  void GatherRowsInto(std::span<const size_t> rows, Matrix<U>& result,
+                      U scale) const;
 
   Matrix<T> ShuffleRows(uint32_t seed) const;
 
@@ -103,6 +206,14 @@ class [[nodiscard]] Matrix : Serializable {
   T MaxInCol(size_t col) const;
   T MinInCol(size_t col) const;
 
+  // Batched row reductions: the maximum of every row (a rows x 1 matrix) and
+  // the first column holding it, in one vectorized call that is split
+  // across the pool for large matrices. The matrix must have columns.
+  Matrix<T> MaxInRows() const;
+  void MaxInRowsInto(Matrix& result) const;
+  std::vector<size_t> ArgMaxRows() const;
+  void ArgMaxRowsInto(std::vector<size_t>& result) const;
+
   // One-Hot Encoding
   static Matrix<T> OneHotEncode(const Matrix<T>& labels, size_t num_classes);
 
@@ -110,37 +221,36 @@ class [[nodiscard]] Matrix : Serializable {
   size_t Cols() const noexcept;
 
  private:
-  // Internal single-threaded matrix multiplication
-  Matrix SingleThreadedMatMul(const Matrix& other) const;
-
-  std::vector<T> data_;
+  // Copies and reductions are memory bound, they are split only when every
+  // thread streams a few hundred kilobytes
+  static constexpr uint64_t kMinBytesPerThread = uint64_t{256} << 10;
+  // Threads to split a pass over the given number of bytes across
+  static size_t MemoryBoundThreads(uint64_t bytes);
+  // Runs fn(row_begin, row_end) over all rows, split across
+  // MemoryBoundThreads(bytes) threads
+  template <typename Fn>
+  void ForRowRanges(uint64_t bytes, Fn&& fn) const;
+
+  // MultiplyInto with epilogue and operand masks (floating-point T only)
+  static void FusedMultiplyInto(MatrixView<T> lhs, Transpose transpose_lhs,
+                                MatrixView<T> rhs, Transpose transpose_rhs,
+                                const Gemm::OperandMasks<T>& masks,
+                                const Gemm::Epilogue<T>& epilogue,
+                                Matrix& result);
+
+  // Computes rows [row_begin, row_end) and columns [col_begin, col_end) of
+  // op(lhs) * op(rhs) into the same block of result with the plain algorithm
+  // used for integral types. Runs on the calling thread.
+  static void MultiplyBlock(MatrixView<T> lhs, Transpose transpose_lhs,
+                            MatrixView<T> rhs, Transpose transpose_rhs,
+                            Matrix& result, size_t row_begin, size_t row_end,
+                            size_t col_begin, size_t col_end);
+
+  Storage data_;
   size_t rows_;
   size_t cols_;
 };
 
-// Non-member Scalar Operations
-// Operator Overloading for mathematical operations is prohibited in Google style,
-// but since this is a pure mathematical construct, we will make an exception here.
-template <Numeric T>
-inline Matrix<T> operator*(Matrix<T> lhs, T rhs);
-template <Numeric T>
-inline Matrix<T> operator*(T lhs, Matrix<T> rhs);
-
-template <Numeric T>
-inline Matrix<T> operator/(Matrix<T> lhs, T rhs);
-template <Numeric T>
-inline Matrix<T> operator/(T lhs, Matrix<T> rhs);
-
-template <Numeric T>
-inline Matrix<T> operator+(Matrix<T> lhs, T rhs);
-template <Numeric T>
-inline Matrix<T> operator+(T lhs, Matrix<T> rhs);
-
-template <Numeric T>
-inline Matrix<T> operator-(Matrix<T> lhs, T rhs);
-template <Numeric T>
-inline Matrix<T> operator-(T lhs, Matrix<T> rhs);
-
 #include "matrix-inl.h"
 
 #endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_MATRIX_H_
@@ -0,0 +1,70 @@
+// MIT License
+
+// This file contains the evaluation of Matrix expressions.
+// It is meant to be included only inside matrix_expression.h.
+
+namespace Expr {
+
+namespace internal {
+
+// Evaluation body. Eval is inlined into the loop, so the compiler sees one
+// fused element-wise loop per expression type and vectorizes it for the
+// instruction set of the enclosing variant.
+template <typename StoreOp, typename E>
+NEURAL_ALWAYS_INLINE void EvaluateLoop(const E& expr,
+                                       typename E::ValueType* dst) {
+  const size_t rows = expr.Rows();
+  const size_t cols = expr.Cols();
+  for (size_t r = 0; r < rows; ++r) {
+    typename E::ValueType* row = dst + r * cols;
+    for (size_t c = 0; c < cols; ++c) {
+      StoreOp()(row[c], expr.Eval(r, c));
+    }
+  }
+}
+
+template <typename E>
+using EvaluateFn = void (*)(const E& expr, typename E::ValueType* dst);
+
+// Variants for each SIMD level (see cpu_features.h)
+template <typename StoreOp, typename E>
+void EvaluatePortable(const E& expr, typename E::ValueType* dst) {
+  EvaluateLoop<StoreOp>(expr, dst);
+}
+
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+template <typename StoreOp, typename E>
+NEURAL_TARGET_AVX2 void EvaluateAvx2(const E& expr,
+                                     typename E::ValueType* dst) {
+  EvaluateLoop<StoreOp>(expr, dst);
+}
+
+template <typename StoreOp, typename E>
+NEURAL_TARGET_AVX512 void EvaluateAvx512(const E& expr,
+                                         typename E::ValueType* dst) {
+  EvaluateLoop<StoreOp>(expr, dst);
+}
+#endif
+
+}  // namespace internal
+
+template <typename StoreOp, Expression E>
+void Evaluate(const E& expr, typename E::ValueType* dst) {
+  // Selected once per expression type on first use
+  static const internal::EvaluateFn<E> kEvaluate = [] {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+    switch (ActiveSimdLevel()) {
+      case SimdLevel::kAvx512:
+        return &internal::EvaluateAvx512<StoreOp, E>;
+      case SimdLevel::kAvx2:
+        return &internal::EvaluateAvx2<StoreOp, E>;
+      default:
+        break;
+    }
+#endif
+    return &internal::EvaluatePortable<StoreOp, E>;
+  }();
+  kEvaluate(expr, dst);
+}
+
+}  // namespace Expr
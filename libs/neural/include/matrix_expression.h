@@ -0,0 +1,294 @@
+// MIT License
+
+// Defines lazily evaluated element-wise Matrix expressions.
+// Element-wise operators (+, - between matrices, and +, -, *, / with a
+// scalar) and BroadcastRows do not compute anything by themselves. They
+// return small expression objects that record the operation, and the whole
+// chain is evaluated in a single loop when it is assigned to a Matrix or
+// applied with +=, -=. So `w -= g * lr` and `a + b - c` read every input
+// once and allocate nothing besides the destination.
+//
+// Expressions refer to lvalue operands, so an expression must not outlive
+// the matrices it was built from. Temporaries are moved into the
+// expression. Assign the result to a Matrix instead of keeping an `auto`
+// expression around.
+// It is meant to be included only inside matrix.h.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_MATRIX_EXPRESSION_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_MATRIX_EXPRESSION_H_
+
+#include <cstddef>
+
+#include <concepts>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include <absl/log/check.h>
+
+#include "cpu_features.h"
+
+namespace Expr {
+
+// A dense matrix operand (Matrix<T>).
+template <typename M>
+concept DenseMatrix = requires(const M& m, size_t r, size_t c) {
+  typename M::ValueType;
+  { m.Rows() } -> std::convertible_to<size_t>;
+  { m.Cols() } -> std::convertible_to<size_t>;
+  { m(r, c) } -> std::convertible_to<typename M::ValueType>;
+  m.ToVector();
+};
+
+// A lazily evaluated expression: Eval(r, c) computes one element.
+template <typename E>
+concept Expression = requires(const E& e, size_t r, size_t c) {
+  typename E::ValueType;
+  { e.Rows() } -> std::convertible_to<size_t>;
+  { e.Cols() } -> std::convertible_to<size_t>;
+  { e.Eval(r, c) } -> std::convertible_to<typename E::ValueType>;
+};
+
+// Anything the element-wise operators accept.
+template <typename X>
+concept Operand =
+    DenseMatrix<std::remove_cvref_t<X>> || Expression<std::remove_cvref_t<X>>;
+
+template <Operand X>
+using ValueTypeOf = typename std::remove_cvref_t<X>::ValueType;
+
+// Matrix nodes take a plain typename, Matrix names BroadcastRows<Matrix>
+// before it is complete. Wrap only creates them for DenseMatrix types.
+
+// Refers to an lvalue matrix.
+template <typename M>
+class Ref {
+ public:
+  using ValueType = typename M::ValueType;
+
+  explicit Ref(const M& matrix) : matrix_(&matrix) {}
+
+  size_t Rows() const noexcept { return matrix_->Rows(); }
+  size_t Cols() const noexcept { return matrix_->Cols(); }
+  NEURAL_ALWAYS_INLINE ValueType Eval(size_t r, size_t c) const {
+    return (*matrix_)(r, c);
+  }
+
+ private:
+  const M* matrix_;
+};
+
+// Owns a temporary matrix that was moved into the expression.
+template <typename M>
+class Owned {
+ public:
+  using ValueType = typename M::ValueType;
+
+  explicit Owned(M&& matrix) : matrix_(std::move(matrix)) {}
+
+  size_t Rows() const noexcept { return matrix_.Rows(); }
+  size_t Cols() const noexcept { return matrix_.Cols(); }
+  NEURAL_ALWAYS_INLINE ValueType Eval(size_t r, size_t c) const {
+    return matrix_(r, c);
+  }
+
+ private:
+  M matrix_;
+};
+
+// Repeats the rows of a matrix until it has `rows` rows
+// (see Matrix::BroadcastRows).
+template <typename M>
+class BroadcastRows {
+ public:
+  using ValueType = typename M::ValueType;
+
+  BroadcastRows(const M& matrix, size_t rows) : matrix_(&matrix), rows_(rows) {
+    CHECK(rows >= matrix.Rows() &&
+          "New row count must be greater than or equal to current rows.");
+  }
+
+  size_t Rows() const noexcept { return rows_; }
+  size_t Cols() const noexcept { return matrix_->Cols(); }
+  NEURAL_ALWAYS_INLINE ValueType Eval(size_t r, size_t c) const {
+    return (*matrix_)(r % matrix_->Rows(), c);
+  }
+
+ private:
+  const M* matrix_;
+  size_t rows_;
+};
+
+// Combines two expressions of the same shape element by element.
+template <typename Op, Expression L, Expression R>
+class Binary {
+ public:
+  using ValueType = typename L::ValueType;
+  static_assert(std::is_same_v<ValueType, typename R::ValueType>,
+                "Operands must have the same element type.");
+
+  Binary(L lhs, R rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {
+    CHECK(lhs_.Rows() == rhs_.Rows() && lhs_.Cols() == rhs_.Cols() &&
+          "Matrix dimensions must match for element-wise operations.");
+  }
+
+  size_t Rows() const noexcept { return lhs_.Rows(); }
+  size_t Cols() const noexcept { return lhs_.Cols(); }
+  NEURAL_ALWAYS_INLINE ValueType Eval(size_t r, size_t c) const {
+    return Op()(lhs_.Eval(r, c), rhs_.Eval(r, c));
+  }
+
+ private:
+  L lhs_;
+  R rhs_;
+};
+
+// Applies Op(element, scalar), or Op(scalar, element) if ScalarFirst.
+template <typename Op, Expression E, bool ScalarFirst>
+class WithScalar {
+ public:
+  using ValueType = typename E::ValueType;
+
+  WithScalar(E expr, ValueType scalar)
+      : expr_(std::move(expr)), scalar_(scalar) {}
+
+  size_t Rows() const noexcept { return expr_.Rows(); }
+  size_t Cols() const noexcept { return expr_.Cols(); }
+  NEURAL_ALWAYS_INLINE ValueType Eval(size_t r, size_t c) const {
+    if constexpr (ScalarFirst) {
+      return Op()(scalar_, expr_.Eval(r, c));
+    } else {
+      return Op()(expr_.Eval(r, c), scalar_);
+    }
+  }
+
+ private:
+  E expr_;
+  ValueType scalar_;
+};
+
+// Division that checks every divisor, used when the divisors are elements.
+struct CheckedDivides {
+  template <typename T>
+  T operator()(T lhs, T rhs) const {
+    CHECK(rhs != T(0) && "Division by zero is invalid.");
+    return lhs / rhs;
+  }
+};
+
+// Turns an operand into an expression node: lvalue matrices are referenced,
+// temporary matrices are moved in, expressions are copied or moved.
+template <Operand X>
+auto Wrap(X&& operand) {
+  using Type = std::remove_cvref_t<X>;
+  if constexpr (Expression<Type>) {
+    return Type(std::forward<X>(operand));
+  } else if constexpr (std::is_lvalue_reference_v<X>) {
+    return Ref<Type>(operand);
+  } else {
+    return Owned<Type>(std::move(operand));
+  }
+}
+
+template <Operand X>
+using NodeOf = decltype(Wrap(std::declval<X>()));
+
+// How an evaluated element is stored into the destination.
+struct Store {
+  template <typename T>
+  void operator()(T& dst, T value) const {
+    dst = value;
+  }
+};
+struct AddStore {
+  template <typename T>
+  void operator()(T& dst, T value) const {
+    dst += value;
+  }
+};
+struct SubtractStore {
+  template <typename T>
+  void operator()(T& dst, T value) const {
+    dst -= value;
+  }
+};
+
+// Evaluates expr into the row-major rows x cols buffer dst (the shape of
+// expr) in a single pass, combining each element with StoreOp. The loop is
+// compiled for every SIMD level and dispatched at runtime.
+// dst may be one of the operands: every element only reads the same
+// position of its operands.
+template <typename StoreOp, Expression E>
+void Evaluate(const E& expr, typename E::ValueType* dst);
+
+}  // namespace Expr
+
+// Element-wise operators
+// Operator Overloading for mathematical operations is prohibited in Google
+// style, but since this is a pure mathematical construct, we will make an
+// exception here.
+template <Expr::Operand L, Expr::Operand R>
+auto operator+(L&& lhs, R&& rhs) {
+  return Expr::Binary<std::plus<>, Expr::NodeOf<L>, Expr::NodeOf<R>>(
+      Expr::Wrap(std::forward<L>(lhs)), Expr::Wrap(std::forward<R>(rhs)));
+}
+
+template <Expr::Operand L, Expr::Operand R>
+auto operator-(L&& lhs, R&& rhs) {
+  return Expr::Binary<std::minus<>, Expr::NodeOf<L>, Expr::NodeOf<R>>(
+      Expr::Wrap(std::forward<L>(lhs)), Expr::Wrap(std::forward<R>(rhs)));
+}
+
+// Scalar operations
+template <Expr::Operand X>
+auto operator*(X&& lhs, Expr::ValueTypeOf<X> rhs) {
+  return Expr::WithScalar<std::multiplies<>, Expr::NodeOf<X>, false>(
+      Expr::Wrap(std::forward<X>(lhs)), rhs);
+}
+
+template <Expr::Operand X>
+auto operator*(Expr::ValueTypeOf<X> lhs, X&& rhs) {
+  return Expr::WithScalar<std::multiplies<>, Expr::NodeOf<X>, true>(
+      Expr::Wrap(std::forward<X>(rhs)), lhs);
+}
+
+template <Expr::Operand X>
+auto operator/(X&& lhs, Expr::ValueTypeOf<X> rhs) {
+  CHECK(rhs != Expr::ValueTypeOf<X>(0) && "Division by zero is invalid.");
+  return Expr::WithScalar<std::divides<>, Expr::NodeOf<X>, false>(
+      Expr::Wrap(std::forward<X>(lhs)), rhs);
+}
+
+template <Expr::Operand X>
+auto operator/(Expr::ValueTypeOf<X> lhs, X&& rhs) {
+  return Expr::WithScalar<Expr::CheckedDivides, Expr::NodeOf<X>, true>(
+      Expr::Wrap(std::forward<X>(rhs)), lhs);
+}
+
+template <Expr::Operand X>
+auto operator+(X&& lhs, Expr::ValueTypeOf<X> rhs) {
+  return Expr::WithScalar<std::plus<>, Expr::NodeOf<X>, false>(
+      Expr::Wrap(std::forward<X>(lhs)), rhs);
+}
+
+template <Expr::Operand X>
+auto operator+(Expr::ValueTypeOf<X> lhs, X&& rhs) {
+  return Expr::WithScalar<std::plus<>, Expr::NodeOf<X>, true>(
+      Expr::Wrap(std::forward<X>(rhs)), lhs);
+}
+
+template <Expr::Operand X>
+auto operator-(X&& lhs, Expr::ValueTypeOf<X> rhs) {
+  return Expr::WithScalar<std::minus<>, Expr::NodeOf<X>, false>(
+      Expr::Wrap(std::forward<X>(lhs)), rhs);
+}
+
+template <Expr::Operand X>
+auto operator-(Expr::ValueTypeOf<X> lhs, X&& rhs) {
+  return Expr::WithScalar<std::minus<>, Expr::NodeOf<X>, true>(
+      Expr::Wrap(std::forward<X>(rhs)), lhs);
+}
+
+#include "matrix_expression-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_MATRIX_EXPRESSION_H_
@@ -0,0 +1,83 @@
+// MIT License
+
+// Defines MatrixView, a non-owning view of a row-major matrix.
+// The rows of a view are row_stride elements apart in memory, so any range
+// of rows of a Matrix (such as a minibatch of a shuffled dataset) is a view
+// without copying anything. Views are cheap to copy and are passed by value.
+// A view does not keep its data alive: it must not outlive the matrix it
+// refers to, and resizing that matrix invalidates it.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_MATRIX_VIEW_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_MATRIX_VIEW_H_
+
+#include <cstddef>
+
+#include <concepts>
+#include <functional>
+
+#include <absl/log/check.h>
+
+#include "common_types.h"
+#include "matrix_expression.h"
+
+template <Numeric T>
+class MatrixView {
+ public:
+  using ValueType = T;
+
+  MatrixView() = default;
+  MatrixView(const T* data, size_t rows, size_t cols, size_t row_stride)
+      : data_(data), rows_(rows), cols_(cols), row_stride_(row_stride) {
+    CHECK((rows <= 1 || row_stride >= cols) &&
+          "Rows of a view must not overlap.");
+  }
+  // Views a whole matrix. Implicit, so that a Matrix can be passed wherever
+  // a view is expected.
+  template <Expr::DenseMatrix M>
+    requires std::same_as<typename M::ValueType, T>
+  MatrixView(const M& matrix)
+      : MatrixView(matrix.ToVector().data(), matrix.Rows(), matrix.Cols(),
+                   matrix.Cols()) {}
+
+  size_t Rows() const noexcept { return rows_; }
+  size_t Cols() const noexcept { return cols_; }
+  // Distance between the starts of consecutive rows, in elements
+  size_t RowStride() const noexcept { return row_stride_; }
+  const T* Data() const noexcept { return data_; }
+
+  const T& operator()(size_t row, size_t col) const noexcept {
+    return data_[row * row_stride_ + col];
+  }
+
+  // Rows [begin, end) of this view
+  MatrixView RowRange(size_t begin, size_t end) const {
+    CHECK(begin <= end && end <= rows_ && "Row range out of bounds.");
+    return MatrixView(data_ + begin * row_stride_, end - begin, cols_,
+                      row_stride_);
+  }
+
+  // Whether the elements of the view may share memory with
+  // [begin, begin + size)
+  bool Overlaps(const T* begin, size_t size) const noexcept {
+    if (rows_ == 0 || cols_ == 0 || size == 0)
+      return false;
+    // std::less gives a total order even across unrelated buffers
+    const T* end = data_ + (rows_ - 1) * row_stride_ + cols_;
+    std::less<const T*> less;
+    return less(data_, begin + size) && less(begin, end);
+  }
+
+  // A view is also an expression (see matrix_expression.h), so
+  // `Matrix<T> copy = view;` or `out += view * 2` evaluate it in one pass.
+  NEURAL_ALWAYS_INLINE T Eval(size_t row, size_t col) const {
+    return (*this)(row, col);
+  }
+
+ private:
+  const T* data_ = nullptr;
+  size_t rows_ = 0;
+  size_t cols_ = 0;
+  size_t row_stride_ = 0;
+};
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_MATRIX_VIEW_H_
@@ -4,10 +4,14 @@
 #define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_NEURAL_LAYER_H_
 
 #include <concepts>
+#include <memory>
+#include <span>
+#include <vector>
 
 #include "matrix.h"
 #include "serializable.h"
 #include "layer_type.h"
+#include "workspace_plan.h"
 
 // Interface for neural network layers.
 // Each layer must implement Forward, Backward, and UpdateWeights methods.
@@ -20,8 +24,32 @@ class NeuralLayer : public Serializable {
   virtual ~NeuralLayer() = default;
 
   virtual LayerType Type() const = 0;
-  virtual MatrixType Forward(const MatrixType& input) = 0;
-  virtual MatrixType Backward(const MatrixType& grad_output) = 0;
+  // Forward and Backward return a buffer owned by the layer, valid until the
+  // next call of the same method. The buffers keep their storage between
+  // calls, so steady-state training steps do not allocate.
+  // Forward takes a view, so a row range of a larger matrix (a minibatch)
+  // goes through without being copied.
+  virtual const MatrixType& Forward(MatrixView<Fp> input) = 0;
+  virtual const MatrixType& Backward(const MatrixType& grad_output) = 0;
+  // Computes the same output as Forward into output (resized to fit) without
+  // recording anything for Backward, so the layer's training state is left
+  // as it was. output must not share storage with input.
+  virtual void Infer(MatrixView<Fp> input, MatrixType& output) const = 0;
+  // Reserves the buffers of Forward and Backward for inputs of up to
+  // max_rows rows of input_cols columns, appends them to buffers (with the
+  // layer index left to the caller) and returns the output columns.
+  virtual size_t ReserveWorkspace(size_t max_rows, size_t input_cols,
+                                  std::vector<WorkspaceBuffer>& buffers) = 0;
+  // Gradients of the parameters computed by the last Backward, which
+  // UpdateWeights applies. Empty for layers without parameters.
+  virtual std::span<Fp> Gradients() = 0;
+  // Returns a new layer with the same parameters and hyperparameters and
+  // empty training buffers (e.g. a replica for data-parallel training).
+  virtual std::unique_ptr<NeuralLayer> Clone() const = 0;
+  // Returns a new layer with its own training buffers that reads and
+  // updates the parameters of this layer in place, for asynchronous
+  // training. This layer must outlive the clone.
+  virtual std::unique_ptr<NeuralLayer> CloneSharingParameters() = 0;
   // Update the layer's weights based on the internal learning rate and gradients.
   virtual void UpdateWeights() = 0;
 };
@@ -3,10 +3,19 @@
 // This file contains the implementation of the NeuralNetwork class template.
 // It is meant to be included only inside neural_network.h.
 
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
 #include <absl/log/check.h>
 #include <absl/log/log.h>
+#include <absl/strings/str_cat.h>
 
+#include "batch_prefetcher.h"
 #include "loss.h"
+#include "simd_kernels.h"
+#include "thread_pool.h"
 
 template <std::floating_point Fp>
 void NeuralNetwork<Fp>::AddLayer(std::unique_ptr<NeuralLayer<Fp>> layer) {
@@ -14,23 +23,82 @@ void NeuralNetwork<Fp>::AddLayer(std::unique_ptr<NeuralLayer<Fp>> layer) {
 }
 
 template <std::floating_point Fp>
-typename NeuralNetwork<Fp>::MatType NeuralNetwork<Fp>::Forward(
+const typename NeuralNetwork<Fp>::MatType& NeuralNetwork<Fp>::Forward(
     const MatType& input) {
-  MatType output = input;
-  for (const auto& layer : layers_) {
-    output = layer->Forward(output);
+  if (layers_.empty())
+    return input;
+  return Forward(MatrixView<Fp>(input));
+}
+
+template <std::floating_point Fp>
+const typename NeuralNetwork<Fp>::MatType& NeuralNetwork<Fp>::Forward(
+    MatrixView<Fp> input) {
+  CHECK(!layers_.empty()) << "Network has no layers.";
+  const MatType* output = nullptr;
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    MatrixView<Fp> layer_input =
+        output != nullptr ? MatrixView<Fp>(*output) : input;
+    if (FusesLinearReLU(i)) {
+      auto& linear = static_cast<LinearLayer<Fp>&>(*layers_[i]);
+      auto& relu = static_cast<ReLULayer<Fp>&>(*layers_[i + 1]);
+      output = &relu.ForwardFused(linear.ForwardReLU(layer_input));
+      ++i;
+    } else {
+      output = &layers_[i]->Forward(layer_input);
+    }
   }
-  return output;
+  return *output;
 }
 
 template <std::floating_point Fp>
-typename NeuralNetwork<Fp>::MatType NeuralNetwork<Fp>::Backward(
+const typename NeuralNetwork<Fp>::MatType& NeuralNetwork<Fp>::Backward(
     const MatType& grad_output) {
-  MatType grad = grad_output;
-  for (auto it = layers_.rbegin(); it != layers_.rend(); ++it) {
-    grad = (*it)->Backward(grad);
+  const MatType* grad = &grad_output;
+  for (size_t i = layers_.size(); i-- > 0;) {
+    if (i > 0 && FusesLinearReLU(i - 1)) {
+      auto& linear = static_cast<LinearLayer<Fp>&>(*layers_[i - 1]);
+      grad = &linear.BackwardReLU(*grad);
+      --i;
+    } else {
+      grad = &layers_[i]->Backward(*grad);
+    }
   }
-  return grad;
+  return *grad;
+}
+
+template <std::floating_point Fp>
+const typename NeuralNetwork<Fp>::MatType& NeuralNetwork<Fp>::Infer(
+    MatrixView<Fp> input) {
+  return InferInto(input, infer_buffers_);
+}
+
+template <std::floating_point Fp>
+const typename NeuralNetwork<Fp>::MatType& NeuralNetwork<Fp>::InferInto(
+    MatrixView<Fp> input, MatType (&buffers)[2]) const {
+  CHECK(!layers_.empty()) << "Network has no layers.";
+  const MatType* output = nullptr;
+  size_t next = 0;
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    MatrixView<Fp> layer_input =
+        output != nullptr ? MatrixView<Fp>(*output) : input;
+    MatType& layer_output = buffers[next];
+    if (FusesLinearReLU(i)) {
+      static_cast<const LinearLayer<Fp>&>(*layers_[i])
+          .InferReLU(layer_input, layer_output);
+      ++i;
+    } else {
+      layers_[i]->Infer(layer_input, layer_output);
+    }
+    output = &layer_output;
+    next ^= 1;
+  }
+  return *output;
+}
+
+template <std::floating_point Fp>
+bool NeuralNetwork<Fp>::FusesLinearReLU(size_t i) const {
+  return i + 1 < layers_.size() && layers_[i]->Type() == LayerType::kLinear &&
+         layers_[i + 1]->Type() == LayerType::kReLU;
 }
 
 template <std::floating_point Fp>
@@ -41,103 +109,149 @@ void NeuralNetwork<Fp>::UpdateWeights() {
 }
 
 template <std::floating_point Fp>
-void NeuralNetwork<Fp>::Train(const MatType& raw_train_data,
-                              const MatType& raw_train_labels,
-                              const MatType& raw_test_data,
-                              const MatType& raw_test_labels, uint32_t epochs,
-                              uint32_t batch_size, EpochCallback on_epoch_end) {
-  CHECK(raw_train_data.Rows() == raw_train_labels.Rows())
-      << "Number of samples in data and labels must be the same.";
-
-  const size_t kNumSamples = raw_train_data.Rows();
-  const size_t kNumBatches =
-      (kNumSamples + batch_size - 1) / batch_size;  // Ceiling division
-
-  const size_t num_features = raw_train_data.Cols();
-  const size_t num_classes = raw_train_labels.Cols();
+WorkspacePlan NeuralNetwork<Fp>::PlanWorkspace(size_t max_batch_size,
+                                               size_t input_cols) {
+  CHECK(!layers_.empty()) << "Network has no layers.";
+  WorkspacePlan plan;
+  plan.max_batch_size = max_batch_size;
+  auto add = [&](const char* name, const MatType& buffer) {
+    plan.buffers.push_back(
+        {.name = name, .bytes = buffer.ToVector().capacity() * sizeof(Fp)});
+  };
 
-  for (uint32_t epoch = 0; epoch < epochs; ++epoch) {
-    Fp epoch_loss = Fp(0);
+  // Layers in the order of Forward, a fused ReLU uses the buffers of its
+  // Linear layer
+  size_t cols = input_cols;
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    const size_t first = plan.buffers.size();
+    cols = layers_[i]->ReserveWorkspace(max_batch_size, cols, plan.buffers);
+    for (size_t b = first; b < plan.buffers.size(); ++b) {
+      plan.buffers[b].layer = i;
+    }
+    if (FusesLinearReLU(i))
+      ++i;
+  }
+  // The loss gradient has the shape of the output
+  loss_grad_.Reserve(max_batch_size, cols);
+  add("loss_grad", loss_grad_);
+  return plan;
+}
 
-    // Shuffle data and labels at the start of each epoch
-    MatType shuffled_data = raw_train_data.ShuffleRows(epoch + 42);
-    MatType shuffled_labels = raw_train_labels.ShuffleRows(epoch + 42);
-
-    // Iterate over each batch
-    for (size_t batch_idx = 0; batch_idx < kNumBatches; ++batch_idx) {
-      // Determine batch start and end indices
-      size_t start_idx = batch_idx * batch_size;
-      size_t end_idx = std::min(start_idx + batch_size, kNumSamples);
-      size_t current_batch_size = end_idx - start_idx;
-
-      // Create batch matrices
-      MatType data_batch(current_batch_size, num_features);
-      MatType labels_batch(current_batch_size, num_classes);
-
-      // Copy data into the batch matrices
-      for (size_t i = 0; i < current_batch_size; ++i) {
-        size_t data_idx = start_idx + i;
-        for (size_t j = 0; j < num_features; ++j) {
-          data_batch(i, j) = shuffled_data(data_idx, j);
-        }
-        for (size_t j = 0; j < num_classes; ++j) {
-          labels_batch(i, j) = shuffled_labels(data_idx, j);
-        }
-      }
+template <std::floating_point Fp>
+Fp NeuralNetwork<Fp>::ComputeGradients(MatrixView<Fp> data_batch,
+                                       MatrixView<Fp> labels_batch) {
+  // Forward pass
+  const MatType& predictions = Forward(data_batch);
 
-      // Forward pass
-      MatType predictions = Forward(data_batch);
+  // Compute loss and its gradient in one pass. The gradient does not
+  // overwrite the predictions, a fused Linear + ReLU at the end of the
+  // network still needs them for its backward pass.
+  Fp loss = Loss::SoftmaxCrossEntropyWithGradient<Fp>(
+      predictions, labels_batch, loss_grad_);
 
-      // Compute loss and its gradient
-      Fp loss = Loss::SoftmaxCrossEntropy<Fp>(predictions, labels_batch);
-      MatType loss_grad =
-          Loss::SoftmaxCrossEntropyGradient<Fp>(predictions, labels_batch);
-      epoch_loss += loss;
+  // Backward pass
+  (void)Backward(loss_grad_);
+  return loss;
+}
 
-      // Backward pass and weight update
-      (void)Backward(loss_grad);
-      UpdateWeights();
+template <std::floating_point Fp>
+Fp NeuralNetwork<Fp>::TrainStep(MatrixView<Fp> data_batch,
+                                MatrixView<Fp> labels_batch) {
+  Fp loss = ComputeGradients(data_batch, labels_batch);
+  UpdateWeights();
+  return loss;
+}
 
-      // Log progress every N batches
-      if (batch_idx % 500 == 0) {
-        LOG(INFO) << "Epoch [" << epoch + 1 << "/" << epochs << "], Batch ["
-                  << batch_idx + 1 << "/" << kNumBatches << "], Loss: " << loss;
-      }
-    }  // End of batch loop
+template <std::floating_point Fp>
+template <Numeric T>
+void NeuralNetwork<Fp>::Train(const Matrix<T>& raw_train_data,
+                              const MatType& raw_train_labels,
+                              const Matrix<T>& raw_test_data,
+                              const MatType& raw_test_labels, uint32_t epochs,
+                              uint32_t batch_size, EpochCallback on_epoch_end,
+                              Fp input_scale) {
+  CHECK(raw_train_data.Rows() == raw_train_labels.Rows())
+      << "Number of samples in data and labels must be the same.";
 
-    float train_accuracy = EvaluateAccuracy(raw_train_data, raw_train_labels);
-    float test_accuracy = EvaluateAccuracy(raw_test_data, raw_test_labels);
+  // Size every buffer for the largest batch before the first step
+  const WorkspacePlan plan = PlanWorkspace(
+      std::min<size_t>(batch_size, raw_train_data.Rows()),
+      raw_train_data.Cols());
+  LOG(INFO) << "Training workspace: " << plan.buffers.size()
+            << " buffers, " << plan.TotalBytes() / 1024 << " KiB";
 
-    LOG(INFO) << "Epoch [" << epoch + 1 << "/" << epochs << "] completed."
-              << "\nAverage Loss: " << (epoch_loss / kNumBatches)
-              << "\nTraining Accuracy: " << train_accuracy * 100.0f << "%"
-              << "\nTesting Accuracy: " << test_accuracy * 100.0f << "%";
+  Training::RunBatchEpochs(
+      *this, raw_train_data, raw_train_labels, raw_test_data, raw_test_labels,
+      epochs, batch_size, "", on_epoch_end, input_scale,
+      [this](MatrixView<Fp> data_batch, MatrixView<Fp> labels_batch) {
+        return TrainStep(data_batch, labels_batch);
+      });
+}
 
-    // If the user provided a callback, fire it
-    // on_epoch_end defaults to nullptr if the user didn't provide anything
-    if (on_epoch_end)
-        on_epoch_end(epoch, test_accuracy);
+// Evaluate the network on the provided dataset.
+template <std::floating_point Fp>
+template <Numeric T>
+ConfusionMatrix NeuralNetwork<Fp>::Evaluate(const Matrix<T>& data,
+                                            const MatType& labels,
+                                            Fp input_scale) const {
+  CHECK(data.Rows() == labels.Rows())
+      << "Number of samples in data and labels must be the same.";
+  CHECK(labels.Cols() > 0) << "Labels must have at least one class.";
+  const size_t num_classes = labels.Cols();
+  const size_t num_chunks =
+      (data.Rows() + kEvaluationChunkRows - 1) / kEvaluationChunkRows;
 
-  } // End of epoch loop
+  ConfusionMatrix confusion(num_classes);
+  std::mutex confusion_mutex;
+  auto evaluate_chunks = [&](size_t begin, size_t end) {
+    // Every task streams its chunks through its own two buffers, and its
+    // own conversion buffer unless the data can be read as it is
+    MatType buffers[2];
+    MatType converted;
+    auto chunk_input = [&](size_t first, size_t rows) -> MatrixView<Fp> {
+      if constexpr (std::same_as<T, Fp>) {
+        if (input_scale == Fp(1))
+          return data.RowRange(first, first + rows);
+      }
+      converted.Resize(rows, data.Cols());
+      Simd::ConvertKernel<T, Fp>()(
+          data.ToVector().data() + first * data.Cols(),
+          converted.ToVector().data(), input_scale, rows * data.Cols());
+      return converted;
+    };
+    std::vector<size_t> predicted(kEvaluationChunkRows);
+    std::vector<size_t> expected(kEvaluationChunkRows);
+    ConfusionMatrix partial(num_classes);
+    const Simd::ReductionKernels<Fp>& kernels = Simd::Reductions<Fp>();
+    for (size_t chunk = begin; chunk < end; ++chunk) {
+      const size_t first = chunk * kEvaluationChunkRows;
+      const size_t rows =
+          std::min(kEvaluationChunkRows, data.Rows() - first);
+      const MatType& logits = InferInto(chunk_input(first, rows), buffers);
+      CHECK(logits.Cols() == num_classes)
+          << "Network outputs must match the label classes.";
+      // The largest logit is the most probable class
+      kernels.row_max(logits.ToVector().data(), rows, num_classes, nullptr,
+                      predicted.data());
+      kernels.row_max(labels.ToVector().data() + first * num_classes, rows,
+                      num_classes, nullptr, expected.data());
+      for (size_t r = 0; r < rows; ++r) {
+        partial.Add(expected[r], predicted[r]);
+      }
+    }
+    std::lock_guard<std::mutex> lock(confusion_mutex);
+    confusion.Merge(partial);
+  };
+  ThreadPool::Global().ParallelFor(0, num_chunks, 1, evaluate_chunks);
+  return confusion;
 }
 
-// Evaluate the accuracy of the network on the provided dataset.
 template <std::floating_point Fp>
-float NeuralNetwork<Fp>::EvaluateAccuracy(const MatType& data,
-                                          const MatType& labels) {
-  // Get predictions from the network
-  MatType predictions = Loss::Softmax(Forward(data));
-  size_t correct = 0;
-  size_t samples = predictions.Rows();
-  // Compare predicted labels with true labels for each sample
-  for (size_t i = 0; i < samples; ++i) {
-    size_t predicted_label = predictions.ArgMaxRow(i);
-    size_t true_label = labels.ArgMaxRow(i);
-    if (predicted_label == true_label) {
-      ++correct;
-    }
-  }
-  return static_cast<float>(correct) / static_cast<float>(samples);
+template <Numeric T>
+float NeuralNetwork<Fp>::EvaluateAccuracy(const Matrix<T>& data,
+                                          const MatType& labels,
+                                          Fp input_scale) const {
+  return Evaluate(data, labels, input_scale).Accuracy();
 }
 
 // Serialization
@@ -174,3 +288,89 @@ template <std::floating_point Fp>
 void NeuralNetwork<Fp>::Clear() {
   layers_.clear();
 }
+
+namespace Training {
+
+template <std::floating_point Fp, Numeric T, typename EpochFn>
+void RunEpochs(const NeuralNetwork<Fp>& network, const Matrix<T>& train_data,
+               const Matrix<Fp>& train_labels, const Matrix<T>& test_data,
+               const Matrix<Fp>& test_labels, uint32_t epochs,
+               uint32_t batch_size, const std::string& trainer,
+               const typename NeuralNetwork<Fp>::EpochCallback& on_epoch_end,
+               Fp input_scale, EpochFn&& run_epoch) {
+  CHECK(train_data.Rows() == train_labels.Rows())
+      << "Number of samples in data and labels must be the same.";
+
+  BatchSampler sampler(train_data.Rows(), batch_size);
+  for (uint32_t epoch = 0; epoch < epochs; ++epoch) {
+    // Shuffle the sample order at the start of each epoch, the data itself
+    // is not copied
+    sampler.Shuffle(epoch + 42);
+    const EpochSummary<Fp> summary = run_epoch(epoch, std::as_const(sampler));
+
+    float train_accuracy =
+        network.EvaluateAccuracy(train_data, train_labels, input_scale);
+    float test_accuracy =
+        network.EvaluateAccuracy(test_data, test_labels, input_scale);
+
+    LOG(INFO) << "Epoch [" << epoch + 1 << "/" << epochs << "] completed"
+              << (trainer.empty() ? "" : " (" + trainer + ")") << "."
+              << "\nAverage Loss: " << summary.loss << summary.details
+              << "\nTraining Accuracy: " << train_accuracy * 100.0f << "%"
+              << "\nTesting Accuracy: " << test_accuracy * 100.0f << "%";
+
+    // If the user provided a callback, fire it
+    // on_epoch_end defaults to nullptr if the user didn't provide anything
+    if (on_epoch_end)
+      on_epoch_end(epoch, test_accuracy);
+  }
+}
+
+template <std::floating_point Fp, Numeric T, typename StepFn>
+void RunBatchEpochs(
+    const NeuralNetwork<Fp>& network, const Matrix<T>& train_data,
+    const Matrix<Fp>& train_labels, const Matrix<T>& test_data,
+    const Matrix<Fp>& test_labels, uint32_t epochs, uint32_t batch_size,
+    const std::string& trainer,
+    const typename NeuralNetwork<Fp>::EpochCallback& on_epoch_end,
+    Fp input_scale, StepFn&& step) {
+  // Every epoch is consumed before run_epoch returns, so the producer is
+  // idle by the time the sampler of RunEpochs, which it reads, goes away
+  BatchPrefetcher<Fp> prefetcher;
+  prefetcher.Reserve(std::min<size_t>(batch_size, train_data.Rows()),
+                     train_data.Cols(), train_labels.Cols());
+
+  auto run_epoch = [&](uint32_t epoch, const BatchSampler& sampler) {
+    const size_t num_batches = sampler.NumBatches();
+    // Gather (and convert) the batch rows ahead on the producer thread, the
+    // batch storage is reused between batches
+    prefetcher.Start(num_batches, [&](size_t batch, Matrix<Fp>& data_buffer,
+                                      Matrix<Fp>& labels_buffer) {
+      sampler.Gather(batch, train_data, data_buffer, input_scale);
+      sampler.Gather(batch, train_labels, labels_buffer);
+    });
+
+    Fp epoch_loss = Fp(0);
+    for (size_t batch_idx = 0; batch_idx < num_batches; ++batch_idx) {
+      const auto& batch = prefetcher.Next();
+      Fp loss = step(batch.data, batch.labels);
+      epoch_loss += loss;
+
+      if (batch_idx % kLogInterval == 0) {
+        LOG(INFO) << "Epoch [" << epoch + 1 << "/" << epochs << "], Batch ["
+                  << batch_idx + 1 << "/" << num_batches << "], Loss: " << loss;
+      }
+    }
+
+    const PrefetchStats input = prefetcher.Stats();
+    return EpochSummary<Fp>{
+        epoch_loss / static_cast<Fp>(num_batches),
+        absl::StrCat("\nInput Stalls: ", input.stalls, " (",
+                     input.stall_seconds * 1000.0, " ms), mean queue depth ",
+                     input.MeanQueueDepth())};
+  };
+  RunEpochs(network, train_data, train_labels, test_data, test_labels, epochs,
+            batch_size, trainer, on_epoch_end, input_scale, run_epoch);
+}
+
+}  // namespace Training
@@ -5,14 +5,20 @@
 
 #include <concepts>
 #include <memory>
+#include <string>
 #include <vector>
 #include <functional>
 
 #include <absl/status/status.h>
 
+#include "batch_sampler.h"
+#include "confusion_matrix.h"
 #include "matrix.h"
 #include "neural_layer.h"
 #include "layer_type.h"
+#include "linear_layer.h"
+#include "relu_layer.h"
+#include "workspace_plan.h"
 
 // Network class managing multiple neural layers (NeuralLayer<Fp> instances).
 template <std::floating_point Fp>
@@ -23,6 +29,9 @@ class NeuralNetwork {
   using Layers = std::vector<std::unique_ptr<NeuralLayer<Fp>>>;
   using EpochCallback = std::function<void(uint32_t, float)>;
 
+  // Rows per chunk of Evaluate
+  static constexpr size_t kEvaluationChunkRows = 256;
+
   // Default constructor and destructor
   NeuralNetwork() = default;
   ~NeuralNetwork() = default;
@@ -36,13 +45,63 @@ class NeuralNetwork {
   NeuralNetwork& operator=(NeuralNetwork&&) noexcept = default;
 
   void AddLayer(std::unique_ptr<NetworkLayer> layer);
-  MatType Forward(const MatType& input);
-  MatType Backward(const MatType& grad_output);
+  // Return the output of the last layer (the input if there are no layers),
+  // valid until the next call.
+  const MatType& Forward(const MatType& input);
+  // Same for a view (e.g. a row range of a dataset), which is not copied.
+  // Requires at least one layer.
+  // A Linear layer followed by a ReLU layer runs as one fused product with
+  // bias and activation (see LinearLayer::ForwardReLU), and Backward runs
+  // the pair as one fused step (LinearLayer::BackwardReLU).
+  const MatType& Forward(MatrixView<Fp> input);
+  const MatType& Backward(const MatType& grad_output);
+  // Inference-only forward pass: returns the same output as Forward, valid
+  // until the next call, but records nothing for Backward, so layers copy
+  // no inputs and keep no masks, and a pending Backward is not disturbed.
+  // Activations alternate between two buffers owned by the network, which
+  // keep their storage between calls.
+  // Requires at least one layer.
+  const MatType& Infer(MatrixView<Fp> input);
   void UpdateWeights();
-  void Train(const MatType& raw_train_data, const MatType& raw_train_labels,
-             const MatType& raw_test_data, const MatType& raw_test_labels,
-             uint32_t epochs, uint32_t batch_size, EpochCallback on_epoch_end = nullptr);
-  float EvaluateAccuracy(const MatType& data, const MatType& labels);
+  // Reserves every buffer of Forward, Backward and TrainStep (activations,
+  // gradients and ReLU masks) for batches of up to max_batch_size rows of
+  // input_cols features, and returns the size of each. Steps on such
+  // batches then never grow a buffer, in whatever order the batch sizes
+  // come. Train plans itself for its batch size.
+  // Requires at least one layer.
+  WorkspacePlan PlanWorkspace(size_t max_batch_size, size_t input_cols);
+  // Runs forward and backward on one batch, leaving the parameter gradients
+  // in the layers for UpdateWeights, and returns its loss.
+  Fp ComputeGradients(MatrixView<Fp> data_batch, MatrixView<Fp> labels_batch);
+  // Runs forward, backward and the weight update on one batch and returns
+  // its loss. Once the buffers have grown to the batch shape (or have been
+  // planned for it, see PlanWorkspace), steps make no heap allocations.
+  Fp TrainStep(MatrixView<Fp> data_batch, MatrixView<Fp> labels_batch);
+  // Trains for the epochs on shuffled batches (Training::RunBatchEpochs).
+  // The batches are built by a BatchPrefetcher while the previous ones
+  // train, the input stalls and the mean queue depth of every epoch are
+  // logged.
+  // The inputs may stay in a narrower type than Fp, e.g. raw uint8_t
+  // pixels: every batch and evaluation chunk is converted and multiplied by
+  // input_scale as it is gathered, the dataset is never widened as a whole.
+  template <Numeric T>
+  void Train(const Matrix<T>& raw_train_data, const MatType& raw_train_labels,
+             const Matrix<T>& raw_test_data, const MatType& raw_test_labels,
+             uint32_t epochs, uint32_t batch_size,
+             EpochCallback on_epoch_end = nullptr, Fp input_scale = Fp(1));
+  // Classifies every row of data (times input_scale, converted as for
+  // Train) and counts the results against the one-hot labels. The rows are
+  // streamed through Infer in chunks of kEvaluationChunkRows spread across
+  // the thread pool, so evaluation memory does not grow with the dataset.
+  // The predicted class is the argmax of the logits (Softmax does not
+  // change it).
+  template <Numeric T>
+  ConfusionMatrix Evaluate(const Matrix<T>& data, const MatType& labels,
+                           Fp input_scale = Fp(1)) const;
+  // Evaluate(data, labels, input_scale).Accuracy()
+  template <Numeric T>
+  float EvaluateAccuracy(const Matrix<T>& data, const MatType& labels,
+                         Fp input_scale = Fp(1)) const;
 
   // Serialization
   // NOTE: This method is intended to be used by the `ModelSerializer` class.
@@ -57,9 +116,66 @@ class NeuralNetwork {
   void Clear();
 
  private:
+  // Whether layers i and i + 1 are a Linear and a ReLU layer, which run fused
+  bool FusesLinearReLU(size_t i) const;
+  // Infer, alternating activations between the two buffers
+  const MatType& InferInto(MatrixView<Fp> input, MatType (&buffers)[2]) const;
+
   std::vector<std::unique_ptr<NetworkLayer>> layers_;
+  // Reused across training steps
+  MatType loss_grad_;
+  // Ping-pong activation buffers of Infer
+  MatType infer_buffers_[2];
+};
+
+// The epoch loop shared by NeuralNetwork::Train and the trainers
+// (DataParallelTrainer, HogwildTrainer), which differ only in how an epoch
+// trains on its batches.
+namespace Training {
+
+// What a trainer reports about one epoch.
+template <std::floating_point Fp>
+struct EpochSummary {
+  // Mean batch loss
+  Fp loss = Fp(0);
+  // Lines appended to the epoch log, e.g. the input stalls or throughput
+  std::string details;
 };
 
+// Runs the epochs over batches of up to batch_size rows of the training
+// data, reshuffled at the start of every epoch with a seed fixed per epoch.
+// run_epoch(epoch, sampler) trains on every batch of the sampler and
+// returns an EpochSummary<Fp>. Then network, which run_epoch updates, is
+// evaluated on the training and test data (times input_scale, see
+// NeuralNetwork::Train), the epoch is logged under the name of the trainer
+// (none if empty) and on_epoch_end gets the test accuracy.
+template <std::floating_point Fp, Numeric T, typename EpochFn>
+void RunEpochs(const NeuralNetwork<Fp>& network, const Matrix<T>& train_data,
+               const Matrix<Fp>& train_labels, const Matrix<T>& test_data,
+               const Matrix<Fp>& test_labels, uint32_t epochs,
+               uint32_t batch_size, const std::string& trainer,
+               const typename NeuralNetwork<Fp>::EpochCallback& on_epoch_end,
+               Fp input_scale, EpochFn&& run_epoch);
+
+// RunEpochs training on the batches in order with step(data_batch,
+// labels_batch), which returns the batch loss. A BatchPrefetcher gathers
+// and converts the batches ahead of the step. Logs the loss every
+// kLogInterval batches, and the input stalls and the mean queue depth of
+// every epoch.
+template <std::floating_point Fp, Numeric T, typename StepFn>
+void RunBatchEpochs(
+    const NeuralNetwork<Fp>& network, const Matrix<T>& train_data,
+    const Matrix<Fp>& train_labels, const Matrix<T>& test_data,
+    const Matrix<Fp>& test_labels, uint32_t epochs, uint32_t batch_size,
+    const std::string& trainer,
+    const typename NeuralNetwork<Fp>::EpochCallback& on_epoch_end,
+    Fp input_scale, StepFn&& step);
+
+// Batches between two progress lines of RunBatchEpochs
+inline constexpr size_t kLogInterval = 500;
+
+}  // namespace Training
+
 #include "neural_network-inl.h"
 
 #endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_NEURAL_NETWORK_H_
\ No newline at end of file
@@ -3,35 +3,105 @@
 // Implementation of ReLULayer methods.
 // Intended only to be included by relu_layer.h.
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 template <std::floating_point Fp>
 LayerType ReLULayer<Fp>::Type() const {
   return LayerType::kReLU;
 }
 
 template <std::floating_point Fp>
-Matrix<Fp> ReLULayer<Fp>::Forward(const Matrix<Fp>& input) {
-  // Apply ReLU: output = max(0, input) element-wise
-  Matrix<Fp> output = input;
-  for (size_t r = 0; r < input.Rows(); ++r) {
-    for (size_t c = 0; c < input.Cols(); ++c) {
-      output(r, c) = std::max(Fp(0), input(r, c));
-    }
+const Matrix<Fp>& ReLULayer<Fp>::Forward(MatrixView<Fp> input) {
+  // Apply ReLU: output = max(0, input) element-wise, and keep the sign of
+  // every input as one mask bit for backpropagation
+  const size_t cols = input.Cols();
+  const size_t mask_words =
+      (cols + Simd::kReLUMaskBits - 1) / Simd::kReLUMaskBits;
+  output_.Resize(input.Rows(), cols);
+  mask_.resize(input.Rows() * mask_words);
+  const Simd::ReLUKernels<Fp>& relu = Simd::ReLU<Fp>();
+  for (size_t r = 0; cols > 0 && r < input.Rows(); ++r) {
+    relu.forward(input.Data() + r * input.RowStride(), &output_(r, 0),
+                 mask_.data() + r * mask_words, cols);
   }
-  input_cache_ = input;  // Cache input for backpropagation
-  return output;
+  fused_output_ = nullptr;
+  return output_;
 }
 
 template <std::floating_point Fp>
-Matrix<Fp> ReLULayer<Fp>::Backward(const Matrix<Fp>& grad_output) {
+const Matrix<Fp>& ReLULayer<Fp>::ForwardFused(const Matrix<Fp>& activations) {
+  fused_output_ = &activations;
+  return activations;
+}
+
+template <std::floating_point Fp>
+const Matrix<Fp>& ReLULayer<Fp>::Backward(const Matrix<Fp>& grad_output) {
   // Gradient of ReLU: grad_input = grad_output * (input > 0)
   // Gradient is passed only for positive inputs
-  Matrix<Fp> grad_input(grad_output.Rows(), grad_output.Cols());
-  for (size_t r = 0; r < input_cache_.Rows(); ++r) {
-    for (size_t c = 0; c < input_cache_.Cols(); ++c) {
-      grad_input(r, c) = input_cache_(r, c) > Fp(0) ? grad_output(r, c) : Fp(0);
+  const Matrix<Fp>& output =
+      fused_output_ != nullptr ? *fused_output_ : output_;
+  CHECK(output.Rows() == grad_output.Rows() &&
+        output.Cols() == grad_output.Cols() &&
+        "Gradient shape must match the last forward output.");
+  grad_input_.Resize(grad_output.Rows(), grad_output.Cols());
+  if (fused_output_ != nullptr) {
+    // The fused activations are positive exactly where the input was
+    for (size_t r = 0; r < output.Rows(); ++r) {
+      for (size_t c = 0; c < output.Cols(); ++c) {
+        grad_input_(r, c) =
+            output(r, c) > Fp(0) ? grad_output(r, c) : Fp(0);
+      }
     }
+    return grad_input_;
+  }
+  const size_t cols = grad_output.Cols();
+  const size_t mask_words =
+      (cols + Simd::kReLUMaskBits - 1) / Simd::kReLUMaskBits;
+  const Simd::ReLUKernels<Fp>& relu = Simd::ReLU<Fp>();
+  for (size_t r = 0; cols > 0 && r < grad_output.Rows(); ++r) {
+    relu.backward(&grad_output(r, 0), mask_.data() + r * mask_words,
+                  &grad_input_(r, 0), cols);
   }
-  return grad_input;
+  return grad_input_;
+}
+
+template <std::floating_point Fp>
+void ReLULayer<Fp>::Infer(MatrixView<Fp> input, Matrix<Fp>& output) const {
+  // Same as Forward, without the mask
+  output.Resize(input.Rows(), input.Cols());
+  for (size_t r = 0; r < input.Rows(); ++r) {
+    const Fp* row = input.Data() + r * input.RowStride();
+    for (size_t c = 0; c < input.Cols(); ++c) {
+      output(r, c) = std::max(row[c], Fp(0));
+    }
+  }
+}
+
+template <std::floating_point Fp>
+size_t ReLULayer<Fp>::ReserveWorkspace(
+    size_t max_rows, size_t input_cols,
+    std::vector<WorkspaceBuffer>& buffers) {
+  const size_t mask_words =
+      (input_cols + Simd::kReLUMaskBits - 1) / Simd::kReLUMaskBits;
+  output_.Reserve(max_rows, input_cols);
+  grad_input_.Reserve(max_rows, input_cols);
+  mask_.reserve(max_rows * mask_words);
+  buffers.push_back(
+      {.name = "output",
+       .bytes = output_.ToVector().capacity() * sizeof(Fp)});
+  buffers.push_back(
+      {.name = "mask", .bytes = mask_.capacity() * sizeof(uint64_t)});
+  buffers.push_back(
+      {.name = "grad_input",
+       .bytes = grad_input_.ToVector().capacity() * sizeof(Fp)});
+  return input_cols;
+}
+
+template <std::floating_point Fp>
+std::unique_ptr<NeuralLayer<Fp>> ReLULayer<Fp>::Clone() const {
+  return std::make_unique<ReLULayer<Fp>>();
 }
 
 // Serialization
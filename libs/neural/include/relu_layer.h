@@ -3,26 +3,56 @@
 #ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_RELU_LAYER_H_
 #define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_RELU_LAYER_H_
 
+#include <cstdint>
+
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "aligned_allocator.h"
 #include "matrix.h"
 #include "neural_layer.h"
 
 // Defines a ReLU activation layer
 // Applies the ReLU function: f(x) = max(0, x) element-wise
+// Backward only needs to know where the input was positive. Forward records
+// that as one bit per element, and a ReLU fused onto the preceding Linear
+// layer reuses that layer's output instead, so the layer never keeps a
+// copy of its input.
 template <std::floating_point Fp>
 class ReLULayer : public NeuralLayer<Fp> {
  public:
   ReLULayer() = default;
 
   LayerType Type() const override;
-  Matrix<Fp> Forward(const Matrix<Fp>& input) override;
-  Matrix<Fp> Backward(const Matrix<Fp>& grad_output) override;
+  const Matrix<Fp>& Forward(MatrixView<Fp> input) override;
+  // Takes the activations computed by a fused Linear + ReLU (see
+  // LinearLayer::ForwardReLU) as the output of this layer, so that Backward
+  // masks with them. Returns activations, which must stay valid until
+  // Backward.
+  const Matrix<Fp>& ForwardFused(const Matrix<Fp>& activations);
+  const Matrix<Fp>& Backward(const Matrix<Fp>& grad_output) override;
+  void Infer(MatrixView<Fp> input, Matrix<Fp>& output) const override;
+  size_t ReserveWorkspace(size_t max_rows, size_t input_cols,
+                          std::vector<WorkspaceBuffer>& buffers) override;
+  std::span<Fp> Gradients() override { return {}; }
+  std::unique_ptr<NeuralLayer<Fp>> Clone() const override;
+  // There are no parameters to share
+  std::unique_ptr<NeuralLayer<Fp>> CloneSharingParameters() override {
+    return Clone();
+  }
   void UpdateWeights() override {}  // No parameters to update in ReLU layer
 
   absl::Status Serialize(std::ostream& out) const override;
   absl::Status Deserialize(std::istream& in) override;
 
  private:
-  Matrix<Fp> input_cache_{0, 0};
+  Matrix<Fp> output_;
+  Matrix<Fp> grad_input_;
+  // Positive inputs of the last Forward, see Simd::ReLUKernels
+  Memory::AlignedVector<uint64_t> mask_;
+  // Activations of the last ForwardFused, null after Forward
+  const Matrix<Fp>* fused_output_ = nullptr;
 };
 
 #include "relu_layer-inl.h"
@@ -0,0 +1,889 @@
+// MIT License
+
+// This file contains the implementation of the element-wise kernels.
+// It is meant to be included only inside simd_kernels.h.
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <type_traits>
+
+namespace Simd {
+
+namespace internal {
+
+// Kernel bodies. They are plain loops over restrict-qualified pointers so
+// that the compiler vectorizes them for whichever instruction set the
+// enclosing variant is compiled for.
+
+#if NEURAL_HAS_VECTOR_EXTENSIONS
+// kBytes / sizeof(T) elements, held in the registers of the enclosing
+// variant
+template <typename T, size_t kBytes>
+struct VectorOf {
+  typedef T Type __attribute__((vector_size(kBytes)));
+};
+#endif
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void Add(const T* __restrict a, const T* __restrict b,
+                              T* __restrict out, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = a[i] + b[i];
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void Subtract(const T* __restrict a,
+                                   const T* __restrict b, T* __restrict out,
+                                   size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = a[i] - b[i];
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void AddAssign(T* __restrict a, const T* __restrict b,
+                                    size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    a[i] += b[i];
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void SubtractAssign(T* __restrict a,
+                                         const T* __restrict b, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    a[i] -= b[i];
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void MultiplyScalar(T* __restrict a, T scalar, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    a[i] *= scalar;
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void DivideScalar(T* __restrict a, T scalar, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    a[i] /= scalar;
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void AddScalar(T* __restrict a, T scalar, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    a[i] += scalar;
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void SubtractScalar(T* __restrict a, T scalar, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    a[i] -= scalar;
+  }
+}
+
+template <typename Src, typename Dst>
+NEURAL_ALWAYS_INLINE void Convert(const Src* __restrict in, Dst* __restrict out,
+                                  Dst scale, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = static_cast<Dst>(in[i]) * scale;
+  }
+}
+
+// Independent accumulators the row reductions keep: a cache line of
+// elements, so each step over them is one or two vector operations
+template <typename T>
+constexpr size_t kReductionLanes = 64 / sizeof(T);
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void ColumnSums(const T* __restrict src,
+                                     size_t src_stride, size_t rows,
+                                     size_t cols, T* __restrict out) {
+  for (size_t c = 0; c < cols; ++c) {
+    out[c] = T(0);
+  }
+  // Adds whole rows, so the loads are contiguous
+  for (size_t r = 0; r < rows; ++r) {
+    const T* __restrict row = src + r * src_stride;
+    for (size_t c = 0; c < cols; ++c) {
+      out[c] += row[c];
+    }
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void RowSums(const T* __restrict src, size_t rows,
+                                  size_t cols, T* __restrict out) {
+  constexpr size_t kLanes = kReductionLanes<T>;
+  const size_t full = cols - cols % kLanes;
+  for (size_t r = 0; r < rows; ++r) {
+    const T* __restrict row = src + r * cols;
+    T lanes[kLanes] = {};
+    for (size_t c = 0; c < full; c += kLanes) {
+      NEURAL_UNROLL
+      for (size_t j = 0; j < kLanes; ++j) {
+        lanes[j] += row[c + j];
+      }
+    }
+    T sum = T(0);
+    for (size_t j = 0; j < kLanes; ++j) {
+      sum += lanes[j];
+    }
+    for (size_t c = full; c < cols; ++c) {
+      sum += row[c];
+    }
+    out[r] = sum;
+  }
+}
+
+// Largest element of one row and the first column holding it, one step of
+// the scalar scan. Selects instead of branches, the position of the maximum
+// is unpredictable.
+template <typename T>
+NEURAL_ALWAYS_INLINE void MaxStep(T value, size_t col, T& best,
+                                  size_t& best_col) {
+  const bool greater = value > best;
+  best = greater ? value : best;
+  best_col = greater ? col : best_col;
+}
+
+// Finds the largest element of a row and, if kTrackCols, the first column
+// holding it. The maxima are taken on vectors of kVectorBytes, the register
+// width of the enclosing variant: GCC does not vectorize a floating-point
+// max written as a select in a plain loop. Each lane tracks the column of
+// its maximum in a signed integer lane of the same width, so the comparison
+// masks select both.
+template <size_t kVectorBytes, bool kTrackCols, typename T>
+NEURAL_ALWAYS_INLINE void RowMaxOf(const T* __restrict row, size_t cols,
+                                   T& best, size_t& best_col) {
+  best = row[0];
+  best_col = 0;
+  size_t c = 1;
+#if NEURAL_HAS_VECTOR_EXTENSIONS
+  constexpr size_t kLanes = kVectorBytes / sizeof(T);
+  if constexpr (sizeof(T) == 4 || sizeof(T) == 8) {
+    using Index = std::conditional_t<sizeof(T) == 4, int32_t, int64_t>;
+    using V = typename VectorOf<T, kVectorBytes>::Type;
+    using I = typename VectorOf<Index, kVectorBytes>::Type;
+    if (cols >= kLanes) {
+      V lanes;
+      std::memcpy(&lanes, row, sizeof(V));
+      I lane_cols;
+      for (size_t j = 0; j < kLanes; ++j) {
+        lane_cols[j] = static_cast<Index>(j);
+      }
+      I chunk_cols = lane_cols;
+      for (c = kLanes; c + kLanes <= cols; c += kLanes) {
+        V values;
+        std::memcpy(&values, row + c, sizeof(V));
+        const I greater = values > lanes;
+        lanes = greater ? values : lanes;
+        if constexpr (kTrackCols) {
+          chunk_cols += static_cast<Index>(kLanes);
+          lane_cols = greater ? chunk_cols : lane_cols;
+        }
+      }
+      best = lanes[0];
+      best_col = static_cast<size_t>(lane_cols[0]);
+      for (size_t j = 1; j < kLanes; ++j) {
+        const size_t col = static_cast<size_t>(lane_cols[j]);
+        if (lanes[j] > best || (lanes[j] == best && col < best_col)) {
+          best = lanes[j];
+          best_col = col;
+        }
+      }
+    }
+  }
+#endif
+  for (; c < cols; ++c) {
+    MaxStep(row[c], c, best, best_col);
+  }
+}
+
+template <size_t kVectorBytes, typename T>
+NEURAL_ALWAYS_INLINE void RowMax(const T* __restrict src, size_t rows,
+                                 size_t cols, T* __restrict max,
+                                 size_t* __restrict arg_max) {
+  for (size_t r = 0; r < rows; ++r) {
+    T best;
+    size_t best_col;
+    if (arg_max != nullptr) {
+      RowMaxOf<kVectorBytes, true>(src + r * cols, cols, best, best_col);
+      arg_max[r] = best_col;
+    } else {
+      RowMaxOf<kVectorBytes, false>(src + r * cols, cols, best, best_col);
+    }
+    if (max != nullptr)
+      max[r] = best;
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void ExpArray(const T* in, T* out, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = FastMath::Exp(in[i]);
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void LogArray(const T* in, T* out, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = FastMath::Log(in[i]);
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void TanhArray(const T* in, T* out, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = FastMath::Tanh(in[i]);
+  }
+}
+
+// Elements the softmax kernels process per block of rows. The rows are
+// shifted by their max, exponentiated and normalized in three passes, so
+// that the exponentials run as one long vectorized loop even when rows are
+// shorter than a vector (10 classes), and the block stays in L1 between the
+// passes.
+constexpr size_t kSoftmaxBlockElements = 1024;
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void ExpInPlace(T* __restrict values, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    values[i] = FastMath::Exp(values[i]);
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE T Sum(const T* __restrict values, size_t n) {
+  T sum = T(0);
+  for (size_t i = 0; i < n; ++i) {
+    sum += values[i];
+  }
+  return sum;
+}
+
+template <size_t kVectorBytes, typename T>
+NEURAL_ALWAYS_INLINE void Softmax(const T* src, T* out, size_t rows,
+                                  size_t cols) {
+  const size_t block_rows = std::max<size_t>(kSoftmaxBlockElements / cols, 1);
+  for (size_t first = 0; first < rows; first += block_rows) {
+    const size_t count = std::min(block_rows, rows - first);
+    for (size_t r = first; r < first + count; ++r) {
+      const T* row = src + r * cols;
+      T* out_row = out + r * cols;
+      T max;
+      size_t unused_col;
+      RowMaxOf<kVectorBytes, false>(row, cols, max, unused_col);
+      for (size_t c = 0; c < cols; ++c) {
+        out_row[c] = row[c] - max;
+      }
+    }
+    ExpInPlace(out + first * cols, count * cols);
+    for (size_t r = first; r < first + count; ++r) {
+      T* out_row = out + r * cols;
+      const T inverse = T(1) / Sum(out_row, cols);
+      for (size_t c = 0; c < cols; ++c) {
+        out_row[c] *= inverse;
+      }
+    }
+  }
+}
+
+// Softmax cross-entropy and its gradient, in the same passes as Softmax.
+// With s = logits - max, the loss of a row is
+// sum(labels) * log(sum(exp(s))) - sum(labels * s), which needs no
+// probability and cannot take the log of zero.
+template <size_t kVectorBytes, typename T>
+NEURAL_ALWAYS_INLINE T CrossEntropy(const T* logits,
+                                    const T* __restrict labels,
+                                    size_t labels_stride, T* grad,
+                                    T grad_scale, size_t rows, size_t cols) {
+  const size_t block_rows = std::max<size_t>(kSoftmaxBlockElements / cols, 1);
+  T total = T(0);
+  for (size_t first = 0; first < rows; first += block_rows) {
+    const size_t count = std::min(block_rows, rows - first);
+    for (size_t r = first; r < first + count; ++r) {
+      const T* row = logits + r * cols;
+      const T* __restrict label_row = labels + r * labels_stride;
+      T* grad_row = grad + r * cols;
+      T max;
+      size_t unused_col;
+      RowMaxOf<kVectorBytes, false>(row, cols, max, unused_col);
+      T label_dot = T(0);
+      for (size_t c = 0; c < cols; ++c) {
+        const T shifted = row[c] - max;
+        grad_row[c] = shifted;
+        label_dot += label_row[c] * shifted;
+      }
+      total -= label_dot;
+    }
+    ExpInPlace(grad + first * cols, count * cols);
+    // The row sums are gathered first, so their logarithms vectorize too
+    T sums[kSoftmaxBlockElements];
+    T log_sums[kSoftmaxBlockElements];
+    for (size_t i = 0; i < count; ++i) {
+      sums[i] = Sum(grad + (first + i) * cols, cols);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      log_sums[i] = FastMath::Log(sums[i]);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      const T* __restrict label_row = labels + (first + i) * labels_stride;
+      T* __restrict grad_row = grad + (first + i) * cols;
+      total += Sum(label_row, cols) * log_sums[i];
+      const T scale = grad_scale / sums[i];
+      for (size_t c = 0; c < cols; ++c) {
+        grad_row[c] = grad_row[c] * scale - label_row[c] * grad_scale;
+      }
+    }
+  }
+  return total;
+}
+
+// The mask bits are built a word at a time, so the element loop has a
+// fixed trip count the compiler can vectorize
+template <typename T>
+NEURAL_ALWAYS_INLINE void ReLUForward(const T* in, T* out,
+                                      uint64_t* __restrict mask, size_t n) {
+  for (size_t begin = 0; begin < n; begin += kReLUMaskBits) {
+    const size_t count = std::min(kReLUMaskBits, n - begin);
+    uint64_t bits = 0;
+    for (size_t j = 0; j < count; ++j) {
+      const T value = in[begin + j];
+      bits |= uint64_t{value > T(0)} << j;
+      out[begin + j] = value > T(0) ? value : T(0);
+    }
+    mask[begin / kReLUMaskBits] = bits;
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void ReLUBackward(const T* __restrict grad,
+                                       const uint64_t* __restrict mask,
+                                       T* __restrict out, size_t n) {
+  for (size_t begin = 0; begin < n; begin += kReLUMaskBits) {
+    const size_t count = std::min(kReLUMaskBits, n - begin);
+    const uint64_t bits = mask[begin / kReLUMaskBits];
+    for (size_t j = 0; j < count; ++j) {
+      out[begin + j] = (bits >> j) & 1 ? grad[begin + j] : T(0);
+    }
+  }
+}
+
+// Rows the gather prefetches ahead of the one it copies
+constexpr size_t kGatherPrefetchRows = 4;
+
+NEURAL_ALWAYS_INLINE void PrefetchRead(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address, 0, 0);
+#else
+  (void)address;
+#endif
+}
+
+// Prefetches every cache line of the cols elements at row
+template <typename T>
+NEURAL_ALWAYS_INLINE void PrefetchRow(const T* row, size_t cols) {
+  constexpr size_t kLineElements = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+  for (size_t c = 0; c < cols; c += kLineElements) {
+    PrefetchRead(row + c);
+  }
+}
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void GatherRows(const T* __restrict src,
+                                     size_t src_stride,
+                                     const size_t* __restrict rows,
+                                     size_t count, size_t cols,
+                                     T* __restrict out) {
+  for (size_t i = 0; i < count; ++i) {
+    if (i + kGatherPrefetchRows < count)
+      PrefetchRow(src + rows[i + kGatherPrefetchRows] * src_stride, cols);
+    const T* __restrict row = src + rows[i] * src_stride;
+    T* __restrict dst = out + i * cols;
+    for (size_t c = 0; c < cols; ++c) {
+      dst[c] = row[c];
+    }
+  }
+}
+
+template <typename Src, typename Dst>
+NEURAL_ALWAYS_INLINE void GatherConvertRows(const Src* __restrict src,
+                                            size_t src_stride,
+                                            const size_t* __restrict rows,
+                                            size_t count, size_t cols,
+                                            Dst scale, Dst* __restrict out) {
+  for (size_t i = 0; i < count; ++i) {
+    if (i + kGatherPrefetchRows < count)
+      PrefetchRow(src + rows[i + kGatherPrefetchRows] * src_stride, cols);
+    const Src* __restrict row = src + rows[i] * src_stride;
+    Dst* __restrict dst = out + i * cols;
+    for (size_t c = 0; c < cols; ++c) {
+      dst[c] = static_cast<Dst>(row[c]) * scale;
+    }
+  }
+}
+
+// Edge of the tiles transposed in registers
+constexpr size_t kTransposeTile = 8;
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void TransposeScalar(const T* __restrict src,
+                                          size_t src_stride, size_t rows,
+                                          size_t cols, T* __restrict dst,
+                                          size_t dst_stride) {
+  for (size_t r = 0; r < rows; ++r) {
+    for (size_t c = 0; c < cols; ++c) {
+      dst[c * dst_stride + r] = src[r * src_stride + c];
+    }
+  }
+}
+
+#if NEURAL_HAS_VECTOR_EXTENSIONS
+// Transposes an 8x8 tile in registers with the three unpack / shuffle /
+// lane-permute rounds of the classic AVX sequence. Written with generic
+// shuffles, so each variant maps them onto its own instructions.
+template <typename T>
+NEURAL_ALWAYS_INLINE void Transpose8x8(const T* __restrict src,
+                                       size_t src_stride, T* __restrict dst,
+                                       size_t dst_stride) {
+  using V = typename VectorOf<T, 8 * sizeof(T)>::Type;
+  V rows[8];
+  NEURAL_UNROLL
+  for (size_t i = 0; i < 8; ++i) {
+    std::memcpy(&rows[i], src + i * src_stride, sizeof(V));
+  }
+  // Interleave pairs of rows
+  V pairs[8];
+  NEURAL_UNROLL
+  for (size_t i = 0; i < 8; i += 2) {
+    pairs[i] = __builtin_shufflevector(rows[i], rows[i + 1], 0, 8, 1, 9, 4,
+                                       12, 5, 13);
+    pairs[i + 1] = __builtin_shufflevector(rows[i], rows[i + 1], 2, 10, 3, 11,
+                                           6, 14, 7, 15);
+  }
+  // Interleave pairs of pairs
+  V quads[8];
+  NEURAL_UNROLL
+  for (size_t i = 0; i < 8; i += 4) {
+    quads[i] = __builtin_shufflevector(pairs[i], pairs[i + 2], 0, 1, 8, 9, 4,
+                                       5, 12, 13);
+    quads[i + 1] = __builtin_shufflevector(pairs[i], pairs[i + 2], 2, 3, 10,
+                                           11, 6, 7, 14, 15);
+    quads[i + 2] = __builtin_shufflevector(pairs[i + 1], pairs[i + 3], 0, 1,
+                                           8, 9, 4, 5, 12, 13);
+    quads[i + 3] = __builtin_shufflevector(pairs[i + 1], pairs[i + 3], 2, 3,
+                                           10, 11, 6, 7, 14, 15);
+  }
+  // Swap the upper half of the first four with the lower half of the last
+  NEURAL_UNROLL
+  for (size_t i = 0; i < 4; ++i) {
+    V low = __builtin_shufflevector(quads[i], quads[i + 4], 0, 1, 2, 3, 8, 9,
+                                    10, 11);
+    V high = __builtin_shufflevector(quads[i], quads[i + 4], 4, 5, 6, 7, 12,
+                                     13, 14, 15);
+    std::memcpy(dst + i * dst_stride, &low, sizeof(V));
+    std::memcpy(dst + (i + 4) * dst_stride, &high, sizeof(V));
+  }
+}
+#else
+template <typename T>
+NEURAL_ALWAYS_INLINE void Transpose8x8(const T* __restrict src,
+                                       size_t src_stride, T* __restrict dst,
+                                       size_t dst_stride) {
+  TransposeScalar(src, src_stride, kTransposeTile, kTransposeTile, dst,
+                  dst_stride);
+}
+#endif
+
+template <typename T>
+NEURAL_ALWAYS_INLINE void Transpose(const T* __restrict src,
+                                    size_t src_stride, size_t rows,
+                                    size_t cols, T* __restrict dst,
+                                    size_t dst_stride) {
+  const size_t full_rows = rows - rows % kTransposeTile;
+  const size_t full_cols = cols - cols % kTransposeTile;
+  for (size_t r = 0; r < full_rows; r += kTransposeTile) {
+    for (size_t c = 0; c < full_cols; c += kTransposeTile) {
+      Transpose8x8(src + r * src_stride + c, src_stride,
+                   dst + c * dst_stride + r, dst_stride);
+    }
+    TransposeScalar(src + r * src_stride + full_cols, src_stride,
+                    kTransposeTile, cols - full_cols,
+                    dst + full_cols * dst_stride + r, dst_stride);
+  }
+  TransposeScalar(src + full_rows * src_stride, src_stride, rows - full_rows,
+                  cols, dst + full_rows, dst_stride);
+}
+
+// Defines a struct whose static members instantiate every kernel body
+// inside functions compiled with the given target attribute. VECTOR_BYTES
+// is the width of the variant's vector registers.
+#define SIMD_DEFINE_VARIANT(Name, TARGET, VECTOR_BYTES)                      \
+  struct Name {                                                              \
+    template <typename T>                                                    \
+    TARGET static void Add(const T* a, const T* b, T* out, size_t n) {       \
+      internal::Add(a, b, out, n);                                           \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void Subtract(const T* a, const T* b, T* out, size_t n) {  \
+      internal::Subtract(a, b, out, n);                                      \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void AddAssign(T* a, const T* b, size_t n) {               \
+      internal::AddAssign(a, b, n);                                          \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void SubtractAssign(T* a, const T* b, size_t n) {          \
+      internal::SubtractAssign(a, b, n);                                     \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void MultiplyScalar(T* a, T scalar, size_t n) {            \
+      internal::MultiplyScalar(a, scalar, n);                                \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void DivideScalar(T* a, T scalar, size_t n) {              \
+      internal::DivideScalar(a, scalar, n);                                  \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void AddScalar(T* a, T scalar, size_t n) {                 \
+      internal::AddScalar(a, scalar, n);                                     \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void SubtractScalar(T* a, T scalar, size_t n) {            \
+      internal::SubtractScalar(a, scalar, n);                                \
+    }                                                                        \
+    template <typename Src, typename Dst>                                    \
+    TARGET static void Convert(const Src* in, Dst* out, Dst scale,           \
+                               size_t n) {                                   \
+      internal::Convert(in, out, scale, n);                                  \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void ColumnSums(const T* src, size_t src_stride,           \
+                                  size_t rows, size_t cols, T* out) {        \
+      internal::ColumnSums(src, src_stride, rows, cols, out);                \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void RowSums(const T* src, size_t rows, size_t cols,       \
+                               T* out) {                                     \
+      internal::RowSums(src, rows, cols, out);                               \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void RowMax(const T* src, size_t rows, size_t cols,        \
+                              T* max, size_t* arg_max) {                     \
+      internal::RowMax<VECTOR_BYTES>(src, rows, cols, max, arg_max);         \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void Exp(const T* in, T* out, size_t n) {                  \
+      internal::ExpArray(in, out, n);                                        \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void Log(const T* in, T* out, size_t n) {                  \
+      internal::LogArray(in, out, n);                                        \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void Tanh(const T* in, T* out, size_t n) {                 \
+      internal::TanhArray(in, out, n);                                       \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void Softmax(const T* src, T* out, size_t rows,            \
+                               size_t cols) {                                \
+      internal::Softmax<VECTOR_BYTES>(src, out, rows, cols);                 \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static T CrossEntropy(const T* logits, const T* labels,           \
+                                 size_t labels_stride, T* grad,              \
+                                 T grad_scale, size_t rows, size_t cols) {   \
+      return internal::CrossEntropy<VECTOR_BYTES>(                           \
+          logits, labels, labels_stride, grad, grad_scale, rows, cols);      \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void ReLUForward(const T* in, T* out, uint64_t* mask,      \
+                                   size_t n) {                               \
+      internal::ReLUForward(in, out, mask, n);                               \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void ReLUBackward(const T* grad, const uint64_t* mask,     \
+                                    T* out, size_t n) {                      \
+      internal::ReLUBackward(grad, mask, out, n);                            \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void GatherRows(const T* src, size_t src_stride,           \
+                                  const size_t* rows, size_t count,          \
+                                  size_t cols, T* out) {                     \
+      internal::GatherRows(src, src_stride, rows, count, cols, out);         \
+    }                                                                        \
+    template <typename Src, typename Dst>                                    \
+    TARGET static void GatherConvertRows(const Src* src, size_t src_stride,  \
+                                         const size_t* rows, size_t count,   \
+                                         size_t cols, Dst scale, Dst* out) { \
+      internal::GatherConvertRows(src, src_stride, rows, count, cols, scale, \
+                                  out);                                      \
+    }                                                                        \
+    template <typename T>                                                    \
+    TARGET static void Transpose(const T* src, size_t src_stride,            \
+                                 size_t rows, size_t cols, T* dst,           \
+                                 size_t dst_stride) {                        \
+      internal::Transpose(src, src_stride, rows, cols, dst, dst_stride);     \
+    }                                                                        \
+  };
+
+SIMD_DEFINE_VARIANT(Portable, , 16)
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+SIMD_DEFINE_VARIANT(Avx2, NEURAL_TARGET_AVX2, 32)
+SIMD_DEFINE_VARIANT(Avx512, NEURAL_TARGET_AVX512, 64)
+#endif
+
+#undef SIMD_DEFINE_VARIANT
+
+template <typename Variant, typename T>
+ElementwiseKernels<T> MakeKernels() {
+  return ElementwiseKernels<T>{
+      &Variant::template Add<T>,
+      &Variant::template Subtract<T>,
+      &Variant::template AddAssign<T>,
+      &Variant::template SubtractAssign<T>,
+      &Variant::template MultiplyScalar<T>,
+      &Variant::template DivideScalar<T>,
+      &Variant::template AddScalar<T>,
+      &Variant::template SubtractScalar<T>,
+  };
+}
+
+template <typename Variant, typename T>
+ReductionKernels<T> MakeReductionKernels() {
+  return ReductionKernels<T>{
+      &Variant::template ColumnSums<T>,
+      &Variant::template RowSums<T>,
+      &Variant::template RowMax<T>,
+  };
+}
+
+template <typename Variant, typename T>
+MathKernels<T> MakeMathKernels() {
+  return MathKernels<T>{
+      &Variant::template Exp<T>,
+      &Variant::template Log<T>,
+      &Variant::template Tanh<T>,
+  };
+}
+
+template <typename Variant, typename T>
+SoftmaxKernels<T> MakeSoftmaxKernels() {
+  return SoftmaxKernels<T>{
+      &Variant::template Softmax<T>,
+      &Variant::template CrossEntropy<T>,
+  };
+}
+
+template <typename Variant, typename T>
+ReLUKernels<T> MakeReLUKernels() {
+  return ReLUKernels<T>{
+      &Variant::template ReLUForward<T>,
+      &Variant::template ReLUBackward<T>,
+  };
+}
+
+}  // namespace internal
+
+template <typename T>
+ElementwiseKernels<T> KernelsFor(SimdLevel level) {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+  switch (level) {
+    case SimdLevel::kAvx512:
+      return internal::MakeKernels<internal::Avx512, T>();
+    case SimdLevel::kAvx2:
+      return internal::MakeKernels<internal::Avx2, T>();
+    default:
+      break;
+  }
+#endif
+  return internal::MakeKernels<internal::Portable, T>();
+}
+
+template <typename T>
+ReductionKernels<T> ReductionKernelsFor(SimdLevel level) {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+  switch (level) {
+    case SimdLevel::kAvx512:
+      return internal::MakeReductionKernels<internal::Avx512, T>();
+    case SimdLevel::kAvx2:
+      return internal::MakeReductionKernels<internal::Avx2, T>();
+    default:
+      break;
+  }
+#endif
+  return internal::MakeReductionKernels<internal::Portable, T>();
+}
+
+template <typename T>
+ReLUKernels<T> ReLUKernelsFor(SimdLevel level) {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+  switch (level) {
+    case SimdLevel::kAvx512:
+      return internal::MakeReLUKernels<internal::Avx512, T>();
+    case SimdLevel::kAvx2:
+      return internal::MakeReLUKernels<internal::Avx2, T>();
+    default:
+      break;
+  }
+#endif
+  return internal::MakeReLUKernels<internal::Portable, T>();
+}
+
+template <FastMath::Real T>
+MathKernels<T> MathKernelsFor(SimdLevel level) {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+  switch (level) {
+    case SimdLevel::kAvx512:
+      return internal::MakeMathKernels<internal::Avx512, T>();
+    case SimdLevel::kAvx2:
+      return internal::MakeMathKernels<internal::Avx2, T>();
+    default:
+      break;
+  }
+#endif
+  return internal::MakeMathKernels<internal::Portable, T>();
+}
+
+template <FastMath::Real T>
+SoftmaxKernels<T> SoftmaxKernelsFor(SimdLevel level) {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+  switch (level) {
+    case SimdLevel::kAvx512:
+      return internal::MakeSoftmaxKernels<internal::Avx512, T>();
+    case SimdLevel::kAvx2:
+      return internal::MakeSoftmaxKernels<internal::Avx2, T>();
+    default:
+      break;
+  }
+#endif
+  return internal::MakeSoftmaxKernels<internal::Portable, T>();
+}
+
+template <typename Src, typename Dst>
+ConvertFn<Src, Dst> ConvertKernelFor(SimdLevel level) {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+  switch (level) {
+    case SimdLevel::kAvx512:
+      return &internal::Avx512::template Convert<Src, Dst>;
+    case SimdLevel::kAvx2:
+      return &internal::Avx2::template Convert<Src, Dst>;
+    default:
+      break;
+  }
+#endif
+  return &internal::Portable::template Convert<Src, Dst>;
+}
+
+template <typename T>
+GatherRowsFn<T> GatherRowsKernelFor(SimdLevel level) {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+  switch (level) {
+    case SimdLevel::kAvx512:
+      return &internal::Avx512::template GatherRows<T>;
+    case SimdLevel::kAvx2:
+      return &internal::Avx2::template GatherRows<T>;
+    default:
+      break;
+  }
+#endif
+  return &internal::Portable::template GatherRows<T>;
+}
+
+template <typename Src, typename Dst>
+GatherConvertRowsFn<Src, Dst> GatherConvertRowsKernelFor(SimdLevel level) {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+  switch (level) {
+    case SimdLevel::kAvx512:
+      return &internal::Avx512::template GatherConvertRows<Src, Dst>;
+    case SimdLevel::kAvx2:
+      return &internal::Avx2::template GatherConvertRows<Src, Dst>;
+    default:
+      break;
+  }
+#endif
+  return &internal::Portable::template GatherConvertRows<Src, Dst>;
+}
+
+template <typename T>
+TransposeFn<T> TransposeKernelFor(SimdLevel level) {
+#if NEURAL_HAS_TARGET_ATTRIBUTES
+  switch (level) {
+    case SimdLevel::kAvx512:
+      return &internal::Avx512::template Transpose<T>;
+    case SimdLevel::kAvx2:
+      return &internal::Avx2::template Transpose<T>;
+    default:
+      break;
+  }
+#endif
+  return &internal::Portable::template Transpose<T>;
+}
+
+template <typename T>
+const ElementwiseKernels<T>& Kernels() {
+  static const ElementwiseKernels<T> kKernels = KernelsFor<T>(ActiveSimdLevel());
+  return kKernels;
+}
+
+template <typename T>
+const ReductionKernels<T>& Reductions() {
+  static const ReductionKernels<T> kKernels =
+      ReductionKernelsFor<T>(ActiveSimdLevel());
+  return kKernels;
+}
+
+template <typename T>
+const ReLUKernels<T>& ReLU() {
+  static const ReLUKernels<T> kKernels = ReLUKernelsFor<T>(ActiveSimdLevel());
+  return kKernels;
+}
+
+template <FastMath::Real T>
+const MathKernels<T>& Math() {
+  static const MathKernels<T> kKernels = MathKernelsFor<T>(ActiveSimdLevel());
+  return kKernels;
+}
+
+template <FastMath::Real T>
+const SoftmaxKernels<T>& Softmax() {
+  static const SoftmaxKernels<T> kKernels =
+      SoftmaxKernelsFor<T>(ActiveSimdLevel());
+  return kKernels;
+}
+
+template <typename Src, typename Dst>
+ConvertFn<Src, Dst> ConvertKernel() {
+  static const ConvertFn<Src, Dst> kKernel =
+      ConvertKernelFor<Src, Dst>(ActiveSimdLevel());
+  return kKernel;
+}
+
+template <typename T>
+GatherRowsFn<T> GatherRowsKernel() {
+  static const GatherRowsFn<T> kKernel =
+      GatherRowsKernelFor<T>(ActiveSimdLevel());
+  return kKernel;
+}
+
+template <typename Src, typename Dst>
+GatherConvertRowsFn<Src, Dst> GatherConvertRowsKernel() {
+  static const GatherConvertRowsFn<Src, Dst> kKernel =
+      GatherConvertRowsKernelFor<Src, Dst>(ActiveSimdLevel());
+  return kKernel;
+}
+
+template <typename T>
+TransposeFn<T> TransposeKernel() {
+  static const TransposeFn<T> kKernel =
+      TransposeKernelFor<T>(ActiveSimdLevel());
+  return kKernel;
+}
+
+}  // namespace Simd
@@ -0,0 +1,173 @@
+// MIT License
+
+// Defines the element-wise kernels behind Matrix arithmetic and conversions.
+// Every kernel is built in a portable, an AVX2 and an AVX-512 variant (see
+// cpu_features.h); Kernels() returns the table matching the host CPU.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_SIMD_KERNELS_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_SIMD_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_features.h"
+#include "fast_math.h"
+
+namespace Simd {
+
+// Element-wise kernels for one element type, compiled for one SIMD level.
+// All kernels operate on n contiguous elements.
+template <typename T>
+struct ElementwiseKernels {
+  void (*add)(const T* a, const T* b, T* out, size_t n);       // a + b
+  void (*subtract)(const T* a, const T* b, T* out, size_t n);  // a - b
+  void (*add_assign)(T* a, const T* b, size_t n);              // a += b
+  void (*subtract_assign)(T* a, const T* b, size_t n);         // a -= b
+  void (*multiply_scalar)(T* a, T scalar, size_t n);           // a *= s
+  void (*divide_scalar)(T* a, T scalar, size_t n);             // a /= s
+  void (*add_scalar)(T* a, T scalar, size_t n);                // a += s
+  void (*subtract_scalar)(T* a, T scalar, size_t n);           // a -= s
+};
+
+// Reductions over a row-major matrix, compiled for one SIMD level.
+template <typename T>
+struct ReductionKernels {
+  // out[c] = sum of column c over the rows (row-major accumulation, rows
+  // src_stride elements apart)
+  void (*column_sums)(const T* src, size_t src_stride, size_t rows,
+                      size_t cols, T* out);
+  // out[r] = sum of row r
+  void (*row_sums)(const T* src, size_t rows, size_t cols, T* out);
+  // max[r] and arg_max[r] = largest element of row r and its first column.
+  // Either output may be null. cols must be positive.
+  void (*row_max)(const T* src, size_t rows, size_t cols, T* max,
+                  size_t* arg_max);
+};
+
+// Elements covered by one word of a ReLU mask
+inline constexpr size_t kReLUMaskBits = 64;
+
+// ReLU with its derivative kept as one bit per element, compiled for one
+// SIMD level. Element j of a row of n elements is bit j % 64 of word j / 64
+// of the row's mask, which has (n + 63) / 64 words.
+template <typename T>
+struct ReLUKernels {
+  // out[j] = max(0, in[j]) and the mask bit of j = in[j] > 0. out may be in.
+  void (*forward)(const T* in, T* out, uint64_t* mask, size_t n);
+  // out[j] = grad[j] where the mask bit of j is set, 0 elsewhere
+  void (*backward)(const T* grad, const uint64_t* mask, T* out, size_t n);
+};
+
+// FastMath functions over arrays, compiled for one SIMD level:
+// out[i] = f(in[i]) for n elements. out may be in.
+template <typename T>
+struct MathKernels {
+  void (*exp)(const T* in, T* out, size_t n);
+  void (*log)(const T* in, T* out, size_t n);
+  void (*tanh)(const T* in, T* out, size_t n);
+};
+
+// Row-wise softmax and softmax cross-entropy, compiled for one SIMD level.
+// Both take a single FastMath::Exp per element. cols must be positive.
+template <typename T>
+struct SoftmaxKernels {
+  // Softmax of each row of the contiguous rows x cols src into out. out may
+  // be src.
+  void (*softmax)(const T* src, T* out, size_t rows, size_t cols);
+  // Writes (softmax(logits) - labels) * grad_scale into grad and returns the
+  // cross-entropy -sum(labels * log(softmax(logits))) summed over the rows.
+  // logits and grad are contiguous, rows of labels are labels_stride
+  // elements apart. grad may be logits.
+  T (*cross_entropy)(const T* logits, const T* labels, size_t labels_stride,
+                     T* grad, T grad_scale, size_t rows, size_t cols);
+};
+
+// Converts n elements and scales them: out[i] = Dst(in[i]) * scale.
+template <typename Src, typename Dst>
+using ConvertFn = void (*)(const Src* in, Dst* out, Dst scale, size_t n);
+
+// Copies rows rows[0..count) of a matrix whose rows are src_stride elements
+// apart into the contiguous count x cols buffer out, prefetching the rows a
+// few steps ahead (random rows defeat the hardware prefetcher).
+template <typename T>
+using GatherRowsFn = void (*)(const T* src, size_t src_stride,
+                              const size_t* rows, size_t count, size_t cols,
+                              T* out);
+
+// GatherRowsFn fused with ConvertFn: widens and scales the gathered rows,
+// out[i][c] = Dst(src[rows[i]][c]) * scale, so the source can stay in its
+// narrow type (e.g. uint8_t pixels) and is read once.
+template <typename Src, typename Dst>
+using GatherConvertRowsFn = void (*)(const Src* src, size_t src_stride,
+                                     const size_t* rows, size_t count,
+                                     size_t cols, Dst scale, Dst* out);
+
+// Transposes the rows x cols block at src (rows src_stride elements apart)
+// into dst (rows dst_stride elements apart): dst[c][r] = src[r][c].
+// Full 8x8 tiles are transposed in registers.
+template <typename T>
+using TransposeFn = void (*)(const T* src, size_t src_stride, size_t rows,
+                             size_t cols, T* dst, size_t dst_stride);
+
+// Returns the kernels compiled for the given level.
+// The level must not exceed DetectSimdLevel().
+template <typename T>
+ElementwiseKernels<T> KernelsFor(SimdLevel level);
+
+template <typename T>
+ReductionKernels<T> ReductionKernelsFor(SimdLevel level);
+
+template <typename T>
+ReLUKernels<T> ReLUKernelsFor(SimdLevel level);
+
+template <FastMath::Real T>
+MathKernels<T> MathKernelsFor(SimdLevel level);
+
+template <FastMath::Real T>
+SoftmaxKernels<T> SoftmaxKernelsFor(SimdLevel level);
+
+template <typename Src, typename Dst>
+ConvertFn<Src, Dst> ConvertKernelFor(SimdLevel level);
+
+template <typename T>
+GatherRowsFn<T> GatherRowsKernelFor(SimdLevel level);
+
+template <typename Src, typename Dst>
+GatherConvertRowsFn<Src, Dst> GatherConvertRowsKernelFor(SimdLevel level);
+
+template <typename T>
+TransposeFn<T> TransposeKernelFor(SimdLevel level);
+
+// Kernels for ActiveSimdLevel(), selected once on first use.
+template <typename T>
+const ElementwiseKernels<T>& Kernels();
+
+template <typename T>
+const ReductionKernels<T>& Reductions();
+
+template <typename T>
+const ReLUKernels<T>& ReLU();
+
+template <FastMath::Real T>
+const MathKernels<T>& Math();
+
+template <FastMath::Real T>
+const SoftmaxKernels<T>& Softmax();
+
+template <typename Src, typename Dst>
+ConvertFn<Src, Dst> ConvertKernel();
+
+template <typename T>
+GatherRowsFn<T> GatherRowsKernel();
+
+template <typename Src, typename Dst>
+GatherConvertRowsFn<Src, Dst> GatherConvertRowsKernel();
+
+template <typename T>
+TransposeFn<T> TransposeKernel();
+
+}  // namespace Simd
+
+#include "simd_kernels-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_SIMD_KERNELS_H_
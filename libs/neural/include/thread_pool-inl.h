@@ -0,0 +1,249 @@
+// MIT License
+
+// This file contains the implementation of the ThreadPool class.
+// It is meant to be included only inside thread_pool.h.
+
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// ---------
+// WorkQueue
+// ---------
+inline bool ThreadPool::WorkQueue::PushBack(const Task& task) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (size_ == kCapacity)
+    return false;
+  tasks_[(head_ + size_) % kCapacity] = task;
+  ++size_;
+  return true;
+}
+
+inline bool ThreadPool::WorkQueue::PopBack(Task& task) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (size_ == 0)
+    return false;
+  --size_;
+  task = tasks_[(head_ + size_) % kCapacity];
+  return true;
+}
+
+inline bool ThreadPool::WorkQueue::PopFront(Task& task) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (size_ == 0)
+    return false;
+  task = tasks_[head_];
+  head_ = (head_ + 1) % kCapacity;
+  --size_;
+  return true;
+}
+
+// ---------
+// ThreadPool
+// ---------
+inline ThreadPool::ThreadPool(const ThreadPoolOptions& options) {
+  uint32_t num_threads = options.num_threads;
+  if (num_threads == 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  max_parallelism_ = options.max_parallelism == 0
+                         ? num_threads
+                         : std::min(options.max_parallelism, num_threads);
+
+  // The calling thread is the last participant, so spawn one fewer worker
+  const uint32_t num_workers = num_threads - 1;
+  queues_.reserve(num_workers + 1);
+  for (uint32_t i = 0; i < num_workers + 1; ++i) {
+    queues_.push_back(std::make_unique<WorkQueue>());
+  }
+  workers_.reserve(num_workers);
+  for (uint32_t i = 0; i < num_workers; ++i) {
+    workers_.emplace_back([this, i, pin = options.pin_threads] {
+      if (pin)
+        PinCurrentThread(i);
+      WorkerLoop(i);
+    });
+  }
+}
+
+inline ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_.store(true, std::memory_order_release);
+  }
+  wake_.notify_all();
+  workers_.clear();  // Joins
+}
+
+inline ThreadPool& ThreadPool::Global() {
+  ThreadPool* pool = global_pool_.load(std::memory_order_acquire);
+  if (pool != nullptr)
+    return *pool;
+  std::lock_guard<std::mutex> lock(global_mutex_);
+  if (global_owner_ == nullptr) {
+    global_owner_ = std::make_unique<ThreadPool>();
+    global_pool_.store(global_owner_.get(), std::memory_order_release);
+  }
+  return *global_owner_;
+}
+
+inline void ThreadPool::ConfigureGlobal(const ThreadPoolOptions& options) {
+  std::lock_guard<std::mutex> lock(global_mutex_);
+  global_pool_.store(nullptr, std::memory_order_release);
+  global_owner_.reset();  // Join the old workers before spawning new ones
+  global_owner_ = std::make_unique<ThreadPool>(options);
+  global_pool_.store(global_owner_.get(), std::memory_order_release);
+}
+
+inline uint32_t ThreadPool::NumThreads() const noexcept {
+  return static_cast<uint32_t>(workers_.size()) + 1;
+}
+
+inline uint32_t ThreadPool::MaxParallelism() const noexcept {
+  return max_parallelism_;
+}
+
+template <typename Fn>
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain, Fn&& fn) {
+  if (begin >= end)
+    return;
+  const size_t count = end - begin;
+  grain = std::max<size_t>(grain, 1);
+  const size_t max_chunks = std::min<size_t>(MaxParallelism(), count);
+  size_t num_chunks = std::min((count + grain - 1) / grain, max_chunks);
+  if (num_chunks <= 1) {
+    fn(begin, end);
+    return;
+  }
+  // Rounding the step up can leave fewer chunks than asked for
+  // (5 elements in 4 chunks are 3 chunks of 2)
+  const size_t step = (count + num_chunks - 1) / num_chunks;
+  num_chunks = (count + step - 1) / step;
+
+  // Tasks point at fn and the counter on this stack frame, so queueing a loop
+  // does not allocate
+  using FnType = std::remove_reference_t<Fn>;
+  auto trampoline = [](void* context, size_t chunk_begin, size_t chunk_end) {
+    (*static_cast<FnType*>(context))(chunk_begin, chunk_end);
+  };
+  std::atomic<size_t> pending{num_chunks};
+  const size_t home = HomeQueue();
+
+  size_t queued = 0;
+  for (size_t chunk_begin = begin; chunk_begin < end; chunk_begin += step) {
+    Task task{trampoline, const_cast<void*>(static_cast<const void*>(&fn)),
+              chunk_begin, std::min(chunk_begin + step, end), &pending};
+    // Count the task before publishing it so the counter never underflows
+    queued_tasks_.fetch_add(1, std::memory_order_release);
+    if (queues_[home]->PushBack(task)) {
+      ++queued;
+    } else {
+      queued_tasks_.fetch_sub(1, std::memory_order_relaxed);
+      RunTask(task);  // Queue full, run it here
+    }
+  }
+  if (queued > 0)
+    WakeWorkers(queued);
+
+  // Help with queued work until every chunk of this loop is done.
+  // The epoch is read before pending, so a completion in between is seen
+  // as a changed epoch and the wait returns immediately.
+  while (true) {
+    uint64_t epoch = completion_epoch_.load(std::memory_order_acquire);
+    if (pending.load(std::memory_order_acquire) == 0)
+      break;
+    if (!TryRunOne(home))
+      completion_epoch_.wait(epoch, std::memory_order_acquire);
+  }
+}
+
+inline void ThreadPool::WorkerLoop(uint32_t index) {
+  current_pool_ = this;
+  current_queue_ = index;
+
+  // Spin briefly before sleeping, parallel loops tend to arrive in bursts
+  constexpr int kSpinIterations = 256;
+  while (true) {
+    if (TryRunOne(index))
+      continue;
+    bool found_work = false;
+    for (int i = 0; i < kSpinIterations; ++i) {
+      if (queued_tasks_.load(std::memory_order_acquire) > 0) {
+        found_work = true;
+        break;
+      }
+      std::this_thread::yield();
+    }
+    if (found_work)
+      continue;
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [this] {
+      return stop_.load(std::memory_order_acquire) ||
+             queued_tasks_.load(std::memory_order_acquire) > 0;
+    });
+    if (stop_.load(std::memory_order_acquire) &&
+        queued_tasks_.load(std::memory_order_acquire) == 0)
+      return;
+  }
+}
+
+inline bool ThreadPool::TryRunOne(size_t home) {
+  Task task;
+  bool found = queues_[home]->PopBack(task);
+  // Steal, starting after the home queue so thieves spread out
+  const size_t num_queues = queues_.size();
+  for (size_t i = 1; !found && i < num_queues; ++i) {
+    found = queues_[(home + i) % num_queues]->PopFront(task);
+  }
+  if (!found)
+    return false;
+  queued_tasks_.fetch_sub(1, std::memory_order_acq_rel);
+  RunTask(task);
+  return true;
+}
+
+inline void ThreadPool::RunTask(const Task& task) {
+  task.run(task.context, task.begin, task.end);
+  // The counter lives on the waiting thread's stack and may be gone as soon
+  // as it reaches zero, so the wake-up goes through pool-owned state
+  if (task.pending->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    completion_epoch_.fetch_add(1, std::memory_order_acq_rel);
+    completion_epoch_.notify_all();
+  }
+}
+
+inline size_t ThreadPool::HomeQueue() const noexcept {
+  if (current_pool_ == this)
+    return current_queue_;
+  return queues_.size() - 1;
+}
+
+inline void ThreadPool::WakeWorkers(size_t count) {
+  {
+    // Taking the lock orders the wake-up after a worker's predicate check
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+  }
+  if (count >= workers_.size()) {
+    wake_.notify_all();
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      wake_.notify_one();
+    }
+  }
+}
+
+inline void ThreadPool::PinCurrentThread(uint32_t core) {
+#if defined(__linux__)
+  const uint32_t num_cores = std::max(1u, std::thread::hardware_concurrency());
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core % num_cores, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void)core;
+#endif
+}
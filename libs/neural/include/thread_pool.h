@@ -0,0 +1,125 @@
+// MIT License
+
+// Defines a persistent, work-stealing thread pool.
+// Workers are created once and shared by every parallel path (GEMM,
+// reductions, ...), so parallel operations only pay for queueing a few tasks
+// instead of creating and joining threads.
+//
+// Each thread owns a task queue. Threads pop their own queue from the back
+// (most recently split, cache-warm work first) and steal from the front of
+// other queues when they run dry. A thread waiting for its parallel loop to
+// finish keeps executing queued tasks, so nested ParallelFor calls are safe.
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_THREAD_POOL_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_THREAD_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadPoolOptions {
+  // Total number of threads executing work, including the thread that calls
+  // ParallelFor. 0 uses std::thread::hardware_concurrency().
+  uint32_t num_threads = 0;
+  // Upper bound on the threads a single parallel operation is split across.
+  // 0 uses every pool thread.
+  uint32_t max_parallelism = 0;
+  // Pins worker i to logical core i (Linux only, ignored elsewhere).
+  bool pin_threads = false;
+};
+
+class ThreadPool {
+ public:
+  explicit ThreadPool(const ThreadPoolOptions& options = ThreadPoolOptions());
+  // Finishes queued work and joins the workers.
+  ~ThreadPool();
+
+  // Not copyable or movable, workers hold a pointer to the pool.
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // The process-wide pool, created with default options on first use.
+  static ThreadPool& Global();
+  // Replaces the process-wide pool.
+  // Must not be called while parallel work is in flight.
+  static void ConfigureGlobal(const ThreadPoolOptions& options);
+
+  // Worker threads plus the calling thread.
+  uint32_t NumThreads() const noexcept;
+  // Maximum number of threads a single operation should be split across.
+  uint32_t MaxParallelism() const noexcept;
+
+  // Calls fn(chunk_begin, chunk_end) for disjoint chunks covering
+  // [begin, end), each at least grain elements long (except the last), and
+  // blocks until all chunks are done. The calling thread takes part.
+  template <typename Fn>
+  void ParallelFor(size_t begin, size_t end, size_t grain, Fn&& fn);
+
+ private:
+  // A chunk of a ParallelFor loop.
+  struct Task {
+    void (*run)(void* context, size_t begin, size_t end);
+    void* context;
+    size_t begin;
+    size_t end;
+    std::atomic<size_t>* pending;  // Chunks of the loop still running
+  };
+
+  // Bounded double-ended task queue. The owner pushes and pops at the back,
+  // thieves take from the front.
+  class WorkQueue {
+   public:
+    bool PushBack(const Task& task);
+    bool PopBack(Task& task);
+    bool PopFront(Task& task);
+
+   private:
+    static constexpr size_t kCapacity = 1024;
+    std::mutex mutex_;
+    std::array<Task, kCapacity> tasks_;
+    size_t head_ = 0;  // Index of the front task
+    size_t size_ = 0;
+  };
+
+  void WorkerLoop(uint32_t index);
+  // Runs one queued task, preferring the home queue. Returns false if every
+  // queue was empty.
+  bool TryRunOne(size_t home);
+  void RunTask(const Task& task);
+  // Queue used by the calling thread: its own for workers of this pool, the
+  // shared external queue for every other thread.
+  size_t HomeQueue() const noexcept;
+  void WakeWorkers(size_t count);
+
+  static void PinCurrentThread(uint32_t core);
+
+  uint32_t max_parallelism_;
+  // One queue per worker, plus a shared queue for external threads (last).
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
+  std::vector<std::jthread> workers_;
+
+  std::atomic<size_t> queued_tasks_{0};
+  // Bumped whenever a ParallelFor loop completes, waiters sleep on it
+  std::atomic<uint64_t> completion_epoch_{0};
+  std::atomic<bool> stop_{false};
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+
+  inline static std::atomic<ThreadPool*> global_pool_{nullptr};
+  inline static std::unique_ptr<ThreadPool> global_owner_;
+  inline static std::mutex global_mutex_;
+
+  inline static thread_local const ThreadPool* current_pool_ = nullptr;
+  inline static thread_local size_t current_queue_ = 0;
+};
+
+#include "thread_pool-inl.h"
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_THREAD_POOL_H_
@@ -0,0 +1,47 @@
+// MIT License
+
+// Defines the memory plan of the buffers a network keeps for training.
+// NeuralNetwork::PlanWorkspace reserves every activation, gradient and
+// scratch buffer of the layer stack for a maximum batch size at once and
+// lists them here. A training step keeps all of them live (activations are
+// held from the forward pass until the backward pass of their layer, and
+// every buffer is reused by the next step), so their sum is the peak
+// training memory besides the parameters, the GEMM packing scratch and the
+// batch buffers of the input stage (BatchPrefetcher).
+
+#ifndef MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_WORKSPACE_PLAN_H_
+#define MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_WORKSPACE_PLAN_H_
+
+#include <cstddef>
+
+#include <limits>
+#include <vector>
+
+// One reserved buffer.
+struct WorkspaceBuffer {
+  // Layer value of the buffers owned by the network itself
+  static constexpr size_t kNetwork = std::numeric_limits<size_t>::max();
+
+  // Index of the owning layer, or kNetwork
+  size_t layer = kNetwork;
+  // Member the buffer is held in, e.g. "output" or "grad_input"
+  const char* name = "";
+  // Reserved storage
+  size_t bytes = 0;
+};
+
+struct WorkspacePlan {
+  size_t max_batch_size = 0;
+  std::vector<WorkspaceBuffer> buffers;
+
+  // Sum of the buffers, the peak workspace memory of a training step
+  size_t TotalBytes() const {
+    size_t total = 0;
+    for (const WorkspaceBuffer& buffer : buffers) {
+      total += buffer.bytes;
+    }
+    return total;
+  }
+};
+
+#endif  // MNIST_DIGIT_RECOGNITION_LIBS_NEURAL_WORKSPACE_PLAN_H_
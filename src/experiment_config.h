@@ -57,6 +57,30 @@ struct ExperimentConfig {
   // Data processing
   float normalization_factor = 1.0f / 255.0f;
   size_t num_classes = 10;
+
+  // Threading
+  // Threads a single matrix operation may use (0 uses the whole pool)
+  uint32_t num_threads = 0;
+  // Overrides the size of the shared thread pool (0 uses one thread per core)
+  uint32_t thread_pool_size = 0;
+  // Pins pool threads to cores (Linux only)
+  bool pin_threads = false;
+  // Replicas trained in parallel on shards of every batch (see
+  // DataParallelTrainer). 1 trains the network alone, 0 uses one replica
+  // per thread a matrix operation may use.
+  uint32_t data_parallel_replicas = 1;
+  // Workers training asynchronously on shared weights (see HogwildTrainer),
+  // 0 disables. Takes precedence over data_parallel_replicas.
+  uint32_t hogwild_workers = 0;
+  // Host-specific thresholds written by the "calibrate" mode and loaded at
+  // startup by the other modes (defaults are used if the file is missing)
+  std::filesystem::path parallel_profile_path =
+      (base_path / "parallel_profile.txt");
+
+  // Memory
+  // Advises matrices and datasets of 2 MB or more to use transparent huge
+  // pages (Linux only)
+  bool huge_pages = true;
 };
 
 #endif  // MNIST_DIGIT_RECOGNITION_SRC_EXPERIMENT_CONFIG_H_
\ No newline at end of file
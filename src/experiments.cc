@@ -5,17 +5,55 @@
 #include <chrono>
 #include <filesystem>
 #include <iostream>
+#include <utility>
 
+#include "aligned_allocator.h"
+#include "calibration.h"
+#include "confusion_matrix.h"
+#include "data_parallel_trainer.h"
+#include "hogwild_trainer.h"
 #include "linear_layer.h"
 #include "matrix.h"
 #include "mnist_loader.h"
 #include "model_serializer.h"
 #include "neural_network.h"
 #include "relu_layer.h"
+#include "thread_pool.h"
+
+namespace {
+// Sets up the shared thread pool used by the matrix operations, applies the
+// calibrated profile of this host, if there is one, and the memory policy.
+void ConfigureRuntime(const ExperimentConfig& config) {
+  Memory::SetHugePagesEnabled(config.huge_pages);
+
+  ParallelProfile profile;
+  if (std::filesystem::exists(config.parallel_profile_path)) {
+    auto result = Calibration::Load(config.parallel_profile_path.string());
+    if (result.ok()) {
+      profile = *result;
+      Calibration::Apply(profile);
+      std::cout << "Loaded parallel profile from "
+                << config.parallel_profile_path.string() << "\n";
+    } else {
+      std::cerr << "[Warning] - Ignoring parallel profile: "
+                << result.status().message() << "\n";
+    }
+  }
+
+  ThreadPoolOptions options;
+  options.num_threads = config.thread_pool_size;
+  // An explicit thread count in the config wins over the calibrated one
+  options.max_parallelism =
+      config.num_threads != 0 ? config.num_threads : profile.max_parallelism;
+  options.pin_threads = config.pin_threads;
+  ThreadPool::ConfigureGlobal(options);
+}
+}  // namespace
 
 void RunTrainingMode(const ExperimentConfig& config) {
   using Fp = float;
   std::cout << "[EXPERIMENT] - TRAINING\n";
+  ConfigureRuntime(config);
 
   // Load data
   std::cout << "[1/4] - Loading train & test dataset...\n";
@@ -26,21 +64,24 @@ void RunTrainingMode(const ExperimentConfig& config) {
       loader.Load(config.test_images_path, config.test_labels_path);
 
   // Prepare data
-  Matrix<uint8_t> raw_train_images(raw_train_images_vec,
-                                   raw_train_images_vec.size() / 784, 784);
-  Matrix<uint8_t> raw_train_labels(raw_train_labels_vec,
-                                   raw_train_labels_vec.size(), 1);
-
-  Matrix<uint8_t> raw_test_images(raw_test_images_vec,
-                                  raw_test_images_vec.size() / 784, 784);
-  Matrix<uint8_t> raw_test_labels(raw_test_labels_vec,
-                                  raw_test_labels_vec.size(), 1);
-
-  Matrix<Fp> x_train = raw_train_images.ToFloat(config.normalization_factor);
+  // The loaded buffers are moved in (the loader checks the counts match)
+  const size_t num_train = raw_train_labels_vec.size();
+  Matrix<uint8_t> raw_train_images(std::move(raw_train_images_vec),
+                                   num_train, 784);
+  Matrix<uint8_t> raw_train_labels(std::move(raw_train_labels_vec),
+                                   num_train, 1);
+
+  const size_t num_test = raw_test_labels_vec.size();
+  Matrix<uint8_t> raw_test_images(std::move(raw_test_images_vec), num_test,
+                                  784);
+  Matrix<uint8_t> raw_test_labels(std::move(raw_test_labels_vec), num_test,
+                                  1);
+
+  // The images stay raw bytes, a quarter of their float size: the trainers
+  // convert and normalize every batch as they gather it
+  const Fp input_scale = config.normalization_factor;
   Matrix<Fp> y_train =
       Matrix<Fp>::OneHotEncode(raw_train_labels.ToFloat(), config.num_classes);
-
-  Matrix<Fp> x_test = raw_test_images.ToFloat(config.normalization_factor);
   Matrix<Fp> y_test =
       Matrix<Fp>::OneHotEncode(raw_test_labels.ToFloat(), config.num_classes);
 
@@ -55,9 +96,16 @@ void RunTrainingMode(const ExperimentConfig& config) {
 
   // Save policy
   float best_accuracy = 0.0f;
+  std::chrono::steady_clock::time_point start;
 
-  auto save_policy = [&network, &config, &best_accuracy](
+  auto save_policy = [&network, &config, &best_accuracy, &start](
                          uint32_t epoch, float current_accuracy) {
+    // Time to accuracy, to compare the trainers
+    const double elapsed = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    std::cout << "  Epoch " << epoch + 1 << ": " << current_accuracy * 100.0f
+              << "% test accuracy after " << elapsed << "s\n";
     if (current_accuracy > best_accuracy) {
       best_accuracy = current_accuracy;
       absl::Status status = ModelSerializer::Save(
@@ -75,10 +123,23 @@ void RunTrainingMode(const ExperimentConfig& config) {
   // Train
   std::cout << "[3/4] - Starting Training (" << config.epochs
             << " epochs)...\n";
-  auto start = std::chrono::steady_clock::now();
-
-  network.Train(x_train, y_train, x_test, y_test, config.epochs,
-                config.batch_size, save_policy);
+  start = std::chrono::steady_clock::now();
+
+  if (config.hogwild_workers != 0) {
+    HogwildTrainer<Fp> trainer(network, config.hogwild_workers);
+    std::cout << "  Hogwild with " << trainer.NumWorkers() << " workers\n";
+    trainer.Train(raw_train_images, y_train, raw_test_images, y_test,
+                  config.epochs, config.batch_size, save_policy, input_scale);
+  } else if (config.data_parallel_replicas == 1) {
+    network.Train(raw_train_images, y_train, raw_test_images, y_test,
+                  config.epochs, config.batch_size, save_policy, input_scale);
+  } else {
+    DataParallelTrainer<Fp> trainer(network, config.data_parallel_replicas);
+    std::cout << "  Data-parallel with " << trainer.NumReplicas()
+              << " replicas\n";
+    trainer.Train(raw_train_images, y_train, raw_test_images, y_test,
+                  config.epochs, config.batch_size, save_policy, input_scale);
+  }
 
   auto end = std::chrono::steady_clock::now();
   auto seconds =
@@ -91,6 +152,7 @@ void RunTrainingMode(const ExperimentConfig& config) {
 void RunInferenceMode(const ExperimentConfig& config) {
   using Fp = float;
   std::cout << "[EXPERIMENT] - INFERENCE\n";
+  ConfigureRuntime(config);
 
   // Load data (only test data)
   std::cout << "[1/3] - Loading test dataset...\n";
@@ -99,12 +161,12 @@ void RunInferenceMode(const ExperimentConfig& config) {
       loader.Load(config.test_images_path, config.test_labels_path);
 
   // Prepare data
-  Matrix<uint8_t> raw_test_images(raw_test_images_vec,
-                                  raw_test_images_vec.size() / 784, 784);
-  Matrix<uint8_t> raw_test_labels(raw_test_labels_vec,
-                                  raw_test_labels_vec.size(), 1);
+  const size_t num_test = raw_test_labels_vec.size();
+  Matrix<uint8_t> raw_test_images(std::move(raw_test_images_vec), num_test,
+                                  784);
+  Matrix<uint8_t> raw_test_labels(std::move(raw_test_labels_vec), num_test,
+                                  1);
 
-  Matrix<Fp> x_test = raw_test_images.ToFloat(config.normalization_factor);
   Matrix<Fp> y_test =
       Matrix<Fp>::OneHotEncode(raw_test_labels.ToFloat(), config.num_classes);
 
@@ -122,9 +184,47 @@ void RunInferenceMode(const ExperimentConfig& config) {
 
   // Evaluate
   std::cout << "[3/3] - Evaluating...\n";
-  float accuracy = network.EvaluateAccuracy(x_test, y_test);
+  ConfusionMatrix confusion = network.Evaluate(
+      raw_test_images, y_test, config.normalization_factor);
 
   std::cout << "------------------------------------------\n";
-  std::cout << "FINAL TEST ACCURACY: " << (accuracy * 100.0f) << "%\n";
+  std::cout << "FINAL TEST ACCURACY: " << (confusion.Accuracy() * 100.0f)
+            << "%\n";
+  for (size_t digit = 0; digit < confusion.NumClasses(); ++digit) {
+    std::cout << "  Digit " << digit << ": "
+              << (confusion.ClassAccuracy(digit) * 100.0f) << "%\n";
+  }
   std::cout << "------------------------------------------\n";
 }
+
+void RunCalibrationMode(const ExperimentConfig& config) {
+  std::cout << "[EXPERIMENT] - CALIBRATION\n";
+
+  // Calibrate against every thread the pool may get
+  ThreadPoolOptions options;
+  options.num_threads = config.thread_pool_size;
+  options.pin_threads = config.pin_threads;
+  ThreadPool::ConfigureGlobal(options);
+  ThreadPool& pool = ThreadPool::Global();
+
+  std::cout << "[1/2] - Measuring on " << pool.NumThreads()
+            << " threads...\n";
+  CalibrationOptions calibration_options;
+  calibration_options.batch_size = config.batch_size;
+  ParallelProfile profile = Calibration::Run(pool, calibration_options);
+
+  std::cout << "  Min work per thread: " << profile.min_work_per_thread
+            << "\n  Max parallelism: " << profile.max_parallelism
+            << "\n  GEMM blocks (float): mc=" << profile.float_blocks.mc
+            << " kc=" << profile.float_blocks.kc
+            << " nc=" << profile.float_blocks.nc << "\n";
+
+  std::cout << "[2/2] - Saving profile to "
+            << config.parallel_profile_path.string() << "...\n";
+  absl::Status status =
+      Calibration::Save(profile, config.parallel_profile_path.string());
+  if (!status.ok()) {
+    std::cerr << "[Fatal] - Failed to save profile: " << status.message()
+              << "\n";
+  }
+}
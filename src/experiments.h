@@ -12,4 +12,8 @@ void RunTrainingMode(const ExperimentConfig& config);
 // Loads an existing model and evaluates it on the test set.
 void RunInferenceMode(const ExperimentConfig& config);
 
+// Measures the parallelism thresholds of this host and saves them to
+// config.parallel_profile_path.
+void RunCalibrationMode(const ExperimentConfig& config);
+
 #endif  // MNIST_DIGIT_RECOGNITION_SRC_EXPERIMENTS_H
@@ -17,15 +17,19 @@ int main() {
   // Select the mode to run
   // "train" trains a new model from scratch with the config values
   // "test" loads the pretrained model and evaluates it on the test dataset
+  // "calibrate" measures the parallelism thresholds of this machine, which
+  // the other modes load at startup
   std::string mode = "test";
 
   if (mode == "train") {
     RunTrainingMode(config);
   } else if (mode == "test") {
     RunInferenceMode(config);
+  } else if (mode == "calibrate") {
+    RunCalibrationMode(config);
   } else {
     std::cerr << "Unknown mode: " << mode
-              << "\nAvailable modes are: train | test\n";
+              << "\nAvailable modes are: train | test | calibrate\n";
     return 1;
   }
 
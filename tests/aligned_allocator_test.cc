@@ -0,0 +1,66 @@
+// MIT License
+
+#include "aligned_allocator.h"
+
+#include <cstdint>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "matrix.h"
+
+namespace {
+bool IsAligned(const void* pointer, size_t alignment) {
+  return reinterpret_cast<uintptr_t>(pointer) % alignment == 0;
+}
+}  // namespace
+
+TEST(AlignedAllocator, AlignsSmallBuffersToCacheLines) {
+  // Arrange & Act
+  Memory::AlignedVector<uint8_t> bytes(3);
+  Memory::AlignedVector<double> doubles(100);
+  // Assert
+  EXPECT_TRUE(IsAligned(bytes.data(), Memory::kAlignment));
+  EXPECT_TRUE(IsAligned(doubles.data(), Memory::kAlignment));
+}
+
+TEST(AlignedAllocator, AlignsLargeBuffersToHugePages) {
+  // Arrange & Act
+  Memory::AlignedVector<float> large(Memory::kHugePageSize / sizeof(float) +
+                                     1);
+  // Assert
+  EXPECT_TRUE(IsAligned(large.data(), Memory::kHugePageSize));
+}
+
+TEST(AlignedAllocator, WorksWithHugePagesDisabled) {
+  // Arrange
+  Memory::SetHugePagesEnabled(false);
+  // Act
+  Memory::AlignedVector<uint8_t> large(Memory::kHugePageSize * 2, 7);
+  Memory::SetHugePagesEnabled(true);
+  // Assert
+  EXPECT_TRUE(IsAligned(large.data(), Memory::kHugePageSize));
+  EXPECT_EQ(large.back(), 7);
+}
+
+TEST(AlignedAllocator, BacksMatrixStorage) {
+  // Arrange & Act
+  Matrix<float> small(3, 5);
+  Matrix<float> copy = small;
+  Matrix<float> transposed = small.GetTranspose();
+  // Assert
+  EXPECT_TRUE(IsAligned(small.ToVector().data(), Memory::kAlignment));
+  EXPECT_TRUE(IsAligned(copy.ToVector().data(), Memory::kAlignment));
+  EXPECT_TRUE(IsAligned(transposed.ToVector().data(), Memory::kAlignment));
+}
+
+TEST(AlignedAllocator, MatrixTakesOverStorageWithoutCopying) {
+  // Arrange
+  Matrix<uint8_t>::Storage pixels(6, 1);
+  const uint8_t* buffer = pixels.data();
+  // Act
+  Matrix<uint8_t> mat(std::move(pixels), 2, 3);
+  // Assert
+  EXPECT_EQ(mat.ToVector().data(), buffer);
+  EXPECT_EQ(mat(1, 2), 1);
+}
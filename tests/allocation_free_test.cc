@@ -0,0 +1,113 @@
+// MIT License
+
+// Checks that steady-state training and inference steps make no heap
+// allocations. The global operator new is replaced to count them, so these
+// tests run in a binary of their own (see CMakeLists.txt) and no other suite
+// runs on this heap.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#include <gtest/gtest.h>
+
+#include "matrix.h"
+#include "neural_network.h"
+#include "test_networks.h"
+
+namespace {
+std::atomic<uint64_t> allocation_count{0};
+}  // namespace
+
+// Every replacement allocates with malloc or aligned_alloc, and every
+// delete releases with free, which is the matching call for both. They are
+// kept out of line: inlined into new- and delete-expressions, GCC would see
+// free called on a pointer from new, or delete on one from malloc
+// (-Wmismatched-new-delete).
+[[gnu::noinline]] void* operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* pointer = std::malloc(size == 0 ? 1 : size))
+    return pointer;
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void* operator new(std::size_t size,
+                                     std::align_val_t alignment) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  const std::size_t align = static_cast<std::size_t>(alignment);
+  const std::size_t rounded = (size + align - 1) / align * align;
+  if (void* pointer = std::aligned_alloc(align, rounded == 0 ? align : rounded))
+    return pointer;
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+[[gnu::noinline]] void operator delete(void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+[[gnu::noinline]] void operator delete(void* pointer,
+                                       std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+[[gnu::noinline]] void operator delete(void* pointer, std::size_t,
+                                       std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+using test_networks::Labels;
+using test_networks::SmallNetwork;
+
+TEST(NeuralNetworkTrainStep, MakesNoHeapAllocationsInSteadyState) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> network = SmallNetwork();
+  Matrix<float> data = Matrix<float>::Random(8, 16, -1.0f, 1.0f, 7);
+  Matrix<float> labels = Labels(8);
+  (void)network->TrainStep(data, labels);  // Grows the buffers
+  // Act
+  const uint64_t before = allocation_count.load();
+  for (int step = 0; step < 10; ++step) {
+    (void)network->TrainStep(data, labels);
+  }
+  const uint64_t allocations = allocation_count.load() - before;
+  // Assert
+  EXPECT_EQ(allocations, 0);
+}
+
+TEST(NeuralNetworkPlanWorkspace, GrowsNoBufferUpToThePlannedSize) {
+  // Arrange: a step of another network warms up the per-thread GEMM
+  // scratch, which the plan does not cover
+  Matrix<float> data = Matrix<float>::Random(8, 16, -1.0f, 1.0f, 7);
+  Matrix<float> labels = Labels(8);
+  (void)SmallNetwork()->TrainStep(data, labels);
+  std::unique_ptr<NeuralNetwork<float>> network = SmallNetwork();
+  (void)network->PlanWorkspace(8, 16);
+  // Act: a smaller batch first, then the planned size
+  const uint64_t before = allocation_count.load();
+  (void)network->TrainStep(data.RowRange(0, 3), labels.RowRange(0, 3));
+  (void)network->TrainStep(data, labels);
+  const uint64_t allocations = allocation_count.load() - before;
+  // Assert
+  EXPECT_EQ(allocations, 0);
+}
+
+TEST(NeuralNetworkInfer, MakesNoHeapAllocationsInSteadyState) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> network = SmallNetwork();
+  Matrix<float> data = Matrix<float>::Random(8, 16, -1.0f, 1.0f, 7);
+  (void)network->Infer(data);  // Grows the buffers
+  // Act
+  const uint64_t before = allocation_count.load();
+  for (int call = 0; call < 10; ++call) {
+    (void)network->Infer(data);
+  }
+  const uint64_t allocations = allocation_count.load() - before;
+  // Assert
+  EXPECT_EQ(allocations, 0);
+}
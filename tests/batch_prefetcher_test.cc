@@ -0,0 +1,133 @@
+// MIT License
+
+#include "batch_prefetcher.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "batch_sampler.h"
+#include "matrix.h"
+
+namespace {
+
+// Fills a 1 x 1 batch holding its index, and labels holding twice of it
+void FillIndex(size_t batch, Matrix<float>& data, Matrix<float>& labels) {
+  data.Resize(1, 1);
+  data(0, 0) = static_cast<float>(batch);
+  labels.Resize(1, 1);
+  labels(0, 0) = static_cast<float>(2 * batch);
+}
+
+// Waits until the producer has filled count batches ahead
+void WaitForReady(const BatchPrefetcher<float>& prefetcher, size_t count) {
+  while (prefetcher.Ready() < count) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+}  // namespace
+
+TEST(BatchPrefetcher, ReturnsTheBatchesOfEveryEpochInOrder) {
+  // Arrange
+  BatchPrefetcher<float> prefetcher(2);
+  std::vector<float> seen;
+  // Act
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    prefetcher.Start(5, FillIndex);
+    for (int batch = 0; batch < 5; ++batch) {
+      const auto& next = prefetcher.Next();
+      EXPECT_EQ(next.labels(0, 0), 2.0f * next.data(0, 0));
+      seen.push_back(next.data(0, 0));
+    }
+  }
+  // Assert
+  ASSERT_EQ(seen.size(), 15);
+  for (size_t i = 0; i < seen.size(); ++i) {
+    EXPECT_EQ(seen[i], static_cast<float>(i % 5));
+  }
+  EXPECT_EQ(prefetcher.Stats().batches, 5);
+}
+
+TEST(BatchPrefetcher, GathersTheSameBatchesAsTheSampler) {
+  // Arrange
+  Matrix<float> data = Matrix<float>::Random(10, 3, -1.0f, 1.0f, 7);
+  Matrix<float> labels = Matrix<float>::Random(10, 2, -1.0f, 1.0f, 8);
+  BatchSampler sampler(10, 4);
+  sampler.Shuffle(3);
+  BatchPrefetcher<float> prefetcher;
+  prefetcher.Reserve(4, 3, 2);
+  Matrix<float> expected_data;
+  Matrix<float> expected_labels;
+  // Act
+  prefetcher.Start(sampler.NumBatches(),
+                   [&](size_t batch, Matrix<float>& data_buffer,
+                       Matrix<float>& labels_buffer) {
+                     sampler.Gather(batch, data, data_buffer);
+                     sampler.Gather(batch, labels, labels_buffer);
+                   });
+  // Assert
+  for (size_t batch = 0; batch < sampler.NumBatches(); ++batch) {
+    const auto& next = prefetcher.Next();
+    sampler.Gather(batch, data, expected_data);
+    sampler.Gather(batch, labels, expected_labels);
+    EXPECT_EQ(next.data.Rows(), expected_data.Rows());
+    EXPECT_EQ(next.data.ToVector(), expected_data.ToVector());
+    EXPECT_EQ(next.labels.ToVector(), expected_labels.ToVector());
+  }
+}
+
+TEST(BatchPrefetcher, FillsAheadUpToTheDepth) {
+  // Arrange
+  BatchPrefetcher<float> prefetcher(2);
+  std::atomic<size_t> fills{0};
+  // Act
+  prefetcher.Start(6, [&](size_t batch, Matrix<float>& data,
+                          Matrix<float>& labels) {
+    FillIndex(batch, data, labels);
+    fills.fetch_add(1);
+  });
+  WaitForReady(prefetcher, 2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  const size_t fills_before_next = fills.load();
+  EXPECT_EQ(prefetcher.Next().data(0, 0), 0.0f);
+  WaitForReady(prefetcher, 2);
+  // Assert: the producer stopped two batches ahead until Next freed a
+  // buffer
+  EXPECT_EQ(fills_before_next, 2);
+  EXPECT_EQ(fills.load(), 3);
+  for (float batch = 1.0f; batch < 6.0f; ++batch) {
+    EXPECT_EQ(prefetcher.Next().data(0, 0), batch);
+  }
+  const PrefetchStats stats = prefetcher.Stats();
+  EXPECT_EQ(stats.batches, 6);
+  EXPECT_GE(stats.MeanQueueDepth(), 4.0 / 6.0);
+  EXPECT_LE(stats.MeanQueueDepth(), 2.0);
+}
+
+TEST(BatchPrefetcher, CountsTheStallsOfASlowProducer) {
+  // Arrange
+  BatchPrefetcher<float> prefetcher(2);
+  // Act
+  prefetcher.Start(4, [](size_t batch, Matrix<float>& data,
+                         Matrix<float>& labels) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    FillIndex(batch, data, labels);
+  });
+  // The consumer asks right away and cannot be ahead of the first batch
+  (void)prefetcher.Next();
+  const PrefetchStats first = prefetcher.Stats();
+  for (int batch = 1; batch < 4; ++batch) {
+    (void)prefetcher.Next();
+  }
+  // Assert
+  EXPECT_EQ(first.stalls, 1);
+  EXPECT_EQ(first.ready_sum, 0);
+  EXPECT_GT(first.stall_seconds, 0.0);
+  const PrefetchStats stats = prefetcher.Stats();
+  EXPECT_GE(stats.stalls, 1);
+  EXPECT_GE(stats.fill_seconds, 0.015);
+}
@@ -0,0 +1,73 @@
+// MIT License
+
+#include "batch_sampler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "matrix.h"
+
+TEST(BatchSampler, SplitsSamplesIntoBatches) {
+  // Arrange & Act
+  BatchSampler sampler(10, 4);
+  // Assert
+  EXPECT_EQ(sampler.NumSamples(), 10);
+  EXPECT_EQ(sampler.NumBatches(), 3);
+  EXPECT_EQ(sampler.BatchIndices(0).size(), 4);
+  EXPECT_EQ(sampler.BatchIndices(2).size(), 2);
+  EXPECT_EQ(sampler.BatchIndices(2)[1], 9);
+}
+
+TEST(BatchSampler, ShuffleDrawsAPermutation) {
+  // Arrange
+  BatchSampler sampler(100, 7);
+  // Act
+  sampler.Shuffle(3);
+  std::vector<size_t> order;
+  for (size_t batch = 0; batch < sampler.NumBatches(); ++batch) {
+    for (size_t index : sampler.BatchIndices(batch)) {
+      order.push_back(index);
+    }
+  }
+  // Assert
+  std::vector<size_t> sorted = order;
+  std::sort(sorted.begin(), sorted.end());
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    EXPECT_EQ(sorted[i], i);
+  }
+  EXPECT_FALSE(std::is_sorted(order.begin(), order.end()));
+}
+
+TEST(BatchSampler, OrderDependsOnlyOnTheSeed) {
+  // Arrange
+  BatchSampler first(50, 50);
+  BatchSampler second(50, 50);
+  // Act
+  first.Shuffle(1);
+  first.Shuffle(9);
+  second.Shuffle(9);
+  // Assert
+  EXPECT_TRUE(std::ranges::equal(first.BatchIndices(0),
+                                 second.BatchIndices(0)));
+}
+
+TEST(BatchSampler, GathersTheSameRowsAsShuffleRows) {
+  // Arrange
+  Matrix<float> data = Matrix<float>::Random(23, 5, -1.0f, 1.0f, 11);
+  Matrix<float> shuffled = data.ShuffleRows(42);
+  BatchSampler sampler(data.Rows(), 8);
+  Matrix<float> batch;
+  // Act
+  sampler.Shuffle(42);
+  sampler.Gather(2, data, batch);
+  // Assert
+  ASSERT_EQ(batch.Rows(), 7);
+  ASSERT_EQ(batch.Cols(), 5);
+  for (size_t r = 0; r < batch.Rows(); ++r) {
+    for (size_t c = 0; c < batch.Cols(); ++c) {
+      EXPECT_EQ(batch(r, c), shuffled(16 + r, c));
+    }
+  }
+}
@@ -0,0 +1,98 @@
+// MIT License
+
+#include "calibration.h"
+
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "matrix.h"
+#include "thread_pool.h"
+
+namespace {
+std::string TempPath(const std::string& name) {
+  return ::testing::TempDir() + name;
+}
+}  // namespace
+
+TEST(CalibrationProfile, SaveThenLoadRoundTrips) {
+  // Arrange
+  ParallelProfile profile;
+  profile.min_work_per_thread = 262144;
+  profile.max_parallelism = 12;
+  profile.float_blocks = Gemm::BlockSizes{96, 256, 2048};
+  std::string path = TempPath("round_trip_profile.txt");
+
+  // Act
+  absl::Status status = Calibration::Save(profile, path);
+  auto loaded = Calibration::Load(path);
+
+  // Assert
+  ASSERT_TRUE(status.ok()) << status.message();
+  ASSERT_TRUE(loaded.ok()) << loaded.status().message();
+  EXPECT_EQ(loaded->min_work_per_thread, 262144);
+  EXPECT_EQ(loaded->max_parallelism, 12);
+  EXPECT_EQ(loaded->float_blocks.mc, 96);
+  EXPECT_EQ(loaded->float_blocks.kc, 256);
+  EXPECT_EQ(loaded->float_blocks.nc, 2048);
+}
+
+TEST(CalibrationProfile, LoadRejectsUnknownKeys) {
+  std::string path = TempPath("unknown_key_profile.txt");
+  std::ofstream(path) << "min_work_per_thread 100\nthreads_per_core 2\n";
+  auto loaded = Calibration::Load(path);
+  EXPECT_EQ(loaded.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
+TEST(CalibrationProfile, LoadRejectsZeroThreshold) {
+  std::string path = TempPath("zero_profile.txt");
+  std::ofstream(path) << "min_work_per_thread 0\n";
+  auto loaded = Calibration::Load(path);
+  EXPECT_EQ(loaded.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
+TEST(CalibrationProfile, LoadFailsForMissingFile) {
+  auto loaded = Calibration::Load(TempPath("does_not_exist_profile.txt"));
+  EXPECT_EQ(loaded.status().code(), absl::StatusCode::kUnavailable);
+}
+
+TEST(CalibrationApply, InstallsThresholdAndBlocks) {
+  // Arrange
+  uint64_t original_threshold = Matrix<float>::kMinWorkPerThread;
+  Gemm::BlockSizes original_blocks = Gemm::DefaultBlockSizes<float>();
+  ParallelProfile profile;
+  profile.min_work_per_thread = 4096;
+  profile.float_blocks = Gemm::BlockSizes{48, 128, 512};
+
+  // Act
+  Calibration::Apply(profile);
+  uint64_t applied_threshold = Matrix<float>::kMinWorkPerThread;
+  Gemm::BlockSizes applied_blocks = Gemm::DefaultBlockSizes<float>();
+  Matrix<float>::kMinWorkPerThread = original_threshold;
+  Matrix<double>::kMinWorkPerThread = original_threshold;
+  Gemm::SetDefaultBlockSizes<float>(original_blocks);
+
+  // Assert
+  EXPECT_EQ(applied_threshold, 4096);
+  EXPECT_EQ(applied_blocks.mc, 48);
+  EXPECT_EQ(applied_blocks.kc, 128);
+  EXPECT_EQ(applied_blocks.nc, 512);
+}
+
+TEST(CalibrationRun, ProducesUsableProfile) {
+  // Arrange
+  ThreadPool pool(ThreadPoolOptions{2, 0, false});
+  CalibrationOptions options;
+  options.seconds_per_measurement = 0.0;  // One timed call per configuration
+
+  // Act
+  ParallelProfile profile = Calibration::Run(pool, options);
+
+  // Assert
+  EXPECT_GT(profile.min_work_per_thread, 0);
+  EXPECT_GE(profile.max_parallelism, 1);
+  EXPECT_LE(profile.max_parallelism, 2);
+  EXPECT_EQ(profile.float_blocks.mc % Gemm::KernelShape<float>::kMr, 0);
+  EXPECT_EQ(profile.float_blocks.nc % Gemm::KernelShape<float>::kNr, 0);
+}
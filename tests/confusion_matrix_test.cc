@@ -0,0 +1,47 @@
+// MIT License
+
+#include "confusion_matrix.h"
+
+#include <gtest/gtest.h>
+
+TEST(ConfusionMatrix, CountsPredictionsByTrueClass) {
+  // Arrange
+  ConfusionMatrix confusion(3);
+  // Act
+  confusion.Add(0, 0);
+  confusion.Add(0, 2);
+  confusion.Add(1, 1);
+  confusion.Add(2, 2);
+  // Assert
+  EXPECT_EQ(confusion.Samples(), 4);
+  EXPECT_EQ(confusion.Correct(), 3);
+  EXPECT_EQ(confusion.Count(0, 2), 1);
+  EXPECT_EQ(confusion.Count(2, 0), 0);
+  EXPECT_FLOAT_EQ(confusion.Accuracy(), 0.75f);
+  EXPECT_FLOAT_EQ(confusion.ClassAccuracy(0), 0.5f);
+  EXPECT_FLOAT_EQ(confusion.ClassAccuracy(1), 1.0f);
+}
+
+TEST(ConfusionMatrix, MergesPartialCounts) {
+  // Arrange
+  ConfusionMatrix first(2);
+  ConfusionMatrix second(2);
+  first.Add(0, 1);
+  second.Add(0, 1);
+  second.Add(1, 1);
+  // Act
+  first.Merge(second);
+  // Assert
+  EXPECT_EQ(first.Samples(), 3);
+  EXPECT_EQ(first.Count(0, 1), 2);
+  EXPECT_EQ(first.Count(1, 1), 1);
+}
+
+TEST(ConfusionMatrix, ReportsZeroAccuracyWithoutSamples) {
+  // Arrange
+  ConfusionMatrix confusion(2);
+  confusion.Add(0, 0);
+  // Act & Assert
+  EXPECT_FLOAT_EQ(confusion.ClassAccuracy(1), 0.0f);
+  EXPECT_FLOAT_EQ(ConfusionMatrix(2).Accuracy(), 0.0f);
+}
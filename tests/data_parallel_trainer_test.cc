@@ -0,0 +1,89 @@
+// MIT License
+
+#include "data_parallel_trainer.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "linear_layer.h"
+#include "matrix.h"
+#include "neural_network.h"
+#include "relu_layer.h"
+#include "test_networks.h"
+
+using test_networks::ExpectNear;
+using test_networks::Labels;
+using test_networks::SmallNetwork;
+
+TEST(DataParallelTrainer, MatchesTrainingOnTheWholeBatch) {
+  // Arrange: 10 rows split into uneven shards of 3, 2, 3 and 2 rows
+  std::unique_ptr<NeuralNetwork<float>> single = SmallNetwork();
+  std::unique_ptr<NeuralNetwork<float>> parallel = SmallNetwork();
+  DataParallelTrainer<float> trainer(*parallel, 4);
+  Matrix<float> data = Matrix<float>::Random(10, 16, -1.0f, 1.0f, 7);
+  Matrix<float> labels = Labels(10);
+  // Act
+  std::vector<float> single_losses;
+  std::vector<float> parallel_losses;
+  for (int step = 0; step < 5; ++step) {
+    single_losses.push_back(single->TrainStep(data, labels));
+    parallel_losses.push_back(trainer.TrainStep(data, labels));
+  }
+  // Assert
+  EXPECT_EQ(trainer.NumReplicas(), 4);
+  for (int step = 0; step < 5; ++step) {
+    EXPECT_NEAR(parallel_losses[step], single_losses[step], 1e-5f);
+  }
+  ExpectNear(parallel->Forward(data), single->Forward(data));
+}
+
+TEST(DataParallelTrainer, IsDeterministicForAFixedReplicaCount) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> first = SmallNetwork();
+  std::unique_ptr<NeuralNetwork<float>> second = SmallNetwork();
+  DataParallelTrainer<float> first_trainer(*first, 3);
+  DataParallelTrainer<float> second_trainer(*second, 3);
+  Matrix<float> data = Matrix<float>::Random(11, 16, -1.0f, 1.0f, 7);
+  Matrix<float> labels = Labels(11);
+  // Act
+  for (int step = 0; step < 5; ++step) {
+    (void)first_trainer.TrainStep(data, labels);
+    (void)second_trainer.TrainStep(data, labels);
+  }
+  // Assert
+  EXPECT_EQ(first->Forward(data).ToVector(),
+            second->Forward(data).ToVector());
+}
+
+TEST(DataParallelTrainer, LeavesReplicasIdleOnBatchesSmallerThanTheCount) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> single = SmallNetwork();
+  std::unique_ptr<NeuralNetwork<float>> parallel = SmallNetwork();
+  DataParallelTrainer<float> trainer(*parallel, 4);
+  Matrix<float> data = Matrix<float>::Random(10, 16, -1.0f, 1.0f, 7);
+  Matrix<float> labels = Labels(10);
+  // Act: the idle replicas must still apply the update, as the full batch
+  // that follows shows
+  (void)single->TrainStep(data.RowRange(0, 2), labels.RowRange(0, 2));
+  (void)trainer.TrainStep(data.RowRange(0, 2), labels.RowRange(0, 2));
+  float single_loss = single->TrainStep(data, labels);
+  float parallel_loss = trainer.TrainStep(data, labels);
+  // Assert
+  EXPECT_NEAR(parallel_loss, single_loss, 1e-5f);
+  ExpectNear(parallel->Forward(data), single->Forward(data));
+}
+
+TEST(LinearLayerClone, CopiesTheParametersButNotTheTrainingState) {
+  // Arrange
+  LinearLayer<float> layer(3, 2, 0.5f, 42);
+  Matrix<float> input = Matrix<float>::Random(4, 3, -1.0f, 1.0f, 7);
+  Matrix<float> expected = layer.Forward(input);
+  // Act
+  std::unique_ptr<NeuralLayer<float>> clone = layer.Clone();
+  // Assert
+  EXPECT_EQ(clone->Forward(input).ToVector(), expected.ToVector());
+  EXPECT_EQ(clone->Gradients().size(), (3 + 1) * 2);
+  EXPECT_EQ(static_cast<LinearLayer<float>&>(*clone).GetLearningRate(), 0.5f);
+}
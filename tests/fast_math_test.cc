@@ -0,0 +1,154 @@
+// MIT License
+
+#include "fast_math.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "cpu_features.h"
+#include "simd_kernels.h"
+
+namespace {
+// Every level the host can run, so that each variant is checked.
+std::vector<SimdLevel> AvailableLevels() {
+  std::vector<SimdLevel> levels = {SimdLevel::kPortable};
+  if (DetectSimdLevel() >= SimdLevel::kAvx2)
+    levels.push_back(SimdLevel::kAvx2);
+  if (DetectSimdLevel() >= SimdLevel::kAvx512)
+    levels.push_back(SimdLevel::kAvx512);
+  return levels;
+}
+
+// Error of value in units in the last place of T at the exact result, which
+// is computed in the wider type Wide.
+template <typename T, typename Wide>
+double UlpError(T value, Wide exact) {
+  if (std::isinf(static_cast<T>(exact)))
+    return value == static_cast<T>(exact) ? 0.0 : HUGE_VAL;
+  const int exponent =
+      exact == Wide(0)
+          ? std::numeric_limits<T>::min_exponent
+          : std::max(std::ilogb(exact) + 1,
+                     std::numeric_limits<T>::min_exponent);
+  const Wide ulp =
+      std::ldexp(Wide(1), exponent - std::numeric_limits<T>::digits);
+  return static_cast<double>(std::fabs(static_cast<Wide>(value) - exact) /
+                             ulp);
+}
+
+// Random bit patterns that fall inside [low, high], so every binade is
+// covered, and values drawn uniformly from [low, high].
+template <typename T>
+std::vector<T> Inputs(T low, T high) {
+  std::vector<T> inputs;
+  std::mt19937_64 gen(42);
+  std::uniform_real_distribution<T> uniform(low, high);
+  for (int i = 0; i < 400000; ++i) {
+    using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+    const Bits bits = static_cast<Bits>(gen());
+    T value;
+    std::memcpy(&value, &bits, sizeof(value));
+    if (value >= low && value <= high)
+      inputs.push_back(value);
+    inputs.push_back(uniform(gen));
+  }
+  return inputs;
+}
+
+// Runs the array kernel on every level and checks it against libm in
+// long double. Where long double is no wider than T, the reference itself
+// is off by up to half an ulp, which is allowed for.
+template <typename T>
+void ExpectWithinUlps(void (*Simd::MathKernels<T>::*kernel)(const T*, T*,
+                                                            size_t),
+                      long double (*exact)(long double), T low, T high,
+                      double max_ulps) {
+  const std::vector<T> inputs = Inputs(low, high);
+  if (std::numeric_limits<long double>::digits <=
+      std::numeric_limits<T>::digits)
+    max_ulps += 0.5;
+  for (SimdLevel level : AvailableLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    std::vector<T> outputs(inputs.size());
+    (Simd::MathKernelsFor<T>(level).*kernel)(inputs.data(), outputs.data(),
+                                             inputs.size());
+    double worst = 0.0;
+    T worst_input = T(0);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      const double error =
+          UlpError(outputs[i], exact(static_cast<long double>(inputs[i])));
+      if (error > worst) {
+        worst = error;
+        worst_input = inputs[i];
+      }
+    }
+    EXPECT_LE(worst, max_ulps) << "at " << worst_input;
+  }
+}
+
+long double ExactExp(long double x) {
+  return std::exp(x);
+}
+long double ExactLog(long double x) {
+  return std::log(x);
+}
+long double ExactTanh(long double x) {
+  return std::tanh(x);
+}
+}  // namespace
+
+TEST(FastMath, ExpIsWithinDocumentedUlpsOnEveryLevel) {
+  ExpectWithinUlps<float>(&Simd::MathKernels<float>::exp, ExactExp, -104.0f,
+                          89.0f, 1.5);
+  ExpectWithinUlps<double>(&Simd::MathKernels<double>::exp, ExactExp, -746.0,
+                           710.0, 1.0);
+}
+
+TEST(FastMath, LogIsWithinDocumentedUlpsOnEveryLevel) {
+  constexpr float kFloatMax = std::numeric_limits<float>::max();
+  constexpr double kDoubleMax = std::numeric_limits<double>::max();
+  ExpectWithinUlps<float>(&Simd::MathKernels<float>::log, ExactLog, 0.0f,
+                          kFloatMax, 1.0);
+  ExpectWithinUlps<float>(&Simd::MathKernels<float>::log, ExactLog, 0.5f,
+                          2.0f, 1.0);
+  ExpectWithinUlps<double>(&Simd::MathKernels<double>::log, ExactLog, 0.0,
+                           kDoubleMax, 1.0);
+  ExpectWithinUlps<double>(&Simd::MathKernels<double>::log, ExactLog, 0.5,
+                           2.0, 1.0);
+}
+
+TEST(FastMath, TanhIsWithinDocumentedUlpsOnEveryLevel) {
+  ExpectWithinUlps<float>(&Simd::MathKernels<float>::tanh, ExactTanh, -10.0f,
+                          10.0f, 2.0);
+  ExpectWithinUlps<double>(&Simd::MathKernels<double>::tanh, ExactTanh, -20.0,
+                           20.0, 3.0);
+}
+
+TEST(FastMath, HandlesSpecialValuesLikeLibm) {
+  constexpr double kInf = std::numeric_limits<double>::infinity();
+  constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+  EXPECT_EQ(FastMath::Exp(-kInf), 0.0);
+  EXPECT_EQ(FastMath::Exp(kInf), kInf);
+  EXPECT_EQ(FastMath::Exp(1000.0), kInf);
+  EXPECT_EQ(FastMath::Exp(0.0), 1.0);
+  EXPECT_EQ(FastMath::Exp(-1000.0f), 0.0f);
+  EXPECT_EQ(FastMath::Log(0.0), -kInf);
+  EXPECT_EQ(FastMath::Log(1.0f), 0.0f);
+  EXPECT_EQ(FastMath::Log(kInf), kInf);
+  EXPECT_TRUE(std::isnan(FastMath::Log(-1.0)));
+  EXPECT_EQ(FastMath::Log(std::numeric_limits<float>::denorm_min()),
+            std::log(std::numeric_limits<float>::denorm_min()));
+  EXPECT_EQ(FastMath::Tanh(kInf), 1.0);
+  EXPECT_EQ(FastMath::Tanh(-kInf), -1.0);
+  EXPECT_TRUE(std::isnan(FastMath::Exp(kNaN)));
+  EXPECT_TRUE(std::isnan(FastMath::Log(kNaN)));
+  EXPECT_TRUE(std::isnan(FastMath::Tanh(kNaN)));
+}
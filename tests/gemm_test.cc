@@ -0,0 +1,442 @@
+// MIT License
+
+#include "gemm.h"
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "matrix.h"
+#include "thread_pool.h"
+
+namespace {
+// Reference triple-loop product used to validate the blocked engine.
+// Takes plain and Matrix storage (any allocator).
+template <typename Fp, typename AllocA, typename AllocB>
+std::vector<Fp> NaiveMultiply(const std::vector<Fp, AllocA>& a,
+                              const std::vector<Fp, AllocB>& b, size_t m,
+                              size_t n, size_t k) {
+  std::vector<Fp> c(m * n, Fp(0));
+  for (size_t i = 0; i < m; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      Fp sum = Fp(0);
+      for (size_t p = 0; p < k; ++p) {
+        sum += a[i * k + p] * b[p * n + j];
+      }
+      c[i * n + j] = sum;
+    }
+  }
+  return c;
+}
+
+template <typename Fp>
+void ExpectMatchesNaive(size_t m, size_t n, size_t k,
+                        const Gemm::BlockSizes& blocks) {
+  Matrix<Fp> a = Matrix<Fp>::Random(m, k, Fp(-1), Fp(1), 1);
+  Matrix<Fp> b = Matrix<Fp>::Random(k, n, Fp(-1), Fp(1), 2);
+  std::vector<Fp> c(m * n, Fp(-7));  // Garbage that must be overwritten
+
+  Gemm::Multiply<Fp>(m, n, k, a.ToVector().data(), k, b.ToVector().data(), n,
+                     c.data(), n, blocks);
+
+  std::vector<Fp> expected = NaiveMultiply(a.ToVector(), b.ToVector(), m, n, k);
+  for (size_t i = 0; i < m * n; ++i) {
+    EXPECT_NEAR(c[i], expected[i], Fp(1e-3)) << "at index " << i;
+  }
+}
+
+// Returns the n x m transpose of a row-major m x n matrix.
+template <typename Fp, typename Alloc>
+std::vector<Fp> TransposeOf(const std::vector<Fp, Alloc>& x, size_t m,
+                            size_t n) {
+  std::vector<Fp> t(n * m);
+  for (size_t i = 0; i < m; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      t[j * m + i] = x[i * n + j];
+    }
+  }
+  return t;
+}
+
+// Multiplies op(A) * op(B) with A and B stored in the layout the transpose
+// flags describe, and compares against the naive product of op(A), op(B).
+template <typename Fp>
+void ExpectTransposedMatchesNaive(Transpose transpose_a, Transpose transpose_b,
+                                  size_t m, size_t n, size_t k,
+                                  const Gemm::BlockSizes& blocks) {
+  Matrix<Fp> op_a = Matrix<Fp>::Random(m, k, Fp(-1), Fp(1), 7);
+  Matrix<Fp> op_b = Matrix<Fp>::Random(k, n, Fp(-1), Fp(1), 8);
+  const bool ta = transpose_a == Transpose::kYes;
+  const bool tb = transpose_b == Transpose::kYes;
+  std::vector<Fp> a(op_a.ToVector().begin(), op_a.ToVector().end());
+  std::vector<Fp> b(op_b.ToVector().begin(), op_b.ToVector().end());
+  if (ta)
+    a = TransposeOf(a, m, k);
+  if (tb)
+    b = TransposeOf(b, k, n);
+  std::vector<Fp> c(m * n, Fp(-7));
+
+  Gemm::Multiply<Fp>(transpose_a, transpose_b, m, n, k, a.data(),
+                     ta ? m : k, b.data(), tb ? k : n, c.data(), n, blocks);
+
+  std::vector<Fp> expected =
+      NaiveMultiply(op_a.ToVector(), op_b.ToVector(), m, n, k);
+  for (size_t i = 0; i < m * n; ++i) {
+    EXPECT_NEAR(c[i], expected[i], Fp(1e-3)) << "at index " << i;
+  }
+}
+
+template <typename Fp>
+void ExpectParallelMatchesNaive(size_t m, size_t n, size_t k,
+                                size_t max_tasks) {
+  ThreadPoolOptions options;
+  options.num_threads = 4;
+  ThreadPool pool(options);
+  Matrix<Fp> a = Matrix<Fp>::Random(m, k, Fp(-1), Fp(1), 3);
+  Matrix<Fp> b = Matrix<Fp>::Random(k, n, Fp(-1), Fp(1), 4);
+  std::vector<Fp> c(m * n, Fp(-7));
+
+  Gemm::ParallelMultiply<Fp>(m, n, k, a.ToVector().data(), k,
+                             b.ToVector().data(), n, c.data(), n, pool,
+                             max_tasks);
+
+  std::vector<Fp> expected = NaiveMultiply(a.ToVector(), b.ToVector(), m, n, k);
+  for (size_t i = 0; i < m * n; ++i) {
+    EXPECT_NEAR(c[i], expected[i], Fp(1e-3)) << "at index " << i;
+  }
+}
+
+// Applies scale, a per-column bias and ReLU to a naive product.
+template <typename Fp>
+void ApplyNaiveEpilogue(const Gemm::Epilogue<Fp>& epilogue, size_t m,
+                        size_t n, std::vector<Fp>& c) {
+  for (size_t i = 0; i < m; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      Fp value = c[i * n + j] * epilogue.scale + epilogue.bias[j];
+      c[i * n + j] = epilogue.relu ? std::max(Fp(0), value) : value;
+    }
+  }
+}
+}  // namespace
+
+TEST(GemmMultiply, MatchesNaiveForFloatWithDefaultBlocks) {
+  ExpectMatchesNaive<float>(24, 256, 784, Gemm::DefaultBlockSizes<float>());
+}
+
+TEST(GemmMultiply, MatchesNaiveForDoubleWithDefaultBlocks) {
+  ExpectMatchesNaive<double>(24, 10, 256, Gemm::DefaultBlockSizes<double>());
+}
+
+TEST(GemmMultiply, HandlesEdgesAcrossSeveralBlocks) {
+  // Small blocks force partial micro-tiles and several passes over every loop
+  Gemm::BlockSizes blocks{12, 16, 32};
+  ExpectMatchesNaive<float>(37, 53, 41, blocks);
+  ExpectMatchesNaive<double>(37, 53, 41, blocks);
+}
+
+TEST(GemmMultiply, HandlesBlocksThatAreNotTileMultiples) {
+  Gemm::BlockSizes blocks{7, 5, 19};
+  ExpectMatchesNaive<float>(15, 22, 13, blocks);
+}
+
+TEST(GemmMultiply, ZeroInnerDimensionProducesZeros) {
+  std::vector<float> c(6, 3.0f);
+  Gemm::Multiply<float>(2, 3, 0, nullptr, 0, nullptr, 3, c.data(), 3);
+  for (float value : c) {
+    EXPECT_EQ(value, 0.0f);
+  }
+}
+
+TEST(GemmMultiplyTransposed, MatchesNaiveForEveryLayout) {
+  // Small blocks exercise partial panels of the transposing packers
+  Gemm::BlockSizes blocks{12, 16, 32};
+  for (Transpose ta : {Transpose::kNo, Transpose::kYes}) {
+    for (Transpose tb : {Transpose::kNo, Transpose::kYes}) {
+      ExpectTransposedMatchesNaive<float>(ta, tb, 37, 53, 41, blocks);
+      ExpectTransposedMatchesNaive<double>(ta, tb, 37, 53, 41, blocks);
+    }
+  }
+}
+
+TEST(GemmMultiplyTransposed, MatchesNaiveForBackwardShapes) {
+  // input^T * grad_output and grad_output * W^T at batch 24
+  const Gemm::BlockSizes& blocks = Gemm::DefaultBlockSizes<float>();
+  ExpectTransposedMatchesNaive<float>(Transpose::kYes, Transpose::kNo, 784,
+                                      256, 24, blocks);
+  ExpectTransposedMatchesNaive<float>(Transpose::kNo, Transpose::kYes, 24, 784,
+                                      256, blocks);
+}
+
+TEST(GemmParallelMultiply, MatchesNaiveForTransposedOperands) {
+  // Arrange
+  // A^T * B with a deep k, so the plan splits K as well
+  ThreadPool pool(ThreadPoolOptions{4, 0, false});
+  const size_t m = 10, n = 12, k = 600;
+  Matrix<float> op_a = Matrix<float>::Random(m, k, -1.0f, 1.0f, 9);
+  Matrix<float> op_b = Matrix<float>::Random(k, n, -1.0f, 1.0f, 10);
+  std::vector<float> a = TransposeOf(op_a.ToVector(), m, k);
+  std::vector<float> b = TransposeOf(op_b.ToVector(), k, n);
+  std::vector<float> c(m * n);
+
+  // Act
+  Gemm::ParallelMultiply<float>(Transpose::kYes, Transpose::kYes, m, n, k,
+                                a.data(), m, b.data(), k, c.data(), n, pool,
+                                8);
+
+  // Assert
+  std::vector<float> expected =
+      NaiveMultiply(op_a.ToVector(), op_b.ToVector(), m, n, k);
+  for (size_t i = 0; i < m * n; ++i) {
+    EXPECT_NEAR(c[i], expected[i], 1e-3f) << "at index " << i;
+  }
+}
+
+TEST(GemmComputeBlockSizes, ProducesTileAlignedBlocks) {
+  Gemm::CacheSizes caches;
+  Gemm::BlockSizes blocks = Gemm::ComputeBlockSizes<float>(caches);
+  EXPECT_EQ(blocks.mc % Gemm::KernelShape<float>::kMr, 0);
+  EXPECT_EQ(blocks.nc % Gemm::KernelShape<float>::kNr, 0);
+  EXPECT_GT(blocks.kc, 0);
+}
+
+TEST(GemmPlanPartition, SplitsSmallBatchAcrossColumnsAndK) {
+  // Act
+  // grad_output * W^T at batch 24: 24 x 784 output, only 256 deep
+  Gemm::Partition wide = Gemm::PlanPartition(24, 784, 256, 8, 6, 16, 128);
+  // Final layer at batch 24: 24 x 10 output, 256 deep
+  Gemm::Partition narrow = Gemm::PlanPartition(24, 10, 256, 8, 6, 16, 128);
+
+  // Assert
+  EXPECT_EQ(wide.Tasks(), 8);
+  EXPECT_EQ(wide.k_splits, 1);
+  EXPECT_EQ(narrow.row_blocks * narrow.col_blocks, 4);
+  EXPECT_EQ(narrow.k_splits, 2);
+}
+
+TEST(GemmPlanPartition, TilesCoverTheOutputWithAlignedEdges) {
+  // Act
+  Gemm::Partition plan = Gemm::PlanPartition(100, 70, 50, 16, 6, 16, 0);
+
+  // Assert
+  EXPECT_LE(plan.Tasks(), 16);
+  EXPECT_EQ(plan.k_splits, 1);
+  EXPECT_EQ(plan.row_step % 6, 0);
+  EXPECT_EQ(plan.col_step % 16, 0);
+  EXPECT_GE(plan.row_blocks * plan.row_step, 100);
+  EXPECT_LT((plan.row_blocks - 1) * plan.row_step, 100);
+  EXPECT_GE(plan.col_blocks * plan.col_step, 70);
+  EXPECT_LT((plan.col_blocks - 1) * plan.col_step, 70);
+}
+
+TEST(GemmPlanPartition, SingleTaskKeepsWholeProduct) {
+  Gemm::Partition plan = Gemm::PlanPartition(24, 10, 784, 1, 6, 16, 128);
+  EXPECT_EQ(plan.Tasks(), 1);
+  EXPECT_EQ(plan.k_step, 784);
+}
+
+TEST(GemmParallelMultiply, MatchesNaiveForTiledOutput) {
+  ExpectParallelMatchesNaive<float>(37, 200, 64, 4);
+  ExpectParallelMatchesNaive<double>(37, 200, 64, 4);
+}
+
+TEST(GemmParallelMultiply, MatchesNaiveWithKSplit) {
+  // Few output tiles and a deep k force a reduction over K slices
+  ExpectParallelMatchesNaive<float>(5, 10, 1000, 8);
+  ExpectParallelMatchesNaive<double>(24, 10, 784, 8);
+}
+
+TEST(GemmEpilogue, AppliesScaleBiasAndReLUAfterTheLastKBlock) {
+  // Arrange
+  // Small blocks split k into several kc blocks and n into several panels
+  const size_t m = 37, n = 53, k = 41;
+  Gemm::BlockSizes blocks{12, 16, 32};
+  Matrix<float> a = Matrix<float>::Random(m, k, -1.0f, 1.0f, 11);
+  Matrix<float> b = Matrix<float>::Random(k, n, -1.0f, 1.0f, 12);
+  Matrix<float> bias = Matrix<float>::Random(1, n, -1.0f, 1.0f, 13);
+  Gemm::Epilogue<float> epilogue;
+  epilogue.scale = 0.5f;
+  epilogue.bias = bias.ToVector().data();
+  epilogue.relu = true;
+  std::vector<float> c(m * n, -7.0f);
+
+  // Act
+  Gemm::Multiply<float>(Transpose::kNo, Transpose::kNo, m, n, k,
+                        a.ToVector().data(), k, b.ToVector().data(), n,
+                        c.data(), n, blocks, epilogue);
+
+  // Assert
+  std::vector<float> expected =
+      NaiveMultiply(a.ToVector(), b.ToVector(), m, n, k);
+  ApplyNaiveEpilogue(epilogue, m, n, expected);
+  for (size_t i = 0; i < m * n; ++i) {
+    EXPECT_NEAR(c[i], expected[i], 1e-3f) << "at index " << i;
+  }
+}
+
+TEST(GemmEpilogue, AppliesAfterTiledAndKSplitParallelProducts) {
+  // Arrange
+  ThreadPool pool(ThreadPoolOptions{4, 0, false});
+  Matrix<double> bias = Matrix<double>::Random(1, 200, -1.0, 1.0, 14);
+  Gemm::Epilogue<double> epilogue;
+  epilogue.bias = bias.ToVector().data();
+  epilogue.relu = true;
+
+  // A wide output is split into tiles, a narrow deep one across K
+  for (auto [m, n, k] : {std::tuple<size_t, size_t, size_t>{37, 200, 64},
+                         std::tuple<size_t, size_t, size_t>{5, 10, 1000}}) {
+    Matrix<double> a = Matrix<double>::Random(m, k, -1.0, 1.0, 15);
+    Matrix<double> b = Matrix<double>::Random(k, n, -1.0, 1.0, 16);
+    std::vector<double> c(m * n, -7.0);
+
+    // Act
+    Gemm::ParallelMultiply<double>(Transpose::kNo, Transpose::kNo, m, n, k,
+                                   a.ToVector().data(), k,
+                                   b.ToVector().data(), n, c.data(), n, pool,
+                                   8, epilogue);
+
+    // Assert
+    std::vector<double> expected =
+        NaiveMultiply(a.ToVector(), b.ToVector(), m, n, k);
+    ApplyNaiveEpilogue(epilogue, m, n, expected);
+    for (size_t i = 0; i < m * n; ++i) {
+      EXPECT_NEAR(c[i], expected[i], 1e-9) << "at index " << i;
+    }
+  }
+}
+
+TEST(GemmEpilogue, ZeroInnerDimensionProducesTheBias) {
+  // Arrange
+  std::vector<float> bias = {1.0f, -2.0f, 3.0f};
+  Gemm::Epilogue<float> epilogue;
+  epilogue.bias = bias.data();
+  epilogue.relu = true;
+  std::vector<float> c(6, 5.0f);
+  // Act
+  Gemm::Multiply<float>(Transpose::kNo, Transpose::kNo, 2, 3, 0, nullptr, 0,
+                        nullptr, 3, c.data(), 3, epilogue);
+  // Assert
+  EXPECT_EQ(c, std::vector<float>({1, 0, 3, 1, 0, 3}));
+}
+
+TEST(GemmOperandMasks, ReadMaskedOperandsAsZeroInEveryLayout) {
+  // Arrange
+  const size_t m = 37, n = 53, k = 41;
+  Gemm::BlockSizes blocks{12, 16, 32};
+  Matrix<float> op_a = Matrix<float>::Random(m, k, -1.0f, 1.0f, 17);
+  Matrix<float> op_b = Matrix<float>::Random(k, n, -1.0f, 1.0f, 18);
+  Matrix<float> a_mask = Matrix<float>::Random(m, k, -1.0f, 1.0f, 19);
+  Matrix<float> b_mask = Matrix<float>::Random(k, n, -1.0f, 1.0f, 20);
+  std::vector<float> masked_a(op_a.ToVector().begin(), op_a.ToVector().end());
+  std::vector<float> masked_b(op_b.ToVector().begin(), op_b.ToVector().end());
+  for (size_t i = 0; i < m * k; ++i) {
+    if (a_mask.ToVector()[i] <= 0.0f)
+      masked_a[i] = 0.0f;
+  }
+  for (size_t i = 0; i < k * n; ++i) {
+    if (b_mask.ToVector()[i] <= 0.0f)
+      masked_b[i] = 0.0f;
+  }
+  std::vector<float> expected = NaiveMultiply(masked_a, masked_b, m, n, k);
+
+  for (Transpose ta : {Transpose::kNo, Transpose::kYes}) {
+    for (Transpose tb : {Transpose::kNo, Transpose::kYes}) {
+      // Operands and masks are stored in the same layout
+      const bool a_transposed = ta == Transpose::kYes;
+      const bool b_transposed = tb == Transpose::kYes;
+      std::vector<float> a(op_a.ToVector().begin(), op_a.ToVector().end());
+      std::vector<float> b(op_b.ToVector().begin(), op_b.ToVector().end());
+      std::vector<float> a_masks(a_mask.ToVector().begin(),
+                                 a_mask.ToVector().end());
+      std::vector<float> b_masks(b_mask.ToVector().begin(),
+                                 b_mask.ToVector().end());
+      if (a_transposed) {
+        a = TransposeOf(a, m, k);
+        a_masks = TransposeOf(a_masks, m, k);
+      }
+      if (b_transposed) {
+        b = TransposeOf(b, k, n);
+        b_masks = TransposeOf(b_masks, k, n);
+      }
+      Gemm::OperandMasks<float> masks;
+      masks.a = a_masks.data();
+      masks.b = b_masks.data();
+      std::vector<float> c(m * n, -7.0f);
+
+      // Act
+      Gemm::Multiply<float>(ta, tb, m, n, k, a.data(), a_transposed ? m : k,
+                            b.data(), b_transposed ? k : n, c.data(), n,
+                            blocks, Gemm::Epilogue<float>(), masks);
+
+      // Assert
+      for (size_t i = 0; i < m * n; ++i) {
+        EXPECT_NEAR(c[i], expected[i], 1e-3f) << "at index " << i;
+      }
+    }
+  }
+}
+
+TEST(GemmOperandMasks, ApplyToEveryTileAndKSliceOfParallelProducts) {
+  // Arrange
+  // grad_output * W^T with a masked gradient, narrow enough to split K
+  ThreadPool pool(ThreadPoolOptions{4, 0, false});
+  const size_t m = 5, n = 10, k = 1000;
+  Matrix<double> a = Matrix<double>::Random(m, k, -1.0, 1.0, 21);
+  Matrix<double> b = Matrix<double>::Random(k, n, -1.0, 1.0, 22);
+  Matrix<double> mask = Matrix<double>::Random(m, k, -1.0, 1.0, 23);
+  std::vector<double> masked_a(a.ToVector().begin(), a.ToVector().end());
+  for (size_t i = 0; i < m * k; ++i) {
+    if (mask.ToVector()[i] <= 0.0)
+      masked_a[i] = 0.0;
+  }
+  Gemm::OperandMasks<double> masks;
+  masks.a = mask.ToVector().data();
+  std::vector<double> c(m * n, -7.0);
+
+  // Act
+  Gemm::ParallelMultiply<double>(Transpose::kNo, Transpose::kNo, m, n, k,
+                                 a.ToVector().data(), k, b.ToVector().data(),
+                                 n, c.data(), n, pool, 8,
+                                 Gemm::Epilogue<double>(), masks);
+
+  // Assert
+  std::vector<double> expected =
+      NaiveMultiply(masked_a, b.ToVector(), m, n, k);
+  for (size_t i = 0; i < m * n; ++i) {
+    EXPECT_NEAR(c[i], expected[i], 1e-9) << "at index " << i;
+  }
+}
+
+TEST(OperatorMultiplyByMatrix, FloatProductMatchesNaive) {
+  // Arrange
+  Matrix<float> matA = Matrix<float>::Random(24, 784, -1.0f, 1.0f, 3);
+  Matrix<float> matB = Matrix<float>::Random(784, 10, -1.0f, 1.0f, 4);
+  // Act
+  Matrix<float> result = matA * matB;
+  // Assert
+  std::vector<float> expected =
+      NaiveMultiply(matA.ToVector(), matB.ToVector(), 24, 10, 784);
+  ASSERT_EQ(result.Rows(), 24);
+  ASSERT_EQ(result.Cols(), 10);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(result.ToVector()[i], expected[i], 1e-3f);
+  }
+}
+
+TEST(OperatorMultiplyByMatrix, ForcesConcurrencyOnFloatWorkload) {
+  // Arrange
+  Matrix<float> matA = Matrix<float>::Random(9, 20, -1.0f, 1.0f, 5);
+  Matrix<float> matB = Matrix<float>::Random(20, 7, -1.0f, 1.0f, 6);
+  uint64_t original_threshold = Matrix<float>::kMinWorkPerThread;
+  Matrix<float>::kMinWorkPerThread = 1;
+  // Act
+  Matrix<float> result = matA * matB;
+  Matrix<float>::kMinWorkPerThread = original_threshold;
+  // Assert
+  std::vector<float> expected =
+      NaiveMultiply(matA.ToVector(), matB.ToVector(), 9, 7, 20);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(result.ToVector()[i], expected[i], 1e-4f);
+  }
+}
@@ -0,0 +1,119 @@
+// MIT License
+
+#include "hogwild_trainer.h"
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "batch_sampler.h"
+#include "linear_layer.h"
+#include "matrix.h"
+#include "neural_network.h"
+#include "relu_layer.h"
+#include "test_networks.h"
+
+using test_networks::ExpectNear;
+using test_networks::Labels;
+using test_networks::SmallNetwork;
+
+namespace {
+
+// Rows of small noise with a spike in the column of their class
+void ClassifiableData(size_t rows, Matrix<float>& data,
+                      Matrix<float>& labels) {
+  data = Matrix<float>::Random(rows, 16, -0.1f, 0.1f, 7);
+  for (size_t r = 0; r < rows; ++r) {
+    data(r, (r % 4) * 4) += 1.0f;
+  }
+  labels = Labels(rows);
+}
+
+}  // namespace
+
+TEST(LinearLayerCloneSharingParameters, UpdatesTheOwnerInPlace) {
+  // Arrange: the second input column is zero
+  LinearLayer<float> owner(3, 2, 0.5f, 42);
+  LinearLayer<float> reference(3, 2, 0.5f, 42);
+  Matrix<float> input({1, 0, 2, -1, 0, 3}, 2, 3);
+  Matrix<float> grad_output({1, -2, 0.5f, 1}, 2, 2);
+  std::unique_ptr<NeuralLayer<float>> clone = owner.CloneSharingParameters();
+  // Act
+  (void)clone->Forward(input);
+  (void)clone->Backward(grad_output);
+  clone->UpdateWeights();
+  (void)reference.Forward(input);
+  (void)reference.Backward(grad_output);
+  reference.UpdateWeights();
+  // Assert
+  Matrix<float> updated = owner.Forward(input);
+  Matrix<float> expected = reference.Forward(input);
+  for (size_t i = 0; i < expected.ToVector().size(); ++i) {
+    EXPECT_FLOAT_EQ(updated.ToVector()[i], expected.ToVector()[i]);
+  }
+  EXPECT_EQ(clone->Forward(input).ToVector(), updated.ToVector());
+}
+
+TEST(LinearLayerCloneSharingParameters, MovesOnlyParametersOfNonzeroInputs) {
+  // Arrange: only the first input column is nonzero
+  LinearLayer<float> owner(3, 2, 0.5f, 42);
+  std::unique_ptr<NeuralLayer<float>> clone = owner.CloneSharingParameters();
+  Matrix<float> input({1, 0, 0}, 1, 3);
+  Matrix<float> unit_rows({0, 1, 0, 0, 0, 1}, 2, 3);
+  Matrix<float> before = owner.Forward(unit_rows);
+  // Act
+  (void)clone->Forward(input);
+  (void)clone->Backward(Matrix<float>({1, 1}, 1, 2));
+  clone->UpdateWeights();
+  // Assert: rows 1 and 2 of the weights, the bias moved by the gradient
+  Matrix<float> after = owner.Forward(unit_rows);
+  for (size_t i = 0; i < after.ToVector().size(); ++i) {
+    EXPECT_FLOAT_EQ(after.ToVector()[i] - before.ToVector()[i], -0.5f);
+  }
+}
+
+TEST(HogwildTrainer, WithOneWorkerMatchesSequentialTraining) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> sequential = SmallNetwork();
+  std::unique_ptr<NeuralNetwork<float>> hogwild = SmallNetwork();
+  HogwildTrainer<float> trainer(*hogwild, 1);
+  Matrix<float> data;
+  Matrix<float> labels;
+  ClassifiableData(20, data, labels);
+  BatchSampler sampler(20, 8);
+  sampler.Shuffle(3);
+  Matrix<float> data_batch;
+  Matrix<float> labels_batch;
+  // Act
+  float sequential_loss = 0.0f;
+  for (size_t batch = 0; batch < sampler.NumBatches(); ++batch) {
+    sampler.Gather(batch, data, data_batch);
+    sampler.Gather(batch, labels, labels_batch);
+    sequential_loss += sequential->TrainStep(data_batch, labels_batch);
+  }
+  float hogwild_loss = trainer.TrainEpoch(sampler, data, labels);
+  // Assert
+  EXPECT_NEAR(hogwild_loss, sequential_loss / sampler.NumBatches(), 1e-5f);
+  ExpectNear(hogwild->Forward(data), sequential->Forward(data));
+}
+
+TEST(HogwildTrainer, TrainsTheSharedNetwork) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> network = SmallNetwork();
+  HogwildTrainer<float> trainer(*network, 4);
+  Matrix<float> data;
+  Matrix<float> labels;
+  ClassifiableData(64, data, labels);
+  BatchSampler sampler(64, 4);
+  // Act
+  float first_loss = trainer.TrainEpoch(sampler, data, labels);
+  float last_loss = first_loss;
+  for (uint32_t epoch = 0; epoch < 10; ++epoch) {
+    sampler.Shuffle(epoch);
+    last_loss = trainer.TrainEpoch(sampler, data, labels);
+  }
+  // Assert
+  EXPECT_EQ(trainer.NumWorkers(), 4);
+  EXPECT_LT(last_loss, first_loss * 0.5f);
+  EXPECT_EQ(network->EvaluateAccuracy(data, labels), 1.0f);
+}
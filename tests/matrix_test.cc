@@ -2,6 +2,8 @@
 
 #include "matrix.h"
 
+#include "thread_pool.h"
+
 #include <gtest/gtest.h>
 
 TEST(Rows, ReturnsMatrixRows) {
@@ -70,6 +72,20 @@ TEST(MatrixConstructor, DataConstructorWorks) {
   }
 }
 
+TEST(Reserve, KeepsTheShapeAndTheStorageOfLaterResizes) {
+  // Arrange
+  Matrix<float> mat(2, 3);
+  // Act
+  mat.Reserve(8, 4);
+  const float* storage = mat.ToVector().data();
+  mat.Resize(8, 4);
+  mat.Resize(5, 6);
+  // Assert
+  EXPECT_EQ(mat.ToVector().data(), storage);
+  EXPECT_EQ(mat.Rows(), 5);
+  EXPECT_EQ(mat.Cols(), 6);
+}
+
 TEST(Random, ReturnsMatrixWithCorrectDimensions) {
   // Arrange
   size_t rows = 4;
@@ -97,6 +113,49 @@ TEST(GetTranspose, ReturnsTransposedMatrix) {
   EXPECT_EQ(transposed(2, 1), 6);
 }
 
+TEST(CollapseRows, SumsLargeMatricesAcrossThePool) {
+  // Arrange
+  Matrix<int> mat(3000, 257);
+  for (size_t r = 0; r < mat.Rows(); ++r) {
+    for (size_t c = 0; c < mat.Cols(); ++c) {
+      mat(r, c) = static_cast<int>((r + c) % 5);
+    }
+  }
+  // Act
+  Matrix<int> column_sums = mat.CollapseRows();
+  Matrix<int> row_sums = mat.CollapseCols();
+  // Assert
+  for (size_t c = 0; c < mat.Cols(); ++c) {
+    int expected = 0;
+    for (size_t r = 0; r < mat.Rows(); ++r) {
+      expected += mat(r, c);
+    }
+    ASSERT_EQ(column_sums(0, c), expected);
+  }
+  for (size_t r = 0; r < mat.Rows(); ++r) {
+    int expected = 0;
+    for (size_t c = 0; c < mat.Cols(); ++c) {
+      expected += mat(r, c);
+    }
+    ASSERT_EQ(row_sums(r, 0), expected);
+  }
+}
+
+TEST(GetTranspose, TransposesLargeMatricesInBlocks) {
+  // Arrange: several 64x64 blocks with partial blocks and tiles at the edges
+  Matrix<float> mat = Matrix<float>::Random(1000, 301, -1.0f, 1.0f, 9);
+  // Act
+  Matrix<float> transposed = mat.GetTranspose();
+  // Assert
+  ASSERT_EQ(transposed.Rows(), 301);
+  ASSERT_EQ(transposed.Cols(), 1000);
+  for (size_t r = 0; r < mat.Rows(); ++r) {
+    for (size_t c = 0; c < mat.Cols(); ++c) {
+      ASSERT_EQ(transposed(c, r), mat(r, c));
+    }
+  }
+}
+
 TEST(CollapseRows, ReturnsSummedUpRowMatrix) {
   // Arrange
   std::vector<int> data = {1, 2, 3, 4, 5, 6, 7, 8, 9};
@@ -132,9 +191,9 @@ TEST(ToVector, ReturnsCorrectDataVector) {
   std::vector<int> data = {1, 2, 3, 4, 5, 6};
   Matrix<int> mat(data, 2, 3);
   // Act
-  const std::vector<int>& vec = mat.ToVector();
+  const Matrix<int>::Storage& vec = mat.ToVector();
   // Assert
-  EXPECT_EQ(vec, data);
+  EXPECT_EQ(std::vector<int>(vec.begin(), vec.end()), data);
 }
 
 TEST(ToVector, NonConstVersionReturnsCorrectDataVector) {
@@ -142,9 +201,9 @@ TEST(ToVector, NonConstVersionReturnsCorrectDataVector) {
   std::vector<int> data = {1, 2, 3, 4, 5, 6};
   Matrix<int> mat(data, 2, 3);
   // Act
-  std::vector<int>& vec = mat.ToVector();
+  Matrix<int>::Storage& vec = mat.ToVector();
   // Assert
-  EXPECT_EQ(vec, data);
+  EXPECT_EQ(std::vector<int>(vec.begin(), vec.end()), data);
 }
 
 TEST(ToFloat, ConvertsMatrixToFloat) {
@@ -208,6 +267,77 @@ TEST(ShuffleRows, CorrectlyShufflesRows) {
   EXPECT_FALSE(is_identical);
 }
 
+TEST(GatherRows, CopiesTheListedRowsInOrder) {
+  // Arrange
+  Matrix<int> mat({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}, 5, 2);
+  std::vector<size_t> rows = {4, 0, 2, 2};
+  // Act
+  Matrix<int> gathered = mat.GatherRows(rows);
+  // Assert
+  ASSERT_EQ(gathered.Rows(), 4);
+  ASSERT_EQ(gathered.Cols(), 2);
+  EXPECT_EQ(gathered.ToVector(),
+            Matrix<int>::Storage({9, 10, 1, 2, 5, 6, 5, 6}));
+}
+
+TEST(GatherRows, SplitsLargeGathersAcrossThePool) {
+  // Arrange: enough bytes to be split, rows in reverse order
+  Matrix<float> mat = Matrix<float>::Random(4096, 300, -1.0f, 1.0f, 5);
+  std::vector<size_t> rows(mat.Rows());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i] = rows.size() - 1 - i;
+  }
+  Matrix<float> gathered;
+  // Act
+  mat.GatherRowsInto(rows, gathered);
+  // Assert
+  for (size_t i = 0; i < rows.size(); ++i) {
+    for (size_t c = 0; c < mat.Cols(); ++c) {
+      ASSERT_EQ(gathered(i, c), mat(rows[i], c));
+    }
+  }
+}
+
+TEST(GatherRows, ConvertsAndScalesIntoAnotherType) {
+  // Arrange
+  Matrix<uint8_t> pixels({0, 255, 10, 20, 128, 64}, 3, 2);
+  std::vector<size_t> rows = {2, 0};
+  Matrix<float> gathered;
+  // Act
+  pixels.GatherRowsInto(rows, gathered, 0.5f);
+  // Assert
+  ASSERT_EQ(gathered.Rows(), 2);
+  ASSERT_EQ(gathered.Cols(), 2);
+  EXPECT_EQ(gathered.ToVector(),
+            Matrix<float>::Storage({64.0f, 32.0f, 0.0f, 127.5f}));
+}
+
+TEST(ArgMaxRows, ReturnsTheMaxAndItsColumnForEveryRow) {
+  // Arrange
+  Matrix<float> mat({1, 3, 2, 9, 0, 9, -1, -5, -2}, 3, 3);
+  // Act
+  std::vector<size_t> arg_max = mat.ArgMaxRows();
+  Matrix<float> max = mat.MaxInRows();
+  // Assert
+  EXPECT_EQ(arg_max, (std::vector<size_t>{1, 0, 0}));
+  ASSERT_EQ(max.Rows(), 3);
+  ASSERT_EQ(max.Cols(), 1);
+  EXPECT_EQ(max.ToVector(), (Matrix<float>::Storage{3, 9, -1}));
+}
+
+TEST(ArgMaxRows, MatchesArgMaxRowOnLargeMatrices) {
+  // Arrange: large enough to be split across the pool
+  Matrix<float> mat = Matrix<float>::Random(20000, 37, -1.0f, 1.0f, 4);
+  // Act
+  std::vector<size_t> arg_max = mat.ArgMaxRows();
+  Matrix<float> max = mat.MaxInRows();
+  // Assert
+  for (size_t r = 0; r < mat.Rows(); ++r) {
+    ASSERT_EQ(arg_max[r], mat.ArgMaxRow(r));
+    ASSERT_EQ(max(r, 0), mat(r, arg_max[r]));
+  }
+}
+
 TEST(ArgMaxRow, ReturnsTheIndexOfTheMaxValueInSpecifiedRow) {
   // Arrange
   Matrix<int> mat({1, 2, 3, 4, 6, 5, 9, 0, 7}, 3, 3);
@@ -372,6 +502,71 @@ TEST(OperatorMultiplyByMatrix, ForcesConcurrencyOnWorkload) {
   EXPECT_EQ(result(1, 1), 50);
 }
 
+TEST(OperatorMultiplyByMatrix, SplitsIntegralProductIntoTiles) {
+  // Arrange
+  Matrix<int> matA = Matrix<int>::Random(7, 40, -5, 5, 1);
+  Matrix<int> matB = Matrix<int>::Random(40, 37, -5, 5, 2);
+  Matrix<int> expected(7, 37);
+  for (size_t r = 0; r < 7; ++r) {
+    for (size_t c = 0; c < 37; ++c) {
+      for (size_t k = 0; k < 40; ++k) {
+        expected(r, c) += matA(r, k) * matB(k, c);
+      }
+    }
+  }
+  uint64_t original_threshold = Matrix<int>::kMinWorkPerThread;
+  Matrix<int>::kMinWorkPerThread = 1;
+  ThreadPool::ConfigureGlobal(ThreadPoolOptions{4, 0, false});
+
+  // Act
+  Matrix<int> result = matA * matB;
+
+  ThreadPool::ConfigureGlobal(ThreadPoolOptions());
+  Matrix<int>::kMinWorkPerThread = original_threshold;
+
+  // Assert
+  EXPECT_EQ(result.ToVector(), expected.ToVector());
+}
+
+TEST(MultiplyTransposed, MatchesExplicitTransposes) {
+  // Arrange
+  Matrix<int> matA = Matrix<int>::Random(5, 3, -4, 4, 3);
+  Matrix<int> matB = Matrix<int>::Random(5, 4, -4, 4, 4);
+  Matrix<int> matC = Matrix<int>::Random(3, 4, -4, 4, 5);
+
+  // Act
+  Matrix<int> tn = Matrix<int>::Multiply(matA, Transpose::kYes, matB,
+                                         Transpose::kNo);
+  Matrix<int> nt = Matrix<int>::Multiply(matB, Transpose::kNo, matC,
+                                         Transpose::kYes);
+
+  // Assert
+  Matrix<int> expected_tn = matA.GetTranspose() * matB;
+  Matrix<int> expected_nt = matB * matC.GetTranspose();
+  ASSERT_EQ(tn.Rows(), 3);
+  ASSERT_EQ(tn.Cols(), 4);
+  EXPECT_EQ(tn.ToVector(), expected_tn.ToVector());
+  ASSERT_EQ(nt.Rows(), 5);
+  ASSERT_EQ(nt.Cols(), 3);
+  EXPECT_EQ(nt.ToVector(), expected_nt.ToVector());
+}
+
+TEST(MultiplyTransposed, FloatProductMatchesExplicitTranspose) {
+  // Arrange
+  Matrix<float> input = Matrix<float>::Random(24, 50, -1.0f, 1.0f, 6);
+  Matrix<float> grad = Matrix<float>::Random(24, 30, -1.0f, 1.0f, 7);
+
+  // Act
+  Matrix<float> result = Matrix<float>::Multiply(input, Transpose::kYes, grad,
+                                                 Transpose::kNo);
+
+  // Assert
+  Matrix<float> expected = input.GetTranspose() * grad;
+  for (size_t i = 0; i < expected.ToVector().size(); ++i) {
+    EXPECT_NEAR(result.ToVector()[i], expected.ToVector()[i], 1e-4f);
+  }
+}
+
 TEST(OperatorAddMatrix, AddsTwoMatrices) {
   // Arrange
   Matrix<int> matA({1, 2, 3, 4}, 2, 2);
@@ -555,4 +750,117 @@ TEST(OperatorSubstractScalarFromMatrix, SubstractsEachElementByScalar) {
   EXPECT_EQ(result(0, 1), 0.0f);
   EXPECT_EQ(result(1, 0), -1.0f);
   EXPECT_EQ(result(1, 1), -2.0f);
-}
\ No newline at end of file
+}
+TEST(MatrixExpression, EvaluatesChainedOperations) {
+  // Arrange
+  Matrix<int> matA({1, 2, 3, 4}, 2, 2);
+  Matrix<int> matB({5, 6, 7, 8}, 2, 2);
+  Matrix<int> matC({1, 1, 2, 2}, 2, 2);
+  // Act
+  Matrix<int> result = (matA + matB - matC) * 2 + 1;
+  // Assert
+  EXPECT_EQ(result.Rows(), 2);
+  EXPECT_EQ(result.Cols(), 2);
+  EXPECT_EQ(result(0, 0), 11);
+  EXPECT_EQ(result(0, 1), 15);
+  EXPECT_EQ(result(1, 0), 17);
+  EXPECT_EQ(result(1, 1), 21);
+}
+
+TEST(MatrixExpression, SubtractAssignsScaledMatrix) {
+  // Arrange
+  Matrix<float> weights({1.0f, 2.0f, 3.0f, 4.0f}, 2, 2);
+  Matrix<float> gradients({10.0f, 20.0f, 30.0f, 40.0f}, 2, 2);
+  float learning_rate = 0.5f;
+  // Act
+  weights -= gradients * learning_rate;
+  // Assert
+  EXPECT_FLOAT_EQ(weights(0, 0), -4.0f);
+  EXPECT_FLOAT_EQ(weights(0, 1), -8.0f);
+  EXPECT_FLOAT_EQ(weights(1, 0), -12.0f);
+  EXPECT_FLOAT_EQ(weights(1, 1), -16.0f);
+}
+
+TEST(MatrixExpression, AddAssignsBroadcastRows) {
+  // Arrange
+  Matrix<int> output({1, 2, 3, 4, 5, 6}, 3, 2);
+  Matrix<int> biases({10, 20}, 1, 2);
+  // Act
+  output += biases.BroadcastRows(output.Rows());
+  // Assert
+  EXPECT_EQ(output(0, 0), 11);
+  EXPECT_EQ(output(0, 1), 22);
+  EXPECT_EQ(output(1, 0), 13);
+  EXPECT_EQ(output(1, 1), 24);
+  EXPECT_EQ(output(2, 0), 15);
+  EXPECT_EQ(output(2, 1), 26);
+}
+
+TEST(MatrixExpression, KeepsTemporaryOperandsAlive) {
+  // Arrange
+  Matrix<int> mat({1, 2, 3, 4}, 2, 2);
+  // Act
+  Matrix<int> result = mat + Matrix<int>({4, 3, 2, 1}, 2, 2) * 3;
+  // Assert
+  EXPECT_EQ(result(0, 0), 13);
+  EXPECT_EQ(result(0, 1), 11);
+  EXPECT_EQ(result(1, 0), 9);
+  EXPECT_EQ(result(1, 1), 7);
+}
+
+TEST(MatrixExpression, AssignsExpressionThatReadsTheDestination) {
+  // Arrange
+  Matrix<int> same_shape({1, 2, 3, 4}, 2, 2);
+  Matrix<int> new_shape({1, 2}, 1, 2);
+  // Act
+  same_shape = same_shape * 2 - same_shape;
+  new_shape = new_shape.BroadcastRows(3) + 1;
+  // Assert
+  EXPECT_EQ(same_shape(0, 0), 1);
+  EXPECT_EQ(same_shape(1, 1), 4);
+  EXPECT_EQ(new_shape.Rows(), 3);
+  EXPECT_EQ(new_shape(2, 0), 2);
+  EXPECT_EQ(new_shape(2, 1), 3);
+}
+
+TEST(MultiplyInto, ReusesTheResultStorage) {
+  // Arrange
+  Matrix<float> matA({1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f}, 2, 3);
+  Matrix<float> matB({1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f}, 3, 2);
+  Matrix<float> result(4, 4);
+  const float* storage = result.ToVector().data();
+  // Act
+  Matrix<float>::MultiplyInto(matA, Transpose::kNo, matB, Transpose::kNo,
+                              result);
+  // Assert
+  EXPECT_EQ(result.ToVector().data(), storage);
+  EXPECT_EQ(result.Rows(), 2);
+  EXPECT_EQ(result.Cols(), 2);
+  EXPECT_FLOAT_EQ(result(0, 0), 4.0f);
+  EXPECT_FLOAT_EQ(result(0, 1), 5.0f);
+  EXPECT_FLOAT_EQ(result(1, 0), 10.0f);
+  EXPECT_FLOAT_EQ(result(1, 1), 11.0f);
+}
+
+TEST(IntoVariants, MatchTheValueReturningOperations) {
+  // Arrange
+  Matrix<int> matA({1, 2, 3, 4, 5, 6}, 2, 3);
+  Matrix<int> matB({6, 5, 4, 3, 2, 1}, 2, 3);
+  Matrix<int> product({9, 9, 9, 9}, 2, 2);  // Stale contents are overwritten
+  Matrix<int> transposed;
+  Matrix<int> collapsed;
+  // Act
+  Matrix<int>::MultiplyInto(matA, Transpose::kNo, matB, Transpose::kYes,
+                            product);
+  matA.TransposeInto(transposed);
+  matA.CollapseRowsInto(collapsed);
+  Matrix<int>::AddInto(matA, matB, matA);  // The result may be an operand
+  // Assert
+  EXPECT_EQ(product.ToVector(),
+            (Matrix<int>::Multiply(Matrix<int>({1, 2, 3, 4, 5, 6}, 2, 3),
+                                   Transpose::kNo, matB, Transpose::kYes)
+                 .ToVector()));
+  EXPECT_EQ(transposed.ToVector(), (Matrix<int>::Storage{1, 4, 2, 5, 3, 6}));
+  EXPECT_EQ(collapsed.ToVector(), (Matrix<int>::Storage{5, 7, 9}));
+  EXPECT_EQ(matA.ToVector(), (Matrix<int>::Storage{7, 7, 7, 7, 7, 7}));
+}
@@ -0,0 +1,86 @@
+// MIT License
+
+#include "matrix_view.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "matrix.h"
+
+TEST(MatrixView, RowRangeSharesTheMatrixStorage) {
+  // Arrange
+  Matrix<float> matrix({1, 2, 3, 4, 5, 6, 7, 8}, 4, 2);
+  // Act
+  MatrixView<float> rows = matrix.RowRange(1, 3);
+  // Assert
+  EXPECT_EQ(rows.Rows(), 2);
+  EXPECT_EQ(rows.Cols(), 2);
+  EXPECT_EQ(rows.Data(), matrix.ToVector().data() + 2);
+  EXPECT_EQ(rows(0, 0), 3.0f);
+  EXPECT_EQ(rows(1, 1), 6.0f);
+}
+
+TEST(MatrixView, ReadsStridedRows) {
+  // Arrange: the first two columns of a 3x4 buffer
+  std::vector<int> data = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  // Act
+  MatrixView<int> view(data.data(), 3, 2, 4);
+  MatrixView<int> last_rows = view.RowRange(1, 3);
+  // Assert
+  EXPECT_EQ(view(2, 1), 10);
+  EXPECT_EQ(last_rows.RowStride(), 4);
+  EXPECT_EQ(last_rows(0, 0), 5);
+  EXPECT_EQ(last_rows(1, 1), 10);
+}
+
+TEST(MatrixView, CopiesIntoAMatrix) {
+  // Arrange
+  std::vector<int> data = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  MatrixView<int> view(data.data(), 3, 2, 4);
+  // Act
+  Matrix<int> copy = view;
+  // Assert
+  ASSERT_EQ(copy.Rows(), 3);
+  ASSERT_EQ(copy.Cols(), 2);
+  EXPECT_EQ(copy.ToVector(), Matrix<int>::Storage({1, 2, 5, 6, 9, 10}));
+}
+
+TEST(MatrixView, MultipliesRowRangesWithoutCopying) {
+  // Arrange
+  Matrix<float> lhs = Matrix<float>::Random(10, 6, -1.0f, 1.0f, 3);
+  Matrix<float> rhs = Matrix<float>::Random(6, 5, -1.0f, 1.0f, 4);
+  Matrix<float> lhs_rows = lhs.RowRange(2, 7);
+  // Act
+  Matrix<float> from_view =
+      Matrix<float>::Multiply(lhs.RowRange(2, 7), Transpose::kNo, rhs,
+                              Transpose::kNo);
+  Matrix<float> from_copy = lhs_rows * rhs;
+  // Assert
+  ASSERT_EQ(from_view.Rows(), 5);
+  ASSERT_EQ(from_view.Cols(), 5);
+  for (size_t i = 0; i < 5; ++i) {
+    for (size_t j = 0; j < 5; ++j) {
+      EXPECT_FLOAT_EQ(from_view(i, j), from_copy(i, j));
+    }
+  }
+}
+
+TEST(MatrixView, MultipliesTransposedStridedViews) {
+  // Arrange: rows 1..3 of a 4x3 matrix, transposed
+  Matrix<double> matrix({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12}, 4, 3);
+  Matrix<double> rows = matrix.RowRange(1, 4);
+  Matrix<double> result;
+  // Act
+  Matrix<double>::MultiplyInto(matrix.RowRange(1, 4), Transpose::kYes,
+                               matrix.RowRange(1, 4), Transpose::kNo, result);
+  // Assert
+  EXPECT_EQ(result.ToVector(), (rows.GetTranspose() * rows).ToVector());
+}
+
+TEST(MatrixViewDeathTest, RejectsOutOfBoundsRowRanges) {
+  // Arrange
+  Matrix<float> matrix(4, 2);
+  // Act & Assert
+  EXPECT_DEATH(matrix.RowRange(3, 5), "out of bounds");
+}
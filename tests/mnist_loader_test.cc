@@ -4,10 +4,10 @@
 
 #include <fstream>
 #include <string>
-#include <vector>
 
 #include <gtest/gtest.h>
 
+#include "aligned_allocator.h"
 #include "dataset.h"
 
 namespace {
@@ -67,8 +67,8 @@ class MNISTLoaderTest : public ::testing::Test {
   std::string test_dir_;
   std::string fake_images_path_;
   std::string fake_labels_path_;
-  std::vector<uint8_t> expected_images_;
-  std::vector<uint8_t> expected_labels_;
+  Memory::AlignedVector<uint8_t> expected_images_;
+  Memory::AlignedVector<uint8_t> expected_labels_;
 };
 
 TEST_F(MNISTLoaderTest, Load_SuccessfullyLoadsValidFiles) {
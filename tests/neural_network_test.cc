@@ -0,0 +1,226 @@
+// MIT License
+
+#include "neural_network.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "confusion_matrix.h"
+#include "linear_layer.h"
+#include "relu_layer.h"
+#include "test_networks.h"
+
+using test_networks::Labels;
+using test_networks::SmallNetwork;
+
+TEST(NeuralNetworkTrainStep, ReducesLossOnARepeatedBatch) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> network = SmallNetwork();
+  Matrix<float> data = Matrix<float>::Random(8, 16, -1.0f, 1.0f, 7);
+  Matrix<float> labels = Labels(8);
+  // Act
+  float first_loss = network->TrainStep(data, labels);
+  float last_loss = first_loss;
+  for (int step = 0; step < 50; ++step) {
+    last_loss = network->TrainStep(data, labels);
+  }
+  // Assert
+  EXPECT_LT(last_loss, first_loss * 0.5f);
+}
+
+TEST(NeuralNetworkTrainStep, TrainsOnRowRangesLikeOnCopies) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> on_views = SmallNetwork();
+  std::unique_ptr<NeuralNetwork<float>> on_copies = SmallNetwork();
+  Matrix<float> data = Matrix<float>::Random(8, 16, -1.0f, 1.0f, 7);
+  Matrix<float> labels = Labels(8);
+  Matrix<float> data_batch = data.RowRange(2, 6);
+  Matrix<float> labels_batch = labels.RowRange(2, 6);
+  // Act
+  float view_loss =
+      on_views->TrainStep(data.RowRange(2, 6), labels.RowRange(2, 6));
+  float copy_loss = on_copies->TrainStep(data_batch, labels_batch);
+  // Assert
+  EXPECT_FLOAT_EQ(view_loss, copy_loss);
+  EXPECT_EQ(on_views->Forward(data).ToVector(),
+            on_copies->Forward(data).ToVector());
+}
+
+TEST(NeuralNetworkPlanWorkspace, ListsTheBuffersOfEveryTrainingStep) {
+  // Arrange: the ReLU is fused onto the first Linear layer and has no
+  // buffers of its own
+  std::unique_ptr<NeuralNetwork<float>> network = SmallNetwork();
+  // Act
+  WorkspacePlan plan = network->PlanWorkspace(8, 16);
+  // Assert
+  EXPECT_EQ(plan.max_batch_size, 8);
+  ASSERT_EQ(plan.buffers.size(), 9);
+  EXPECT_EQ(plan.buffers[0].layer, 0);
+  EXPECT_STREQ(plan.buffers[0].name, "input_cache");
+  EXPECT_EQ(plan.buffers[0].bytes, 8 * 17 * sizeof(float));
+  EXPECT_EQ(plan.buffers[4].layer, 2);
+  EXPECT_EQ(plan.buffers[8].layer, WorkspaceBuffer::kNetwork);
+  EXPECT_STREQ(plan.buffers[8].name, "loss_grad");
+  EXPECT_EQ(plan.buffers[8].bytes, 8 * 4 * sizeof(float));
+  EXPECT_EQ(plan.TotalBytes(), 7120);
+}
+
+TEST(NeuralNetworkForward, FusesLinearAndReLULikeSeparateLayers) {
+  // Arrange: the layers of SmallNetwork, run one by one
+  std::unique_ptr<NeuralNetwork<float>> network = SmallNetwork();
+  LinearLayer<float> first(16, 32, 0.1f, 42);
+  ReLULayer<float> relu;
+  LinearLayer<float> last(32, 4, 0.1f, 43);
+  Matrix<float> data = Matrix<float>::Random(8, 16, -1.0f, 1.0f, 7);
+  Matrix<float> grad_output = Matrix<float>::Random(8, 4, -1.0f, 1.0f, 8);
+  // Act
+  Matrix<float> fused = network->Forward(data);
+  Matrix<float> fused_grad = network->Backward(grad_output);
+  Matrix<float> separate = last.Forward(relu.Forward(first.Forward(data)));
+  Matrix<float> separate_grad =
+      first.Backward(relu.Backward(last.Backward(grad_output)));
+  // Assert
+  EXPECT_EQ(fused.ToVector(), separate.ToVector());
+  EXPECT_EQ(fused_grad.ToVector(), separate_grad.ToVector());
+}
+
+TEST(NeuralNetworkInfer, MatchesForward) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> network = SmallNetwork();
+  Matrix<float> data = Matrix<float>::Random(8, 16, -1.0f, 1.0f, 7);
+  // Act
+  Matrix<float> inferred = network->Infer(data);
+  Matrix<float> forward = network->Forward(data);
+  // Assert
+  EXPECT_EQ(inferred.ToVector(), forward.ToVector());
+}
+
+TEST(NeuralNetworkInfer, LeavesAPendingBackwardUntouched) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> interleaved = SmallNetwork();
+  std::unique_ptr<NeuralNetwork<float>> plain = SmallNetwork();
+  Matrix<float> data = Matrix<float>::Random(8, 16, -1.0f, 1.0f, 7);
+  Matrix<float> other = Matrix<float>::Random(5, 16, -1.0f, 1.0f, 9);
+  Matrix<float> grad_output = Matrix<float>::Random(8, 4, -1.0f, 1.0f, 8);
+  // Act: infer on another batch between forward and backward
+  (void)interleaved->Forward(data);
+  (void)interleaved->Infer(other);
+  Matrix<float> interleaved_grad = interleaved->Backward(grad_output);
+  (void)plain->Forward(data);
+  Matrix<float> plain_grad = plain->Backward(grad_output);
+  // Assert
+  EXPECT_EQ(interleaved_grad.ToVector(), plain_grad.ToVector());
+}
+
+TEST(NeuralNetworkEvaluate, CountsArgMaxOfLogitsAcrossChunks) {
+  // Arrange: more rows than fit in two chunks, with a partial last chunk
+  std::unique_ptr<NeuralNetwork<float>> network = SmallNetwork();
+  const size_t rows = 2 * NeuralNetwork<float>::kEvaluationChunkRows + 37;
+  Matrix<float> data = Matrix<float>::Random(rows, 16, -1.0f, 1.0f, 7);
+  Matrix<float> classes(rows, 1);
+  for (size_t r = 0; r < rows; ++r) {
+    classes(r, 0) = static_cast<float>(r % 4);
+  }
+  Matrix<float> labels = Matrix<float>::OneHotEncode(classes, 4);
+  std::vector<size_t> predicted = network->Forward(data).ArgMaxRows();
+  // Act
+  ConfusionMatrix confusion = network->Evaluate(data, labels);
+  // Assert
+  ConfusionMatrix expected(4);
+  for (size_t r = 0; r < rows; ++r) {
+    expected.Add(r % 4, predicted[r]);
+  }
+  ASSERT_EQ(confusion.Samples(), rows);
+  for (size_t t = 0; t < 4; ++t) {
+    for (size_t p = 0; p < 4; ++p) {
+      EXPECT_EQ(confusion.Count(t, p), expected.Count(t, p));
+    }
+  }
+  EXPECT_FLOAT_EQ(network->EvaluateAccuracy(data, labels),
+                  expected.Accuracy());
+}
+
+TEST(NeuralNetworkTrain, TrainsOnRawBytesLikeOnConvertedFloats) {
+  // Arrange
+  std::unique_ptr<NeuralNetwork<float>> on_bytes = SmallNetwork();
+  std::unique_ptr<NeuralNetwork<float>> on_floats = SmallNetwork();
+  Matrix<uint8_t> pixels(40, 16);
+  Matrix<float> classes(40, 1);
+  for (size_t r = 0; r < 40; ++r) {
+    classes(r, 0) = static_cast<float>(r % 4);
+    for (size_t c = 0; c < 16; ++c) {
+      pixels(r, c) = static_cast<uint8_t>((r * 31 + c * 17) % 256);
+    }
+  }
+  Matrix<float> labels = Matrix<float>::OneHotEncode(classes, 4);
+  const float scale = 1.0f / 255.0f;
+  Matrix<float> floats = pixels.ToFloat(scale);
+  std::vector<float> bytes_accuracy;
+  std::vector<float> floats_accuracy;
+  // Act
+  on_bytes->Train(pixels, labels, pixels, labels, 2, 8,
+                  [&](uint32_t, float accuracy) {
+                    bytes_accuracy.push_back(accuracy);
+                  },
+                  scale);
+  on_floats->Train(floats, labels, floats, labels, 2, 8,
+                   [&](uint32_t, float accuracy) {
+                     floats_accuracy.push_back(accuracy);
+                   });
+  // Assert
+  EXPECT_EQ(bytes_accuracy, floats_accuracy);
+  EXPECT_EQ(on_bytes->EvaluateAccuracy(pixels, labels, scale),
+            on_floats->EvaluateAccuracy(floats, labels));
+  EXPECT_EQ(on_bytes->Forward(floats).ToVector(),
+            on_floats->Forward(floats).ToVector());
+}
+
+TEST(LinearLayerBackward, UpdatesBiasesBySummedOutputGradient) {
+  // Arrange
+  LinearLayer<float> layer(2, 3, 1.0f, 42);
+  Matrix<float> data = Matrix<float>::Random(4, 2, -1.0f, 1.0f, 9);
+  Matrix<float> grad_output({1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -2, -3}, 4, 3);
+  Matrix<float> zeros(1, 2);
+  // Act
+  (void)layer.Forward(data);
+  (void)layer.Backward(grad_output);
+  layer.UpdateWeights();
+  // Assert: with a zero input the output is the bias, -sum of the gradients
+  EXPECT_EQ(layer.Forward(zeros).ToVector(),
+            Matrix<float>::Storage({-11.0f, -13.0f, -15.0f}));
+}
+
+TEST(ReLULayerBackward, PassesGradientsOfPositiveInputsOnly) {
+  // Arrange: a strided view, wider than one mask word
+  ReLULayer<float> layer;
+  Matrix<float> values = Matrix<float>::Random(3, 160, -1.0f, 1.0f, 10);
+  MatrixView<float> input(values.ToVector().data(), 3, 150, 160);
+  Matrix<float> grad_output = Matrix<float>::Random(3, 150, -1.0f, 1.0f, 11);
+  // Act
+  Matrix<float> output = layer.Forward(input);
+  const Matrix<float>& grad_input = layer.Backward(grad_output);
+  // Assert
+  for (size_t r = 0; r < 3; ++r) {
+    for (size_t c = 0; c < 150; ++c) {
+      const bool positive = values(r, c) > 0.0f;
+      EXPECT_EQ(output(r, c), positive ? values(r, c) : 0.0f);
+      EXPECT_EQ(grad_input(r, c), positive ? grad_output(r, c) : 0.0f);
+    }
+  }
+}
+
+TEST(ReLULayerInfer, MatchesForwardOnStridedViews) {
+  // Arrange
+  ReLULayer<float> layer;
+  Matrix<float> values = Matrix<float>::Random(3, 160, -1.0f, 1.0f, 10);
+  MatrixView<float> input(values.ToVector().data(), 3, 150, 160);
+  Matrix<float> inferred;
+  // Act
+  layer.Infer(input, inferred);
+  const Matrix<float>& forward = layer.Forward(input);
+  // Assert
+  EXPECT_EQ(inferred.ToVector(), forward.ToVector());
+}
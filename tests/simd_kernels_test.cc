@@ -0,0 +1,327 @@
+// MIT License
+
+#include "simd_kernels.h"
+
+#include <cmath>
+#include <cstdint>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "cpu_features.h"
+
+namespace {
+// Every level the host can run, so that each variant is checked.
+std::vector<SimdLevel> AvailableLevels() {
+  std::vector<SimdLevel> levels = {SimdLevel::kPortable};
+  if (DetectSimdLevel() >= SimdLevel::kAvx2)
+    levels.push_back(SimdLevel::kAvx2);
+  if (DetectSimdLevel() >= SimdLevel::kAvx512)
+    levels.push_back(SimdLevel::kAvx512);
+  return levels;
+}
+
+// Odd length so that vector loops also run their scalar tails
+constexpr size_t kLength = 1027;
+
+template <typename T>
+std::vector<T> Sequence(T start, T step) {
+  std::vector<T> values(kLength);
+  for (size_t i = 0; i < kLength; ++i) {
+    values[i] = static_cast<T>(start + static_cast<T>(i % 50) * step);
+  }
+  return values;
+}
+}  // namespace
+
+TEST(SimdKernels, BinaryKernelsMatchScalarLoopOnEveryLevel) {
+  std::vector<float> a = Sequence(-3.0f, 0.25f);
+  std::vector<float> b = Sequence(1.0f, 0.5f);
+  for (SimdLevel level : AvailableLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    Simd::ElementwiseKernels<float> kernels = Simd::KernelsFor<float>(level);
+    std::vector<float> sum(kLength);
+    std::vector<float> difference(kLength);
+    kernels.add(a.data(), b.data(), sum.data(), kLength);
+    kernels.subtract(a.data(), b.data(), difference.data(), kLength);
+    for (size_t i = 0; i < kLength; ++i) {
+      EXPECT_EQ(sum[i], a[i] + b[i]);
+      EXPECT_EQ(difference[i], a[i] - b[i]);
+    }
+  }
+}
+
+TEST(SimdKernels, InPlaceKernelsMatchScalarLoopOnEveryLevel) {
+  std::vector<int> b = Sequence(2, 3);
+  for (SimdLevel level : AvailableLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    Simd::ElementwiseKernels<int> kernels = Simd::KernelsFor<int>(level);
+    std::vector<int> values = Sequence(10, 7);
+    std::vector<int> expected = values;
+    kernels.add_assign(values.data(), b.data(), kLength);
+    kernels.multiply_scalar(values.data(), 3, kLength);
+    kernels.subtract_scalar(values.data(), 4, kLength);
+    kernels.divide_scalar(values.data(), 2, kLength);
+    kernels.add_scalar(values.data(), 1, kLength);
+    kernels.subtract_assign(values.data(), b.data(), kLength);
+    for (size_t i = 0; i < kLength; ++i) {
+      int value = ((expected[i] + b[i]) * 3 - 4) / 2 + 1 - b[i];
+      EXPECT_EQ(values[i], value);
+    }
+  }
+}
+
+TEST(SimdKernels, ConvertWidensAndScalesOnEveryLevel) {
+  std::vector<uint8_t> pixels(kLength);
+  for (size_t i = 0; i < kLength; ++i) {
+    pixels[i] = static_cast<uint8_t>(i * 7);
+  }
+  for (SimdLevel level : AvailableLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    std::vector<float> floats(kLength);
+    std::vector<double> doubles(kLength);
+    Simd::ConvertKernelFor<uint8_t, float>(level)(pixels.data(), floats.data(),
+                                                  1.0f / 255.0f, kLength);
+    Simd::ConvertKernelFor<uint8_t, double>(level)(
+        pixels.data(), doubles.data(), 0.5, kLength);
+    for (size_t i = 0; i < kLength; ++i) {
+      EXPECT_FLOAT_EQ(floats[i], static_cast<float>(pixels[i]) / 255.0f);
+      EXPECT_DOUBLE_EQ(doubles[i], static_cast<double>(pixels[i]) * 0.5);
+    }
+  }
+}
+
+TEST(SimdKernels, GatherConvertRowsWidensAndScalesOnEveryLevel) {
+  // Arrange: rows of 37 pixels, more listed rows than the prefetch distance
+  constexpr size_t kCols = 37;
+  std::vector<uint8_t> pixels(20 * kCols);
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    pixels[i] = static_cast<uint8_t>(i * 7);
+  }
+  const std::vector<size_t> rows = {19, 3, 3, 0, 11, 7, 15, 2};
+  for (SimdLevel level : AvailableLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    std::vector<float> out(rows.size() * kCols);
+    // Act
+    Simd::GatherConvertRowsKernelFor<uint8_t, float>(level)(
+        pixels.data(), kCols, rows.data(), rows.size(), kCols, 1.0f / 255.0f,
+        out.data());
+    // Assert
+    for (size_t i = 0; i < rows.size(); ++i) {
+      for (size_t c = 0; c < kCols; ++c) {
+        EXPECT_FLOAT_EQ(out[i * kCols + c],
+                        static_cast<float>(pixels[rows[i] * kCols + c]) /
+                            255.0f);
+      }
+    }
+  }
+}
+
+namespace {
+// Transposes a rows x cols block with padded strides on every level and
+// checks every element, including the partial tiles at the edges.
+template <typename T>
+void ExpectTransposeMatchesScalarLoop(size_t rows, size_t cols) {
+  const size_t src_stride = cols + 3;
+  const size_t dst_stride = rows + 5;
+  std::vector<T> src(rows * src_stride);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<T>(i % 251);
+  }
+  for (SimdLevel level : AvailableLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    std::vector<T> dst(cols * dst_stride, T(0));
+    Simd::TransposeKernelFor<T>(level)(src.data(), src_stride, rows, cols,
+                                       dst.data(), dst_stride);
+    for (size_t r = 0; r < rows; ++r) {
+      for (size_t c = 0; c < cols; ++c) {
+        ASSERT_EQ(dst[c * dst_stride + r], src[r * src_stride + c]);
+      }
+    }
+  }
+}
+}  // namespace
+
+TEST(SimdKernels, TransposeMatchesScalarLoopOnEveryLevel) {
+  ExpectTransposeMatchesScalarLoop<float>(8, 8);
+  ExpectTransposeMatchesScalarLoop<float>(37, 70);
+  ExpectTransposeMatchesScalarLoop<double>(19, 16);
+  ExpectTransposeMatchesScalarLoop<int>(5, 3);
+  ExpectTransposeMatchesScalarLoop<uint8_t>(24, 29);
+}
+
+namespace {
+// Checks the reductions of a rows x cols matrix of small integers (sums are
+// exact in every type) against scalar loops on every level.
+template <typename T>
+void ExpectReductionsMatchScalarLoops(size_t rows, size_t cols) {
+  std::vector<T> src(rows * cols);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<T>((i * 7919) % 97);
+  }
+  for (SimdLevel level : AvailableLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    Simd::ReductionKernels<T> kernels = Simd::ReductionKernelsFor<T>(level);
+    std::vector<T> column_sums(cols);
+    std::vector<T> row_sums(rows);
+    std::vector<T> row_max(rows);
+    std::vector<size_t> arg_max(rows);
+    kernels.column_sums(src.data(), cols, rows, cols, column_sums.data());
+    kernels.row_sums(src.data(), rows, cols, row_sums.data());
+    kernels.row_max(src.data(), rows, cols, row_max.data(), arg_max.data());
+    for (size_t c = 0; c < cols; ++c) {
+      T sum = T(0);
+      for (size_t r = 0; r < rows; ++r) {
+        sum += src[r * cols + c];
+      }
+      EXPECT_EQ(column_sums[c], sum);
+    }
+    for (size_t r = 0; r < rows; ++r) {
+      const T* row = src.data() + r * cols;
+      T sum = T(0);
+      size_t best = 0;
+      for (size_t c = 0; c < cols; ++c) {
+        sum += row[c];
+        if (row[c] > row[best])
+          best = c;
+      }
+      EXPECT_EQ(row_sums[r], sum);
+      EXPECT_EQ(row_max[r], row[best]);
+      EXPECT_EQ(arg_max[r], best);
+    }
+  }
+}
+}  // namespace
+
+TEST(SimdKernels, ReductionsMatchScalarLoopsOnEveryLevel) {
+  ExpectReductionsMatchScalarLoops<float>(13, 10);
+  ExpectReductionsMatchScalarLoops<float>(7, 101);
+  ExpectReductionsMatchScalarLoops<double>(9, 37);
+  ExpectReductionsMatchScalarLoops<int>(5, 64);
+  ExpectReductionsMatchScalarLoops<uint8_t>(3, 70);
+}
+
+TEST(SimdKernels, RowMaxReturnsTheFirstColumnOfTiedMaxima) {
+  // Ties in different vector lanes and in the scalar tail
+  std::vector<float> row(100, 0.0f);
+  row[37] = 5.0f;
+  row[21] = 5.0f;
+  row[99] = 5.0f;
+  for (SimdLevel level : AvailableLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    float max = 0.0f;
+    size_t arg_max = 0;
+    Simd::ReductionKernelsFor<float>(level).row_max(row.data(), 1, row.size(),
+                                                    &max, &arg_max);
+    EXPECT_EQ(max, 5.0f);
+    EXPECT_EQ(arg_max, 21);
+  }
+}
+
+TEST(SimdKernels, ReLUKeepsOneMaskBitPerElementOnEveryLevel) {
+  std::vector<float> in = Sequence(-3.0f, 0.25f);
+  std::vector<float> grad = Sequence(1.0f, 0.5f);
+  const size_t words =
+      (kLength + Simd::kReLUMaskBits - 1) / Simd::kReLUMaskBits;
+  for (SimdLevel level : AvailableLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    const Simd::ReLUKernels<float> kernels = Simd::ReLUKernelsFor<float>(level);
+    std::vector<float> out(kLength);
+    std::vector<uint64_t> mask(words, ~uint64_t{0});
+    std::vector<float> grad_in(kLength);
+    kernels.forward(in.data(), out.data(), mask.data(), kLength);
+    kernels.backward(grad.data(), mask.data(), grad_in.data(), kLength);
+    for (size_t i = 0; i < kLength; ++i) {
+      const bool positive = in[i] > 0.0f;
+      EXPECT_EQ(out[i], positive ? in[i] : 0.0f) << "at index " << i;
+      EXPECT_EQ((mask[i / 64] >> (i % 64)) & 1, positive ? 1u : 0u)
+          << "at index " << i;
+      EXPECT_EQ(grad_in[i], positive ? grad[i] : 0.0f) << "at index " << i;
+    }
+    // Bits past the last element are cleared
+    EXPECT_EQ(mask.back() >> (kLength % 64), 0u);
+  }
+}
+
+TEST(SimdKernels, ReLUForwardRunsInPlace) {
+  std::vector<double> values = {-1.0, 2.0, 0.0, 3.0, -0.5};
+  uint64_t mask = 0;
+  Simd::ReLU<double>().forward(values.data(), values.data(), &mask,
+                               values.size());
+  EXPECT_EQ(values, std::vector<double>({0.0, 2.0, 0.0, 3.0, 0.0}));
+  EXPECT_EQ(mask, 0b01010u);
+}
+
+namespace {
+template <typename T>
+void ExpectSoftmaxKernelsMatchScalarLoops(size_t rows, size_t cols,
+                                          T tolerance) {
+  std::vector<T> logits(rows * cols);
+  std::vector<T> labels(rows * (cols + 1), T(0));  // Strided rows
+  for (size_t i = 0; i < logits.size(); ++i) {
+    logits[i] = static_cast<T>(static_cast<int>(i * 7 % 23) - 11) / T(3);
+  }
+  for (size_t r = 0; r < rows; ++r) {
+    labels[r * (cols + 1) + r % cols] = T(1);
+  }
+  for (SimdLevel level : AvailableLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    const Simd::SoftmaxKernels<T> kernels =
+        Simd::SoftmaxKernelsFor<T>(level);
+    std::vector<T> probabilities(rows * cols);
+    std::vector<T> grad(rows * cols);
+    kernels.softmax(logits.data(), probabilities.data(), rows, cols);
+    const T loss = kernels.cross_entropy(logits.data(), labels.data(),
+                                         cols + 1, grad.data(), T(0.5), rows,
+                                         cols);
+    T expected_loss = T(0);
+    for (size_t r = 0; r < rows; ++r) {
+      const T* row = logits.data() + r * cols;
+      T max = row[0];
+      for (size_t c = 1; c < cols; ++c) {
+        max = std::max(max, row[c]);
+      }
+      T sum = T(0);
+      for (size_t c = 0; c < cols; ++c) {
+        sum += std::exp(row[c] - max);
+      }
+      for (size_t c = 0; c < cols; ++c) {
+        const T probability = std::exp(row[c] - max) / sum;
+        const T label = labels[r * (cols + 1) + c];
+        EXPECT_NEAR(probabilities[r * cols + c], probability, tolerance);
+        EXPECT_NEAR(grad[r * cols + c], (probability - label) * T(0.5),
+                    tolerance);
+        if (label == T(1))
+          expected_loss -= std::log(probability);
+      }
+    }
+    EXPECT_NEAR(loss, expected_loss, tolerance * T(rows));
+  }
+}
+}  // namespace
+
+TEST(SimdKernels, SoftmaxKernelsMatchScalarLoopsOnEveryLevel) {
+  ExpectSoftmaxKernelsMatchScalarLoops<float>(7, 10, 1e-6f);
+  ExpectSoftmaxKernelsMatchScalarLoops<float>(3, 101, 1e-6f);
+  ExpectSoftmaxKernelsMatchScalarLoops<double>(5, 37, 1e-14);
+}
+
+TEST(SimdKernels, CrossEntropyRunsInPlace) {
+  std::vector<double> logits = {1.0, 2.0, 3.0, 0.0, 0.0, 0.0};
+  std::vector<double> labels = {0.0, 0.0, 1.0, 1.0, 0.0, 0.0};
+  const double loss = Simd::Softmax<double>().cross_entropy(
+      logits.data(), labels.data(), 3, logits.data(), 1.0, 2, 3);
+  EXPECT_NEAR(loss, std::log(1.0 + std::exp(-1.0) + std::exp(-2.0)) +
+                        std::log(3.0),
+              1e-12);
+  EXPECT_NEAR(logits[2], 1.0 / (1.0 + std::exp(-1.0) + std::exp(-2.0)) - 1.0,
+              1e-12);
+  EXPECT_NEAR(logits[3], 1.0 / 3.0 - 1.0, 1e-12);
+  EXPECT_NEAR(logits[4], 1.0 / 3.0, 1e-12);
+}
+
+TEST(DetectSimdLevel, ActiveLevelMatchesDetection) {
+  EXPECT_EQ(ActiveSimdLevel(), DetectSimdLevel());
+}
@@ -0,0 +1,53 @@
+// MIT License
+
+// Networks, data and checks shared by the network and trainer tests.
+
+#ifndef MNIST_DIGIT_RECOGNITION_TESTS_TEST_NETWORKS_H_
+#define MNIST_DIGIT_RECOGNITION_TESTS_TEST_NETWORKS_H_
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "linear_layer.h"
+#include "matrix.h"
+#include "neural_network.h"
+#include "relu_layer.h"
+
+namespace test_networks {
+
+// 16 inputs, a hidden Linear + ReLU pair of 32 units (which runs fused) and
+// 4 outputs. The same seeds give the same weights, so two calls return
+// identical networks.
+inline std::unique_ptr<NeuralNetwork<float>> SmallNetwork() {
+  auto network = std::make_unique<NeuralNetwork<float>>();
+  network->AddLayer(std::make_unique<LinearLayer<float>>(16, 32, 0.1f, 42));
+  network->AddLayer(std::make_unique<ReLULayer<float>>());
+  network->AddLayer(std::make_unique<LinearLayer<float>>(32, 4, 0.1f, 43));
+  return network;
+}
+
+// One-hot labels of the 4 classes of SmallNetwork, row r of class r % 4
+inline Matrix<float> Labels(size_t rows) {
+  Matrix<float> classes(rows, 1);
+  for (size_t r = 0; r < rows; ++r) {
+    classes(r, 0) = static_cast<float>(r % 4);
+  }
+  return Matrix<float>::OneHotEncode(classes, 4);
+}
+
+// Expects the same shape and every element within tolerance, for results
+// whose summation order differs (e.g. split across replicas)
+inline void ExpectNear(const Matrix<float>& actual,
+                       const Matrix<float>& expected,
+                       float tolerance = 1e-5f) {
+  ASSERT_EQ(actual.Rows(), expected.Rows());
+  ASSERT_EQ(actual.Cols(), expected.Cols());
+  for (size_t i = 0; i < actual.ToVector().size(); ++i) {
+    EXPECT_NEAR(actual.ToVector()[i], expected.ToVector()[i], tolerance);
+  }
+}
+
+}  // namespace test_networks
+
+#endif  // MNIST_DIGIT_RECOGNITION_TESTS_TEST_NETWORKS_H_
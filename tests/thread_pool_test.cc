@@ -0,0 +1,98 @@
+// MIT License
+
+#include "thread_pool.h"
+
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(ThreadPool, NumThreadsIncludesTheCallingThread) {
+  // Arrange & Act
+  ThreadPool pool(ThreadPoolOptions{4, 0, false});
+  // Assert
+  EXPECT_EQ(pool.NumThreads(), 4);
+  EXPECT_EQ(pool.MaxParallelism(), 4);
+}
+
+TEST(ThreadPool, MaxParallelismIsCappedByPoolSize) {
+  ThreadPool pool(ThreadPoolOptions{2, 8, false});
+  EXPECT_EQ(pool.MaxParallelism(), 2);
+}
+
+TEST(ParallelFor, VisitsEveryIndexExactlyOnce) {
+  // Arrange
+  ThreadPool pool(ThreadPoolOptions{4, 0, false});
+  std::vector<std::atomic<int>> visits(1000);
+  // Act
+  pool.ParallelFor(0, visits.size(), 10, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      visits[i].fetch_add(1);
+    }
+  });
+  // Assert
+  for (const auto& count : visits) {
+    EXPECT_EQ(count.load(), 1);
+  }
+}
+
+TEST(ParallelFor, CompletesWhenChunksDoNotDivideTheRange) {
+  // Arrange
+  // 5 elements over 4 threads round up to 3 chunks of 2
+  ThreadPool pool(ThreadPoolOptions{4, 0, false});
+  std::atomic<int> visited{0};
+  // Act
+  pool.ParallelFor(0, 5, 1, [&](size_t begin, size_t end) {
+    visited.fetch_add(static_cast<int>(end - begin));
+  });
+  // Assert
+  EXPECT_EQ(visited.load(), 5);
+}
+
+TEST(ParallelFor, RespectsTheGrainSize) {
+  ThreadPool pool(ThreadPoolOptions{4, 0, false});
+  std::atomic<int> chunks{0};
+  pool.ParallelFor(0, 100, 60, [&](size_t begin, size_t end) {
+    chunks.fetch_add(1);
+    EXPECT_TRUE(end - begin >= 40);
+  });
+  EXPECT_EQ(chunks.load(), 2);
+}
+
+TEST(ParallelFor, SupportsNestedLoops) {
+  // Arrange
+  ThreadPool pool(ThreadPoolOptions{3, 0, false});
+  std::atomic<size_t> total{0};
+  // Act
+  pool.ParallelFor(0, 8, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      pool.ParallelFor(0, 100, 1, [&](size_t inner_begin, size_t inner_end) {
+        total.fetch_add(inner_end - inner_begin);
+      });
+    }
+  });
+  // Assert
+  EXPECT_EQ(total.load(), 800);
+}
+
+TEST(ParallelFor, RunsRepeatedSmallLoopsOnPinnedPool) {
+  ThreadPool pool(ThreadPoolOptions{2, 0, true});
+  size_t sum = 0;
+  std::vector<size_t> partial(2);
+  for (int iteration = 0; iteration < 2000; ++iteration) {
+    pool.ParallelFor(0, 2, 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        partial[i] = i + 1;
+      }
+    });
+    sum += partial[0] + partial[1];
+  }
+  EXPECT_EQ(sum, 2000 * 3);
+}
+
+TEST(ThreadPoolGlobal, ConfigureGlobalReplacesThePool) {
+  ThreadPool::ConfigureGlobal(ThreadPoolOptions{3, 2, false});
+  EXPECT_EQ(ThreadPool::Global().NumThreads(), 3);
+  EXPECT_EQ(ThreadPool::Global().MaxParallelism(), 2);
+  ThreadPool::ConfigureGlobal(ThreadPoolOptions{});
+}